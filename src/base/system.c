@@ -73,6 +73,7 @@ void dbg_assert_imp(const char *filename, int line, int test, const char *msg)
 {
 	if(!test)
 	{
+		dbg_disable_threaded();
 		dbg_msg("assert", "%s(%d): %s", filename, line, msg);
 		dbg_break();
 	}
@@ -83,33 +84,261 @@ void dbg_break()
 	*((volatile unsigned*)0) = 0x0;
 }
 
+static int log_format = DBG_LOGFORMAT_PLAIN;
+static volatile int log_threaded = 0;
+
+/* appends a json string, escaped so it can't break the framing */
+static int log_json_string(char *str, int len, int max, const char *value)
+{
+	str[len++] = '"';
+	for(; *value && len < max-7; value++)
+	{
+		unsigned char c = (unsigned char)*value;
+		if(c == '"' || c == '\\')
+		{
+			str[len++] = '\\';
+			str[len++] = c;
+		}
+		else if(c < 0x20)
+			len += sprintf(str+len, "\\u%04x", c);
+		else
+			str[len++] = c;
+	}
+	str[len++] = '"';
+	return len;
+}
+
+static void dbg_log_line(int timestamp, const char *sys, const char *msg)
+{
+	char str[1024*8];
+	int i;
+
+	if(log_format == DBG_LOGFORMAT_JSON)
+	{
+		/* one object per line */
+		int len, max;
+		str_format(str, sizeof(str), "{\"time\":%d,\"sys\":", timestamp);
+		len = strlen(str);
+		max = sizeof(str)-2;
+		len = log_json_string(str, len, max, sys);
+		str[len++] = ',';
+		str_copy(str+len, "\"msg\":", sizeof(str)-len);
+		len += strlen(str+len);
+		len = log_json_string(str, len, max, msg);
+		str[len++] = '}';
+		str[len] = 0;
+	}
+	else
+		str_format(str, sizeof(str), "[%08x][%s]: %s", timestamp, sys, msg);
+
+	for(i = 0; i < num_loggers; i++)
+		loggers[i](str);
+}
+
+/*
+	threaded logging: producers format the message first and then copy it
+	into a bounded queue under a lock. a single writer thread hands the lines
+	to the loggers without holding the lock and flushes once per batch. a
+	full queue drops the message instead of waiting.
+*/
+enum
+{
+	LOG_QUEUE_SIZE=1024, /* must be a power of two */
+	LOG_MSG_SIZE=1024*4, /* as long as a synchronous message */
+};
+
+typedef struct
+{
+	int timestamp;
+	char sys[32];
+	char msg[LOG_MSG_SIZE];
+} LOG_ENTRY;
+
+static LOG_ENTRY *log_queue = 0;
+static LOCK log_lock = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+static SEMAPHORE log_sem;
+#endif
+static unsigned log_enqueue_pos = 0; /* guarded by log_lock, like the other fields below */
+static unsigned log_dequeue_pos = 0;
+static unsigned log_num_dropped = 0;
+static unsigned log_num_reported = 0;
+static int log_writer_stop = 0;
+static void *log_writer_thread = 0;
+
+static int log_on_writer_thread()
+{
+#if defined(CONF_FAMILY_UNIX)
+	return pthread_equal(pthread_self(), (pthread_t)log_writer_thread);
+#elif defined(CONF_FAMILY_WINDOWS)
+	return GetCurrentThreadId() == GetThreadId((HANDLE)log_writer_thread);
+#else
+	#error not implemented
+#endif
+}
+
+/* returns the number of lines written, sets *stop once the queue is empty and the writer should quit */
+static int log_drain(int *stop)
+{
+	int num = 0;
+	unsigned dropped;
+	while(1)
+	{
+		LOG_ENTRY *entry;
+		lock_wait(log_lock);
+		if(log_dequeue_pos == log_enqueue_pos)
+		{
+			dropped = log_num_dropped;
+			*stop = log_writer_stop;
+			lock_release(log_lock);
+			break;
+		}
+		entry = &log_queue[log_dequeue_pos&(LOG_QUEUE_SIZE-1)];
+		lock_release(log_lock);
+
+		/* producers don't touch the entry until it is released below */
+		dbg_log_line(entry->timestamp, entry->sys, entry->msg);
+
+		lock_wait(log_lock);
+		log_dequeue_pos++;
+		lock_release(log_lock);
+		num++;
+	}
+
+	if(dropped != log_num_reported)
+	{
+		char buf[64];
+		str_format(buf, sizeof(buf), "log queue full, dropped %u messages", dropped-log_num_reported);
+		dbg_log_line((int)time(0), "dbg/logger", buf);
+		log_num_reported = dropped;
+		num++;
+	}
+	return num;
+}
+
+static IOHANDLE logfile = 0;
+
+static void log_writer(void *user)
+{
+	while(1)
+	{
+		int stop = 0;
+		if(log_drain(&stop))
+		{
+			fflush(stdout);
+			if(logfile)
+				io_flush(logfile);
+		}
+		if(stop)
+			break;
+#if !defined(CONF_PLATFORM_MACOSX)
+		semaphore_wait(&log_sem);
+#else
+		thread_sleep(5);
+#endif
+	}
+}
+
+void dbg_enable_threaded()
+{
+	if(log_threaded)
+		return;
+
+	log_queue = (LOG_ENTRY *)malloc(sizeof(LOG_ENTRY)*LOG_QUEUE_SIZE);
+	if(!log_queue)
+		return;
+	log_lock = lock_create();
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_init(&log_sem);
+#endif
+	log_enqueue_pos = 0;
+	log_dequeue_pos = 0;
+	log_writer_stop = 0;
+
+	log_writer_thread = thread_create(log_writer, 0);
+	log_threaded = 1;
+	atexit(dbg_disable_threaded);
+}
+
+void dbg_disable_threaded()
+{
+	void *writer;
+	if(!log_lock)
+		return;
+
+	/* only the first caller stops the writer, producers that see log_threaded cleared write synchronously */
+	lock_wait(log_lock);
+	if(!log_threaded)
+	{
+		lock_release(log_lock);
+		return;
+	}
+	log_threaded = 0;
+	log_writer_stop = 1;
+	writer = log_writer_thread;
+	lock_release(log_lock);
+#if !defined(CONF_PLATFORM_MACOSX)
+	semaphore_signal(&log_sem);
+#endif
+
+	/* an assert on the writer thread itself can't wait for it. the queue, lock and
+	   semaphore stay allocated, a producer might still be about to use them */
+	if(!log_on_writer_thread())
+		thread_wait(writer);
+}
+
+void dbg_logger_format(int format)
+{
+	log_format = format;
+}
+
 void dbg_msg(const char *sys, const char *fmt, ...)
 {
 	va_list args;
-	char str[1024*4];
-	char *msg;
-	int i, len;
-
-	str_format(str, sizeof(str), "[%08x][%s]: ", (int)time(0), sys);
-	len = strlen(str);
-	msg = (char *)str + len;
+	char msg[1024*4];
 
 	va_start(args, fmt);
 #if defined(CONF_FAMILY_WINDOWS)
-	_vsnprintf(msg, sizeof(str)-len, fmt, args);
+	_vsnprintf(msg, sizeof(msg), fmt, args);
 #else
-	vsnprintf(msg, sizeof(str)-len, fmt, args);
+	vsnprintf(msg, sizeof(msg), fmt, args);
 #endif
 	va_end(args);
+	msg[sizeof(msg)-1] = 0;
 
-	for(i = 0; i < num_loggers; i++)
-		loggers[i](str);
+	/* messages from the writer thread itself, e.g. from a logger, are written right away */
+	if(log_threaded && !log_on_writer_thread())
+	{
+		lock_wait(log_lock);
+		if(log_threaded)
+		{
+			if(log_enqueue_pos-log_dequeue_pos < LOG_QUEUE_SIZE)
+			{
+				LOG_ENTRY *entry = &log_queue[log_enqueue_pos&(LOG_QUEUE_SIZE-1)];
+				entry->timestamp = (int)time(0);
+				str_copy(entry->sys, sys, sizeof(entry->sys));
+				str_copy(entry->msg, msg, sizeof(entry->msg));
+				log_enqueue_pos++;
+			}
+			else
+				log_num_dropped++;
+			lock_release(log_lock);
+#if !defined(CONF_PLATFORM_MACOSX)
+			semaphore_signal(&log_sem);
+#endif
+			return;
+		}
+		lock_release(log_lock);
+	}
+
+	dbg_log_line((int)time(0), sys, msg);
 }
 
 static void logger_stdout(const char *line)
 {
 	printf("%s\n", line);
-	fflush(stdout);
+	if(!log_threaded)
+		fflush(stdout);
 }
 
 static void logger_debugger(const char *line)
@@ -120,13 +349,12 @@ static void logger_debugger(const char *line)
 #endif
 }
 
-
-static IOHANDLE logfile = 0;
 static void logger_file(const char *line)
 {
 	io_write(logfile, line, strlen(line));
 	io_write_newline(logfile);
-	io_flush(logfile);
+	if(!log_threaded)
+		io_flush(logfile);
 }
 
 void dbg_logger_stdout() { dbg_logger(logger_stdout); }
@@ -320,7 +320,6 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
-
 /*
 	Function: io_stdin
 		Returns an <IOHANDLE> to the standard input.
@@ -1178,6 +1177,35 @@ void dbg_logger_stdout();
 void dbg_logger_debugger();
 void dbg_logger_file(const char *filename);
 
+enum
+{
+	DBG_LOGFORMAT_PLAIN=0,
+	DBG_LOGFORMAT_JSON,
+};
+
+/*
+	Function: dbg_logger_format
+		Selects how log lines are written, either the classic
+		"[time][sys]: message" lines or one JSON object per line.
+*/
+void dbg_logger_format(int format);
+
+/*
+	Function: dbg_enable_threaded
+		Moves log output to a background writer thread. <dbg_msg> only
+		queues the message, messages are dropped while the queue is full.
+
+	Remarks:
+		The queue is drained on exit or by <dbg_disable_threaded>.
+*/
+void dbg_enable_threaded();
+
+/*
+	Function: dbg_disable_threaded
+		Writes all queued messages and returns to synchronous logging.
+*/
+void dbg_disable_threaded();
+
 typedef struct
 {
 	int allocated;
@@ -163,6 +163,9 @@ public:
 	virtual const char *Version() = 0;
 	virtual const char *NetVersion() = 0;
 
+	// prints the render time of each component, see cl_benchmark
+	virtual void PrintBenchmark(int NumFrames, int64 TotalTime) = 0;
+
 };
 
 extern IGameClient *CreateGameClient();
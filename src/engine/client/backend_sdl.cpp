@@ -19,11 +19,11 @@ void CGraphicsBackend_Threaded::ThreadFunc(void *pUser)
 	while(!pThis->m_Shutdown)
 	{
 		pThis->m_Activity.wait();
-		if(pThis->m_pBuffer)
+		while(pThis->m_QueueRead != pThis->m_QueueWrite)
 		{
-			pThis->m_pProcessor->RunBuffer(pThis->m_pBuffer);
+			pThis->m_pProcessor->RunBuffer(pThis->m_apQueue[pThis->m_QueueRead%MAX_PENDING]);
 			sync_barrier();
-			pThis->m_pBuffer = 0x0;
+			pThis->m_QueueRead++;
 			pThis->m_BufferDone.signal();
 		}
 	}
@@ -31,7 +31,8 @@ void CGraphicsBackend_Threaded::ThreadFunc(void *pUser)
 
 CGraphicsBackend_Threaded::CGraphicsBackend_Threaded()
 {
-	m_pBuffer = 0x0;
+	m_QueueWrite = 0;
+	m_QueueRead = 0;
 	m_pProcessor = 0x0;
 	m_pThread = 0x0;
 }
@@ -54,19 +55,27 @@ void CGraphicsBackend_Threaded::StopProcessor()
 
 void CGraphicsBackend_Threaded::RunBuffer(CCommandBuffer *pBuffer)
 {
-	WaitForIdle();
-	m_pBuffer = pBuffer;
+	WaitForPending(MAX_PENDING-1);
+	m_apQueue[m_QueueWrite%MAX_PENDING] = pBuffer;
+	sync_barrier();
+	m_QueueWrite++;
 	m_Activity.signal();
 }
 
 bool CGraphicsBackend_Threaded::IsIdle() const
 {
-	return m_pBuffer == 0x0;
+	return m_QueueRead == m_QueueWrite;
 }
 
 void CGraphicsBackend_Threaded::WaitForIdle()
 {
-	while(m_pBuffer != 0x0)
+	WaitForPending(0);
+}
+
+void CGraphicsBackend_Threaded::WaitForPending(int MaxPending)
+{
+	// the semaphore is signaled once per finished buffer, so it can be ahead of us
+	while(m_QueueWrite-m_QueueRead > (unsigned)MaxPending)
 		m_BufferDone.wait();
 }
 
@@ -633,4 +642,108 @@ int CGraphicsBackend_SDL_OpenGL::WindowOpen()
 }
 
 
+// ------------ CCommandProcessorFragment_Null
+
+CCommandProcessorFragment_Null::CCommandProcessorFragment_Null(volatile int *pTextureMemoryUsage)
+{
+	mem_zero(m_aTextureMemSize, sizeof(m_aTextureMemSize));
+	m_pTextureMemoryUsage = pTextureMemoryUsage;
+}
+
+void CCommandProcessorFragment_Null::Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand)
+{
+	mem_free(pCommand->m_pData);
+}
+
+void CCommandProcessorFragment_Null::Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand)
+{
+	*m_pTextureMemoryUsage -= m_aTextureMemSize[pCommand->m_Slot];
+	m_aTextureMemSize[pCommand->m_Slot] = 0;
+}
+
+void CCommandProcessorFragment_Null::Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand)
+{
+	m_aTextureMemSize[pCommand->m_Slot] = pCommand->m_Width*pCommand->m_Height*pCommand->m_PixelSize;
+	*m_pTextureMemoryUsage += m_aTextureMemSize[pCommand->m_Slot];
+	mem_free(pCommand->m_pData);
+}
+
+void CCommandProcessorFragment_Null::Cmd_VideoModes(const CCommandBuffer::SCommand_VideoModes *pCommand)
+{
+	*pCommand->m_pNumModes = 0;
+}
+
+bool CCommandProcessorFragment_Null::RunCommand(const CCommandBuffer::SCommand *pBaseCommand)
+{
+	switch(pBaseCommand->m_Cmd)
+	{
+	case CCommandBuffer::CMD_TEXTURE_CREATE: Cmd_Texture_Create(static_cast<const CCommandBuffer::SCommand_Texture_Create *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_TEXTURE_DESTROY: Cmd_Texture_Destroy(static_cast<const CCommandBuffer::SCommand_Texture_Destroy *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_VIDEOMODES: Cmd_VideoModes(static_cast<const CCommandBuffer::SCommand_VideoModes *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_CLEAR: break;
+	case CCommandBuffer::CMD_RENDER: break;
+	case CCommandBuffer::CMD_SWAP: break;
+	case CCommandBuffer::CMD_SCREENSHOT: break; // leaves the image empty, so no screenshot is saved
+	default: return false;
+	}
+
+	return true;
+}
+
+// ------------ CCommandProcessor_Null
+
+void CCommandProcessor_Null::RunBuffer(CCommandBuffer *pBuffer)
+{
+	unsigned CmdIndex = 0;
+	while(1)
+	{
+		const CCommandBuffer::SCommand *pBaseCommand = pBuffer->GetCommand(&CmdIndex);
+		if(pBaseCommand == 0x0)
+			break;
+
+		if(m_Null.RunCommand(pBaseCommand))
+			continue;
+
+		if(m_General.RunCommand(pBaseCommand))
+			continue;
+
+		dbg_msg("graphics", "unknown command %d", pBaseCommand->m_Cmd);
+	}
+}
+
+// ------------ CGraphicsBackend_Null
+
+int CGraphicsBackend_Null::Init(const char *pName, int *Width, int *Height, int FsaaSamples, int Flags)
+{
+	// there is no desktop to take the resolution from
+	if(*Width == 0 || *Height == 0)
+	{
+		*Width = 1280;
+		*Height = 720;
+	}
+
+	m_TextureMemoryUsage = 0;
+	m_pProcessor = new CCommandProcessor_Null(&m_TextureMemoryUsage);
+	StartProcessor(m_pProcessor);
+	dbg_msg("gfx", "using the null backend, nothing will be rendered");
+	return 0;
+}
+
+int CGraphicsBackend_Null::Shutdown()
+{
+	WaitForIdle();
+	StopProcessor();
+	delete m_pProcessor;
+	m_pProcessor = 0;
+	return 0;
+}
+
+int CGraphicsBackend_Null::MemoryUsage() const
+{
+	return m_TextureMemoryUsage;
+}
+
+
 IGraphicsBackend *CreateGraphicsBackend() { return new CGraphicsBackend_SDL_OpenGL; }
+IGraphicsBackend *CreateGraphicsBackendNull() { return new CGraphicsBackend_Null; }
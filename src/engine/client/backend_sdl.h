@@ -134,11 +134,17 @@ public:
 		virtual void RunBuffer(CCommandBuffer *pBuffer) = 0;
 	};
 
+	enum
+	{
+		MAX_PENDING=16, // more than the graphics ever has command buffers
+	};
+
 	CGraphicsBackend_Threaded();
 
 	virtual void RunBuffer(CCommandBuffer *pBuffer);
 	virtual bool IsIdle() const;
 	virtual void WaitForIdle();
+	virtual void WaitForPending(int MaxPending);
 		
 protected:
 	void StartProcessor(ICommandProcessor *pProcessor);
@@ -146,7 +152,10 @@ protected:
 
 private:
 	ICommandProcessor *m_pProcessor;
-	CCommandBuffer * volatile m_pBuffer;
+	// the main thread writes the queue, the render thread pops a buffer after running it
+	CCommandBuffer * volatile m_apQueue[MAX_PENDING];
+	volatile unsigned m_QueueWrite;
+	volatile unsigned m_QueueRead;
 	volatile bool m_Shutdown;
 	semaphore m_Activity;
 	semaphore m_BufferDone;
@@ -270,3 +279,47 @@ public:
 	virtual int WindowActive();
 	virtual int WindowOpen();
 };
+
+// takes care of the commands that would need a gpu, without rendering anything
+class CCommandProcessorFragment_Null
+{
+	int m_aTextureMemSize[CCommandBuffer::MAX_TEXTURES];
+	volatile int *m_pTextureMemoryUsage;
+
+	void Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand);
+	void Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand);
+	void Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand);
+	void Cmd_VideoModes(const CCommandBuffer::SCommand_VideoModes *pCommand);
+public:
+	CCommandProcessorFragment_Null(volatile int *pTextureMemoryUsage);
+
+	bool RunCommand(const CCommandBuffer::SCommand *pBaseCommand);
+};
+
+// command processor for the null backend
+class CCommandProcessor_Null : public CGraphicsBackend_Threaded::ICommandProcessor
+{
+	CCommandProcessorFragment_Null m_Null;
+	CCommandProcessorFragment_General m_General;
+public:
+	CCommandProcessor_Null(volatile int *pTextureMemoryUsage) : m_Null(pTextureMemoryUsage) {}
+	virtual void RunBuffer(CCommandBuffer *pBuffer);
+};
+
+// graphics backend without a window or gpu, the command buffers are consumed
+// on the render thread like with the real backend but nothing gets drawn
+class CGraphicsBackend_Null : public CGraphicsBackend_Threaded
+{
+	ICommandProcessor *m_pProcessor;
+	volatile int m_TextureMemoryUsage;
+public:
+	virtual int Init(const char *pName, int *Width, int *Height, int FsaaSamples, int Flags);
+	virtual int Shutdown();
+
+	virtual int MemoryUsage() const;
+
+	virtual void Minimize() {}
+	virtual void Maximize() {}
+	virtual int WindowActive() { return 1; }
+	virtual int WindowOpen() { return 1; }
+};
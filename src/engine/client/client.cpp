@@ -32,6 +32,7 @@
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
+#include <engine/shared/rconcmdlist.h>
 #include <engine/shared/ringbuffer.h>
 #include <engine/shared/snapshot.h>
 
@@ -241,7 +242,7 @@ void CSmoothTime::Update(CGraph *pGraph, int64 Target, int TimeLeft, int AdjustD
 }
 
 
-CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotDelta)
+CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta, true), m_DemoRecorder(&m_SnapshotDelta)
 {
 	m_pEditor = 0;
 	m_pInput = 0;
@@ -255,6 +256,7 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	m_RenderFrameTimeLow = 1.0f;
 	m_RenderFrameTimeHigh = 0.0f;
 	m_RenderFrames = 0;
+	mem_zero(&m_Benchmark, sizeof(m_Benchmark));
 	m_LastRenderTime = time_get();
 
 	m_GameTickSpeed = SERVER_TICK_SPEED;
@@ -377,7 +379,7 @@ void CClient::RconAuth(const char *pName, const char *pPassword)
 	CMsgPacker Msg(NETMSG_RCON_AUTH);
 	Msg.AddString(pName, 32);
 	Msg.AddString(pPassword, 32);
-	Msg.AddInt(1);
+	Msg.AddInt(RCON_CMDLIST_PACKED);
 	SendMsgEx(&Msg, MSGFLAG_VITAL);
 }
 
@@ -739,6 +741,11 @@ void CClient::DebugRender()
 	str_format(aBuffer, sizeof(aBuffer), "pred: %d ms",
 		(int)((m_PredictedTime.Get(Now)-m_GameTime.Get(Now))*1000/(float)time_freq()));
 	Graphics()->QuadsText(2, 70, 16, aBuffer);
+
+	const IEngineGraphics::CFrameStats *pStats = Graphics()->FrameStats();
+	str_format(aBuffer, sizeof(aBuffer), "gfx: %d flushes %d vertices %d kicks wait %.2f ms",
+		pStats->m_NumFlushes, pStats->m_NumVertices, pStats->m_NumKicks, pStats->m_WaitTime*1000/(float)time_freq());
+	Graphics()->QuadsText(2, 82, 16, aBuffer);
 	Graphics()->QuadsEnd();
 
 	// render graphs
@@ -907,12 +914,14 @@ void CClient::ProcessConnlessPacket(CNetChunk *pPacket)
 		}
 	}
 
-	// server list from master server
-	if(pPacket->m_DataSize >= (int)sizeof(SERVERBROWSE_LIST) &&
-		mem_comp(pPacket->m_pData, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST)) == 0)
+	// server list from master server, either complete or one page of it
+	bool ListPaged = pPacket->m_DataSize >= (int)sizeof(SERVERBROWSE_LIST_PAGED)+4 &&
+		mem_comp(pPacket->m_pData, SERVERBROWSE_LIST_PAGED, sizeof(SERVERBROWSE_LIST_PAGED)) == 0;
+	if(ListPaged || (pPacket->m_DataSize >= (int)sizeof(SERVERBROWSE_LIST) &&
+		mem_comp(pPacket->m_pData, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST)) == 0))
 	{
 		// check for valid master server address
-		bool Valid = false;
+		int MasterIndex = -1;
 		for(int i = 0; i < IMasterServer::MAX_MASTERSERVERS; ++i)
 		{
 			if(m_pMasterServer->IsValid(i))
@@ -920,17 +929,22 @@ void CClient::ProcessConnlessPacket(CNetChunk *pPacket)
 				NETADDR Addr = m_pMasterServer->GetAddr(i);
 				if(net_addr_comp(&pPacket->m_Address, &Addr) == 0)
 				{
-					Valid = true;
+					MasterIndex = i;
 					break;
 				}
 			}
 		}
-		if(!Valid)
+		if(MasterIndex == -1)
+			return;
+
+		// the plain list only holds the first part of a paged one
+		if(!ListPaged && m_ServerBrowser.IgnoreUnpagedList(MasterIndex))
 			return;
 
-		int Size = pPacket->m_DataSize-sizeof(SERVERBROWSE_LIST);
+		int HeaderSize = ListPaged ? sizeof(SERVERBROWSE_LIST_PAGED)+4 : sizeof(SERVERBROWSE_LIST);
+		int Size = pPacket->m_DataSize-HeaderSize;
 		int Num = Size/sizeof(CMastersrvAddr);
-		CMastersrvAddr *pAddrs = (CMastersrvAddr *)((char*)pPacket->m_pData+sizeof(SERVERBROWSE_LIST));
+		CMastersrvAddr *pAddrs = (CMastersrvAddr *)((char*)pPacket->m_pData+HeaderSize);
 		for(int i = 0; i < Num; i++)
 		{
 			NETADDR Addr;
@@ -956,6 +970,12 @@ void CClient::ProcessConnlessPacket(CNetChunk *pPacket)
 
 			m_ServerBrowser.Set(Addr, IServerBrowser::SET_MASTER_ADD, -1, 0x0);
 		}
+
+		if(ListPaged)
+		{
+			const unsigned char *pData = (const unsigned char *)pPacket->m_pData+sizeof(SERVERBROWSE_LIST_PAGED);
+			m_ServerBrowser.OnListPage(MasterIndex, (pData[0]<<8) | pData[1], (pData[2]<<8) | pData[3]);
+		}
 	}
 
 	// server info
@@ -1160,6 +1180,18 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			if(Unpacker.Error() == 0)
 				m_pConsole->RegisterTemp(pName, pParams, CFGFLAG_SERVER, pHelp);
 		}
+		else if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && Msg == NETMSG_RCON_CMD_LIST)
+		{
+			int NumCommands = Unpacker.GetInt();
+			for(int i = 0; i < NumCommands && Unpacker.Error() == 0; i++)
+			{
+				const char *pName = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+				const char *pHelp = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+				const char *pParams = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+				if(Unpacker.Error() == 0)
+					m_pConsole->RegisterTemp(pName, pParams, CFGFLAG_SERVER, pHelp);
+			}
+		}
 		else if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && Msg == NETMSG_RCON_CMD_REM)
 		{
 			const char *pName = Unpacker.GetString(CUnpacker::SANITIZE_CC);
@@ -1470,7 +1502,9 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 	mem_copy(m_aSnapshots[SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aSnapshots[SNAP_CURRENT]->m_pAltSnap, pData, Size);
 
+	int64 Start = time_get();
 	GameClient()->OnNewSnapshot();
+	m_Benchmark.m_SnapshotTime += time_get()-Start;
 }
 
 void CClient::OnDemoPlayerMessage(void *pData, int Size)
@@ -1525,7 +1559,10 @@ void CClient::Update()
 {
 	if(State() == IClient::STATE_DEMOPLAYBACK)
 	{
-		m_DemoPlayer.Update();
+		if(m_Benchmark.m_Active)
+			m_DemoPlayer.Update(time_freq()/BENCHMARK_FPS);
+		else
+			m_DemoPlayer.Update();
 		if(m_DemoPlayer.IsPlaying())
 		{
 			// update timers
@@ -1735,7 +1772,7 @@ void CClient::Run()
 
 	// init graphics
 	{
-		if(g_Config.m_GfxThreaded)
+		if(g_Config.m_GfxThreaded || g_Config.m_GfxNull) // the null backend only exists for the threaded graphics
 			m_pGraphics = CreateEngineGraphicsThreaded();
 		else
 			m_pGraphics = CreateEngineGraphics();
@@ -1821,6 +1858,9 @@ void CClient::Run()
 	// process pending commands
 	m_pConsole->StoreCommands(false);
 
+	if(g_Config.m_ClBenchmark[0])
+		Benchmark_Start();
+
 	while (1)
 	{
 		//
@@ -1907,6 +1947,7 @@ void CClient::Run()
 			else if(m_EditorActive)
 				m_EditorActive = false;
 
+			int64 UpdateStart = time_get();
 			Update();
 			
 			if(!g_Config.m_GfxAsyncRender || m_pGraphics->IsIdle())
@@ -1940,6 +1981,7 @@ void CClient::Run()
 				}
 				else
 				{
+					int64 RenderStart = time_get();
 					if(!m_EditorActive)
 						Render();
 					else
@@ -1947,7 +1989,11 @@ void CClient::Run()
 						m_pEditor->UpdateAndRender();
 						DebugRender();
 					}
+					int64 SwapStart = time_get();
 					m_pGraphics->Swap();
+
+					if(m_Benchmark.m_Active)
+						Benchmark_Frame(UpdateStart, RenderStart, SwapStart, time_get());
 				}
 			}
 		}
@@ -1958,11 +2004,14 @@ void CClient::Run()
 		if(State() == IClient::STATE_QUITING)
 			break;
 
-		// beNice
-		if(g_Config.m_ClCpuThrottle)
-			thread_sleep(g_Config.m_ClCpuThrottle);
-		else if(g_Config.m_DbgStress || !m_pGraphics->WindowActive())
-			thread_sleep(5);
+		// beNice, the benchmark runs as fast as it can
+		if(!m_Benchmark.m_Active)
+		{
+			if(g_Config.m_ClCpuThrottle)
+				thread_sleep(g_Config.m_ClCpuThrottle);
+			else if(g_Config.m_DbgStress || !m_pGraphics->WindowActive())
+				thread_sleep(5);
+		}
 
 		if(g_Config.m_DbgHitch)
 		{
@@ -2146,6 +2195,75 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 	return 0;
 }
 
+void CClient::Benchmark_Start()
+{
+	const char *pError = DemoPlayer_Play(g_Config.m_ClBenchmark, IStorage::TYPE_ALL);
+	if(pError)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "couldn't play '%s': %s", g_Config.m_ClBenchmark, pError);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+		Quit();
+		return;
+	}
+
+	mem_zero(&m_Benchmark, sizeof(m_Benchmark));
+	m_Benchmark.m_Active = true;
+	m_Benchmark.m_StartTime = time_get();
+}
+
+void CClient::Benchmark_Frame(int64 UpdateStart, int64 RenderStart, int64 SwapStart, int64 FrameEnd)
+{
+	m_Benchmark.m_NumFrames++;
+	m_Benchmark.m_UpdateTime += RenderStart-UpdateStart;
+	m_Benchmark.m_RenderTime += SwapStart-RenderStart;
+	m_Benchmark.m_SwapTime += FrameEnd-SwapStart;
+	m_Benchmark.m_MaxFrameTime = max(m_Benchmark.m_MaxFrameTime, FrameEnd-UpdateStart);
+
+	const IEngineGraphics::CFrameStats *pStats = Graphics()->FrameStats();
+	m_Benchmark.m_NumFlushes += pStats->m_NumFlushes;
+	m_Benchmark.m_NumVertices += pStats->m_NumVertices;
+	m_Benchmark.m_NumKicks += pStats->m_NumKicks;
+	m_Benchmark.m_GfxWaitTime += pStats->m_WaitTime;
+
+	// the player pauses at the end of the demo and stops on errors
+	if(State() != IClient::STATE_DEMOPLAYBACK || m_DemoPlayer.BaseInfo()->m_Paused)
+	{
+		Benchmark_Report();
+		m_Benchmark.m_Active = false;
+		Quit();
+	}
+}
+
+void CClient::Benchmark_Report()
+{
+	int64 Freq = time_freq();
+	int64 Total = max(time_get()-m_Benchmark.m_StartTime, (int64)1);
+	int NumFrames = max(m_Benchmark.m_NumFrames, 1);
+	char aBuf[256];
+
+	str_format(aBuf, sizeof(aBuf), "'%s': %d frames in %.2f s, %.1f fps, frame time avg %.3f ms max %.3f ms",
+		g_Config.m_ClBenchmark, m_Benchmark.m_NumFrames, Total/(double)Freq, m_Benchmark.m_NumFrames*(double)Freq/Total,
+		Total*1000.0/Freq/NumFrames, m_Benchmark.m_MaxFrameTime*1000.0/Freq);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+
+	const char *apNames[] = {"demo playback", "  snapshots", "render", "swap"};
+	int64 aTimes[] = {m_Benchmark.m_UpdateTime, m_Benchmark.m_SnapshotTime, m_Benchmark.m_RenderTime, m_Benchmark.m_SwapTime};
+	for(unsigned i = 0; i < sizeof(aTimes)/sizeof(aTimes[0]); i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "%-24s %8.3f ms/frame %5.1f%%", apNames[i], aTimes[i]*1000.0/Freq/NumFrames, aTimes[i]*100.0/Total);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+	}
+
+	str_format(aBuf, sizeof(aBuf), "graphics: %.1f flushes %.0f vertices %.2f kicks per frame, waited %.3f ms/frame for the backend",
+		m_Benchmark.m_NumFlushes/(double)NumFrames, m_Benchmark.m_NumVertices/(double)NumFrames, m_Benchmark.m_NumKicks/(double)NumFrames,
+		m_Benchmark.m_GfxWaitTime*1000.0/Freq/NumFrames);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+
+	// the render time split up by component
+	GameClient()->PrintBenchmark(NumFrames, Total);
+}
+
 void CClient::Con_Play(IConsole::IResult *pResult, void *pUserData)
 {
 	CClient *pSelf = (CClient *)pUserData;
@@ -91,6 +91,28 @@ class CClient : public IClient, public CDemoPlayer::IListner
 	float m_RenderFrameTimeHigh;
 	int m_RenderFrames;
 
+	// cl_benchmark, times are summed up over all frames
+	enum
+	{
+		BENCHMARK_FPS=100, // demo time that passes per frame
+	};
+
+	struct
+	{
+		bool m_Active;
+		int m_NumFrames;
+		int64 m_StartTime;
+		int64 m_UpdateTime; // demo playback, snapshot processing included
+		int64 m_SnapshotTime;
+		int64 m_RenderTime;
+		int64 m_SwapTime;
+		int64 m_MaxFrameTime;
+		int64 m_NumFlushes; // summed up graphics frame stats
+		int64 m_NumVertices;
+		int64 m_NumKicks;
+		int64 m_GfxWaitTime;
+	} m_Benchmark;
+
 	NETADDR m_ServerAddress;
 	int m_WindowMustRefocus;
 	int m_SnapCrcErrors;
@@ -302,6 +324,10 @@ public:
 	void AutoScreenshot_Start();
 	void AutoScreenshot_Cleanup();
 
+	void Benchmark_Start();
+	void Benchmark_Frame(int64 UpdateStart, int64 RenderStart, int64 SwapStart, int64 FrameEnd);
+	void Benchmark_Report();
+
 	void ServerBrowserUpdate();
 };
 #endif
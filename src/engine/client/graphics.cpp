@@ -87,6 +87,8 @@ void CGraphics_OpenGL::Flush()
 			glDrawArrays(GL_QUADS, 0, m_NumVertices);
 		else if(m_Drawing == DRAWING_LINES)
 			glDrawArrays(GL_LINES, 0, m_NumVertices);
+		m_FrameStats.m_NumFlushes++;
+		m_FrameStats.m_NumVertices += m_NumVertices;
 	}
 
 	// Reset pointer
@@ -154,6 +156,8 @@ unsigned char *CGraphics_OpenGL::Rescale(int Width, int Height, int NewWidth, in
 CGraphics_OpenGL::CGraphics_OpenGL()
 {
 	m_NumVertices = 0;
+	mem_zero(&m_FrameStats, sizeof(m_FrameStats));
+	mem_zero(&m_LastFrameStats, sizeof(m_LastFrameStats));
 
 	m_ScreenX0 = 0;
 	m_ScreenY0 = 0;
@@ -700,6 +704,35 @@ void CGraphics_OpenGL::QuadsDrawFreeform(const CFreeformItem *pArray, int Num)
 	AddVertices(4*Num);
 }
 
+void CGraphics_OpenGL::QuadsDrawVertices(const CQuadVertex *pArray, int NumQuads)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawVertices without begin");
+
+	while(NumQuads > 0)
+	{
+		int Num = min(NumQuads, (MAX_VERTICES-m_NumVertices)/4);
+		if(Num == 0)
+		{
+			Flush();
+			continue;
+		}
+
+		CVertex *pVertices = &m_aVertices[m_NumVertices];
+		for(int i = 0; i < 4*Num; i++)
+		{
+			pVertices[i].m_Pos.x = pArray[i].m_X;
+			pVertices[i].m_Pos.y = pArray[i].m_Y;
+			pVertices[i].m_Tex.u = pArray[i].m_U;
+			pVertices[i].m_Tex.v = pArray[i].m_V;
+			pVertices[i].m_Color = m_aColor[i&3];
+		}
+
+		AddVertices(4*Num);
+		pArray += 4*Num;
+		NumQuads -= Num;
+	}
+}
+
 void CGraphics_OpenGL::QuadsText(float x, float y, float Size, const char *pText)
 {
 	float StartX = x;
@@ -962,6 +995,9 @@ void CGraphics_SDL::Swap()
 
 	if(g_Config.m_GfxFinish)
 		glFinish();
+
+	m_LastFrameStats = m_FrameStats;
+	mem_zero(&m_FrameStats, sizeof(m_FrameStats));
 }
 
 
@@ -33,6 +33,9 @@ protected:
 	CVertex m_aVertices[MAX_VERTICES];
 	int m_NumVertices;
 
+	CFrameStats m_FrameStats;
+	CFrameStats m_LastFrameStats;
+
 	CColor m_aColor[4];
 	CTexCoord m_aTexture[4];
 
@@ -82,6 +85,7 @@ public:
 	virtual void WrapClamp();
 
 	virtual int MemoryUsage() const;
+	virtual const CFrameStats *FrameStats() const { return &m_LastFrameStats; }
 
 	virtual void MapScreen(float TopLeftX, float TopLeftY, float BottomRightX, float BottomRightY);
 	virtual void GetScreen(float *pTopLeftX, float *pTopLeftY, float *pBottomRightX, float *pBottomRightY);
@@ -119,6 +123,7 @@ public:
 	virtual void QuadsDraw(CQuadItem *pArray, int Num);
 	virtual void QuadsDrawTL(const CQuadItem *pArray, int Num);
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
+	virtual void QuadsDrawVertices(const CQuadVertex *pArray, int NumQuads);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
 	virtual int Init();
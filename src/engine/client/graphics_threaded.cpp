@@ -100,14 +100,30 @@ void CGraphics_Threaded::FlushVertices()
 		}
 	}
 
-	mem_copy(Cmd.m_pVertices, m_aVertices, sizeof(CCommandBuffer::SVertex)*NumVerts);
+	mem_copy(Cmd.m_pVertices, m_pVertices, sizeof(CCommandBuffer::SVertex)*NumVerts);
+	m_FrameStats.m_NumFlushes++;
+	m_FrameStats.m_NumVertices += NumVerts;
+}
+
+void CGraphics_Threaded::ReserveVertices(int Count)
+{
+	if(m_NumVertices + Count <= m_MaxVertices)
+		return;
+	FlushVertices();
+	if(Count <= m_MaxVertices)
+		return;
+
+	// a single call that doesn't fit, grow instead of splitting it
+	m_MaxVertices = max(Count, m_MaxVertices*2);
+	delete [] m_pVertices;
+	m_pVertices = new CCommandBuffer::SVertex[m_MaxVertices];
+	for(int i = 0; i < m_MaxVertices; i++)
+		m_pVertices[i].m_Pos.z = -5.0f;
 }
 
 void CGraphics_Threaded::AddVertices(int Count)
 {
 	m_NumVertices += Count;
-	if((m_NumVertices + Count) >= MAX_VERTICES)
-		FlushVertices();
 }
 
 void CGraphics_Threaded::Rotate4(const CCommandBuffer::SPoint &rCenter, CCommandBuffer::SVertex *pPoints)
@@ -143,10 +159,15 @@ CGraphics_Threaded::CGraphics_Threaded()
 
 	m_CurrentCommandBuffer = 0;
 	m_pCommandBuffer = 0x0;
-	m_apCommandBuffers[0] = 0x0;
-	m_apCommandBuffers[1] = 0x0;
+	for(int i = 0; i < MAX_CMDBUFFERS; i++)
+		m_apCommandBuffers[i] = 0x0;
+	m_NumCommandBuffers = 0;
 
+	m_pVertices = 0x0;
 	m_NumVertices = 0;
+	m_MaxVertices = 0;
+	mem_zero(&m_FrameStats, sizeof(m_FrameStats));
+	mem_zero(&m_LastFrameStats, sizeof(m_LastFrameStats));
 
 	m_ScreenWidth = -1;
 	m_ScreenHeight = -1;
@@ -249,17 +270,18 @@ void CGraphics_Threaded::LinesDraw(const CLineItem *pArray, int Num)
 {
 	dbg_assert(m_Drawing == DRAWING_LINES, "called Graphics()->LinesDraw without begin");
 
+	ReserveVertices(2*Num);
 	for(int i = 0; i < Num; ++i)
 	{
-		m_aVertices[m_NumVertices + 2*i].m_Pos.x = pArray[i].m_X0;
-		m_aVertices[m_NumVertices + 2*i].m_Pos.y = pArray[i].m_Y0;
-		m_aVertices[m_NumVertices + 2*i].m_Tex = m_aTexture[0];
-		m_aVertices[m_NumVertices + 2*i].m_Color = m_aColor[0];
-
-		m_aVertices[m_NumVertices + 2*i + 1].m_Pos.x = pArray[i].m_X1;
-		m_aVertices[m_NumVertices + 2*i + 1].m_Pos.y = pArray[i].m_Y1;
-		m_aVertices[m_NumVertices + 2*i + 1].m_Tex = m_aTexture[1];
-		m_aVertices[m_NumVertices + 2*i + 1].m_Color = m_aColor[1];
+		m_pVertices[m_NumVertices + 2*i].m_Pos.x = pArray[i].m_X0;
+		m_pVertices[m_NumVertices + 2*i].m_Pos.y = pArray[i].m_Y0;
+		m_pVertices[m_NumVertices + 2*i].m_Tex = m_aTexture[0];
+		m_pVertices[m_NumVertices + 2*i].m_Color = m_aColor[0];
+
+		m_pVertices[m_NumVertices + 2*i + 1].m_Pos.x = pArray[i].m_X1;
+		m_pVertices[m_NumVertices + 2*i + 1].m_Pos.y = pArray[i].m_Y1;
+		m_pVertices[m_NumVertices + 2*i + 1].m_Tex = m_aTexture[1];
+		m_pVertices[m_NumVertices + 2*i + 1].m_Color = m_aColor[1];
 	}
 
 	AddVertices(2*Num);
@@ -438,10 +460,15 @@ int CGraphics_Threaded::LoadPNG(CImageInfo *pImg, const char *pFilename, int Sto
 
 void CGraphics_Threaded::KickCommandBuffer()
 {
+	// the next buffer is the oldest one, wait until the backend is done with it
+	int64 WaitStart = time_get();
 	m_pBackend->RunBuffer(m_pCommandBuffer);
+	m_pBackend->WaitForPending(m_NumCommandBuffers-1);
+	m_FrameStats.m_WaitTime += time_get()-WaitStart;
+	m_FrameStats.m_NumKicks++;
 
 	// swap buffer
-	m_CurrentCommandBuffer ^= 1;
+	m_CurrentCommandBuffer = (m_CurrentCommandBuffer+1)%m_NumCommandBuffers;
 	m_pCommandBuffer = m_apCommandBuffers[m_CurrentCommandBuffer];
 	m_pCommandBuffer->Reset();
 }
@@ -584,34 +611,35 @@ void CGraphics_Threaded::QuadsDrawTL(const CQuadItem *pArray, int Num)
 
 	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawTL without begin");
 
+	ReserveVertices(4*Num);
 	for(int i = 0; i < Num; ++i)
 	{
-		m_aVertices[m_NumVertices + 4*i].m_Pos.x = pArray[i].m_X;
-		m_aVertices[m_NumVertices + 4*i].m_Pos.y = pArray[i].m_Y;
-		m_aVertices[m_NumVertices + 4*i].m_Tex = m_aTexture[0];
-		m_aVertices[m_NumVertices + 4*i].m_Color = m_aColor[0];
-
-		m_aVertices[m_NumVertices + 4*i + 1].m_Pos.x = pArray[i].m_X + pArray[i].m_Width;
-		m_aVertices[m_NumVertices + 4*i + 1].m_Pos.y = pArray[i].m_Y;
-		m_aVertices[m_NumVertices + 4*i + 1].m_Tex = m_aTexture[1];
-		m_aVertices[m_NumVertices + 4*i + 1].m_Color = m_aColor[1];
-
-		m_aVertices[m_NumVertices + 4*i + 2].m_Pos.x = pArray[i].m_X + pArray[i].m_Width;
-		m_aVertices[m_NumVertices + 4*i + 2].m_Pos.y = pArray[i].m_Y + pArray[i].m_Height;
-		m_aVertices[m_NumVertices + 4*i + 2].m_Tex = m_aTexture[2];
-		m_aVertices[m_NumVertices + 4*i + 2].m_Color = m_aColor[2];
-
-		m_aVertices[m_NumVertices + 4*i + 3].m_Pos.x = pArray[i].m_X;
-		m_aVertices[m_NumVertices + 4*i + 3].m_Pos.y = pArray[i].m_Y + pArray[i].m_Height;
-		m_aVertices[m_NumVertices + 4*i + 3].m_Tex = m_aTexture[3];
-		m_aVertices[m_NumVertices + 4*i + 3].m_Color = m_aColor[3];
+		m_pVertices[m_NumVertices + 4*i].m_Pos.x = pArray[i].m_X;
+		m_pVertices[m_NumVertices + 4*i].m_Pos.y = pArray[i].m_Y;
+		m_pVertices[m_NumVertices + 4*i].m_Tex = m_aTexture[0];
+		m_pVertices[m_NumVertices + 4*i].m_Color = m_aColor[0];
+
+		m_pVertices[m_NumVertices + 4*i + 1].m_Pos.x = pArray[i].m_X + pArray[i].m_Width;
+		m_pVertices[m_NumVertices + 4*i + 1].m_Pos.y = pArray[i].m_Y;
+		m_pVertices[m_NumVertices + 4*i + 1].m_Tex = m_aTexture[1];
+		m_pVertices[m_NumVertices + 4*i + 1].m_Color = m_aColor[1];
+
+		m_pVertices[m_NumVertices + 4*i + 2].m_Pos.x = pArray[i].m_X + pArray[i].m_Width;
+		m_pVertices[m_NumVertices + 4*i + 2].m_Pos.y = pArray[i].m_Y + pArray[i].m_Height;
+		m_pVertices[m_NumVertices + 4*i + 2].m_Tex = m_aTexture[2];
+		m_pVertices[m_NumVertices + 4*i + 2].m_Color = m_aColor[2];
+
+		m_pVertices[m_NumVertices + 4*i + 3].m_Pos.x = pArray[i].m_X;
+		m_pVertices[m_NumVertices + 4*i + 3].m_Pos.y = pArray[i].m_Y + pArray[i].m_Height;
+		m_pVertices[m_NumVertices + 4*i + 3].m_Tex = m_aTexture[3];
+		m_pVertices[m_NumVertices + 4*i + 3].m_Color = m_aColor[3];
 
 		if(m_Rotation != 0)
 		{
 			Center.x = pArray[i].m_X + pArray[i].m_Width/2;
 			Center.y = pArray[i].m_Y + pArray[i].m_Height/2;
 
-			Rotate4(Center, &m_aVertices[m_NumVertices + 4*i]);
+			Rotate4(Center, &m_pVertices[m_NumVertices + 4*i]);
 		}
 	}
 
@@ -622,32 +650,50 @@ void CGraphics_Threaded::QuadsDrawFreeform(const CFreeformItem *pArray, int Num)
 {
 	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawFreeform without begin");
 
+	ReserveVertices(4*Num);
 	for(int i = 0; i < Num; ++i)
 	{
-		m_aVertices[m_NumVertices + 4*i].m_Pos.x = pArray[i].m_X0;
-		m_aVertices[m_NumVertices + 4*i].m_Pos.y = pArray[i].m_Y0;
-		m_aVertices[m_NumVertices + 4*i].m_Tex = m_aTexture[0];
-		m_aVertices[m_NumVertices + 4*i].m_Color = m_aColor[0];
-
-		m_aVertices[m_NumVertices + 4*i + 1].m_Pos.x = pArray[i].m_X1;
-		m_aVertices[m_NumVertices + 4*i + 1].m_Pos.y = pArray[i].m_Y1;
-		m_aVertices[m_NumVertices + 4*i + 1].m_Tex = m_aTexture[1];
-		m_aVertices[m_NumVertices + 4*i + 1].m_Color = m_aColor[1];
-
-		m_aVertices[m_NumVertices + 4*i + 2].m_Pos.x = pArray[i].m_X3;
-		m_aVertices[m_NumVertices + 4*i + 2].m_Pos.y = pArray[i].m_Y3;
-		m_aVertices[m_NumVertices + 4*i + 2].m_Tex = m_aTexture[3];
-		m_aVertices[m_NumVertices + 4*i + 2].m_Color = m_aColor[3];
-
-		m_aVertices[m_NumVertices + 4*i + 3].m_Pos.x = pArray[i].m_X2;
-		m_aVertices[m_NumVertices + 4*i + 3].m_Pos.y = pArray[i].m_Y2;
-		m_aVertices[m_NumVertices + 4*i + 3].m_Tex = m_aTexture[2];
-		m_aVertices[m_NumVertices + 4*i + 3].m_Color = m_aColor[2];
+		m_pVertices[m_NumVertices + 4*i].m_Pos.x = pArray[i].m_X0;
+		m_pVertices[m_NumVertices + 4*i].m_Pos.y = pArray[i].m_Y0;
+		m_pVertices[m_NumVertices + 4*i].m_Tex = m_aTexture[0];
+		m_pVertices[m_NumVertices + 4*i].m_Color = m_aColor[0];
+
+		m_pVertices[m_NumVertices + 4*i + 1].m_Pos.x = pArray[i].m_X1;
+		m_pVertices[m_NumVertices + 4*i + 1].m_Pos.y = pArray[i].m_Y1;
+		m_pVertices[m_NumVertices + 4*i + 1].m_Tex = m_aTexture[1];
+		m_pVertices[m_NumVertices + 4*i + 1].m_Color = m_aColor[1];
+
+		m_pVertices[m_NumVertices + 4*i + 2].m_Pos.x = pArray[i].m_X3;
+		m_pVertices[m_NumVertices + 4*i + 2].m_Pos.y = pArray[i].m_Y3;
+		m_pVertices[m_NumVertices + 4*i + 2].m_Tex = m_aTexture[3];
+		m_pVertices[m_NumVertices + 4*i + 2].m_Color = m_aColor[3];
+
+		m_pVertices[m_NumVertices + 4*i + 3].m_Pos.x = pArray[i].m_X2;
+		m_pVertices[m_NumVertices + 4*i + 3].m_Pos.y = pArray[i].m_Y2;
+		m_pVertices[m_NumVertices + 4*i + 3].m_Tex = m_aTexture[2];
+		m_pVertices[m_NumVertices + 4*i + 3].m_Color = m_aColor[2];
 	}
 
 	AddVertices(4*Num);
 }
 
+void CGraphics_Threaded::QuadsDrawVertices(const CQuadVertex *pArray, int NumQuads)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawVertices without begin");
+
+	ReserveVertices(4*NumQuads);
+	CCommandBuffer::SVertex *pVertices = &m_pVertices[m_NumVertices];
+	for(int i = 0; i < 4*NumQuads; i++)
+	{
+		pVertices[i].m_Pos.x = pArray[i].m_X;
+		pVertices[i].m_Pos.y = pArray[i].m_Y;
+		pVertices[i].m_Tex.u = pArray[i].m_U;
+		pVertices[i].m_Tex.v = pArray[i].m_V;
+		pVertices[i].m_Color = m_aColor[i&3];
+	}
+	AddVertices(4*NumQuads);
+}
+
 void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pText)
 {
 	float StartX = x;
@@ -736,8 +782,10 @@ int CGraphics_Threaded::Init()
 	m_pConsole = Kernel()->RequestInterface<IConsole>();
 
 	// Set all z to -5.0f
-	for(int i = 0; i < MAX_VERTICES; i++)
-		m_aVertices[i].m_Pos.z = -5.0f;
+	m_MaxVertices = MIN_VERTICES;
+	m_pVertices = new CCommandBuffer::SVertex[m_MaxVertices];
+	for(int i = 0; i < m_MaxVertices; i++)
+		m_pVertices[i].m_Pos.z = -5.0f;
 
 	// init textures
 	m_FirstFreeTexture = 0;
@@ -745,7 +793,10 @@ int CGraphics_Threaded::Init()
 		m_aTextureIndices[i] = i+1;
 	m_aTextureIndices[MAX_TEXTURES-1] = -1;
 
-	m_pBackend = CreateGraphicsBackend();
+	if(g_Config.m_GfxNull)
+		m_pBackend = CreateGraphicsBackendNull();
+	else
+		m_pBackend = CreateGraphicsBackend();
 	if(InitWindow() != 0)
 		return -1;
 
@@ -753,8 +804,9 @@ int CGraphics_Threaded::Init()
 	m_ScreenWidth = g_Config.m_GfxScreenWidth;
 	m_ScreenHeight = g_Config.m_GfxScreenHeight;
 
-	// create command buffers
-	for(int i = 0; i < NUM_CMDBUFFERS; i++)
+	// create command buffers, they grow when a frame doesn't fit
+	m_NumCommandBuffers = clamp(g_Config.m_GfxCommandBuffers, 2, (int)MAX_CMDBUFFERS);
+	for(int i = 0; i < m_NumCommandBuffers; i++)
 		m_apCommandBuffers[i] = new CCommandBuffer(128*1024, 2*1024*1024);
 	m_pCommandBuffer = m_apCommandBuffers[0];
 
@@ -778,8 +830,11 @@ void CGraphics_Threaded::Shutdown()
 	m_pBackend = 0x0;
 
 	// delete the command buffers
-	for(int i = 0; i < NUM_CMDBUFFERS; i++)
+	for(int i = 0; i < m_NumCommandBuffers; i++)
 		delete m_apCommandBuffers[i];
+
+	delete [] m_pVertices;
+	m_pVertices = 0x0;
 }
 
 void CGraphics_Threaded::Minimize()
@@ -830,6 +885,9 @@ void CGraphics_Threaded::Swap()
 
 	// kick the command buffer
 	KickCommandBuffer();
+
+	m_LastFrameStats = m_FrameStats;
+	mem_zero(&m_FrameStats, sizeof(m_FrameStats));
 }
 
 // syncronization
@@ -1,20 +1,38 @@
 #pragma once
 
+#include <base/math.h>
 #include <engine/graphics.h>
 
 class CCommandBuffer
 {
+	// commands point into the data buffer, so a buffer can only grow while
+	// it is empty. one that ran full grows when it gets reused
 	class CBuffer
 	{
 		unsigned char *m_pData;
 		unsigned m_Size;
+		unsigned m_MaxSize; // for growing a buffer that ran full, a single larger allocation still fits
 		unsigned m_Used;
+		bool m_RanFull;
+
+		void Grow(unsigned MinSize)
+		{
+			unsigned NewSize = max(MinSize, min(m_Size*2, m_MaxSize));
+			if(NewSize <= m_Size)
+				return;
+			delete [] m_pData;
+			m_Size = NewSize;
+			m_pData = new unsigned char[m_Size];
+		}
+
 	public:
 		CBuffer(unsigned BufferSize)
 		{
 			m_Size = BufferSize;
+			m_MaxSize = BufferSize*16;
 			m_pData = new unsigned char[m_Size];
 			m_Used = 0;
+			m_RanFull = false;
 		}
 
 		~CBuffer()
@@ -27,13 +45,23 @@ class CCommandBuffer
 
 		void Reset()
 		{
+			if(m_RanFull)
+				Grow(0);
+			m_RanFull = false;
 			m_Used = 0;
 		}
 
 		void *Alloc(unsigned Requested)
 		{
 			if(Requested + m_Used > m_Size)
-				return 0;
+			{
+				if(m_Used != 0)
+				{
+					m_RanFull = true;
+					return 0;
+				}
+				Grow(Requested);
+			}
 			void *pPtr = &m_pData[m_Used];
 			m_Used += Requested;
 			return pPtr;
@@ -312,18 +340,21 @@ public:
 	virtual int WindowActive() = 0;
 	virtual int WindowOpen() = 0;
 
+	// queues the buffer, it must not be touched until the backend is done with it
 	virtual void RunBuffer(CCommandBuffer *pBuffer) = 0;
 	virtual bool IsIdle() const = 0;
 	virtual void WaitForIdle() = 0;
+	// blocks until at most this many buffers are queued or running
+	virtual void WaitForPending(int MaxPending) = 0;
 };
 
 class CGraphics_Threaded : public IEngineGraphics
 {
 	enum
 	{
-		NUM_CMDBUFFERS = 2,
+		MAX_CMDBUFFERS = 8,
 
-		MAX_VERTICES = 32*1024,
+		MIN_VERTICES = 32*1024, // the staging grows from here when a single call needs more
 		MAX_TEXTURES = 1024*4,
 		
 		DRAWING_QUADS=1,
@@ -333,16 +364,21 @@ class CGraphics_Threaded : public IEngineGraphics
 	CCommandBuffer::SState m_State;
 	IGraphicsBackend *m_pBackend;
 
-	CCommandBuffer *m_apCommandBuffers[NUM_CMDBUFFERS];
+	CCommandBuffer *m_apCommandBuffers[MAX_CMDBUFFERS];
 	CCommandBuffer *m_pCommandBuffer;
 	unsigned m_CurrentCommandBuffer;
+	int m_NumCommandBuffers;
 
 	//
 	class IStorage *m_pStorage;
 	class IConsole *m_pConsole;
 
-	CCommandBuffer::SVertex m_aVertices[MAX_VERTICES];
+	CCommandBuffer::SVertex *m_pVertices;
 	int m_NumVertices;
+	int m_MaxVertices;
+
+	CFrameStats m_FrameStats;
+	CFrameStats m_LastFrameStats;
 
 	CCommandBuffer::SColor m_aColor[4];
 	CCommandBuffer::STexCoord m_aTexture[4];
@@ -361,6 +397,7 @@ class CGraphics_Threaded : public IEngineGraphics
 	int m_TextureMemoryUsage;
 
 	void FlushVertices();
+	void ReserveVertices(int Count);
 	void AddVertices(int Count);
 	void Rotate4(const CCommandBuffer::SPoint &rCenter, CCommandBuffer::SVertex *pPoints);
 
@@ -382,6 +419,7 @@ public:
 	virtual void WrapClamp();
 
 	virtual int MemoryUsage() const;
+	virtual const CFrameStats *FrameStats() const { return &m_LastFrameStats; }
 
 	virtual void MapScreen(float TopLeftX, float TopLeftY, float BottomRightX, float BottomRightY);
 	virtual void GetScreen(float *pTopLeftX, float *pTopLeftY, float *pBottomRightX, float *pBottomRightY);
@@ -419,6 +457,7 @@ public:
 	virtual void QuadsDraw(CQuadItem *pArray, int Num);
 	virtual void QuadsDrawTL(const CQuadItem *pArray, int Num);
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
+	virtual void QuadsDrawVertices(const CQuadVertex *pArray, int NumQuads);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
 	virtual void Minimize();
@@ -442,3 +481,4 @@ public:
 };
 
 extern IGraphicsBackend *CreateGraphicsBackend();
+extern IGraphicsBackend *CreateGraphicsBackendNull();
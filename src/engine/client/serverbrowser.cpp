@@ -44,6 +44,8 @@ CServerBrowser::CServerBrowser()
 	m_NumRequests = 0;
 
 	m_NeedRefresh = 0;
+	m_NeedResort = false;
+	mem_zero(m_aMasterRequests, sizeof(m_aMasterRequests));
 
 	m_NumSortedServers = 0;
 	m_NumSortedServersCapacity = 0;
@@ -278,6 +280,8 @@ void CServerBrowser::Sort()
 {
 	int i;
 
+	m_NeedResort = false;
+
 	// create filtered list
 	Filter();
 
@@ -323,9 +327,20 @@ void CServerBrowser::RemoveRequest(CServerEntry *pEntry)
 	}
 }
 
+static unsigned HashAddr(const NETADDR &Addr)
+{
+	// fnv-1a over the address and port, lan servers often share the ip
+	unsigned h = 2166136261u^Addr.type;
+	for(int i = 0; i < (Addr.type == NETTYPE_IPV4 ? 4 : 16); i++)
+		h = (h^Addr.ip[i])*16777619u;
+	h = (h^(Addr.port&0xff))*16777619u;
+	h = (h^(Addr.port>>8))*16777619u;
+	return h;
+}
+
 CServerBrowser::CServerEntry *CServerBrowser::Find(const NETADDR &Addr)
 {
-	CServerEntry *pEntry = m_aServerlistIp[Addr.ip[0]];
+	CServerEntry *pEntry = m_aServerlistIp[HashAddr(Addr)&(SERVERLIST_HASH_SIZE-1)];
 
 	for(; pEntry; pEntry = pEntry->m_pNextIp)
 	{
@@ -374,7 +389,7 @@ void CServerBrowser::SetInfo(CServerEntry *pEntry, const CServerInfo &Info)
 
 CServerBrowser::CServerEntry *CServerBrowser::Add(const NETADDR &Addr)
 {
-	int Hash = Addr.ip[0];
+	int Hash = HashAddr(Addr)&(SERVERLIST_HASH_SIZE-1);
 
 	// create new pEntry
 	CServerEntry *pEntry = (CServerEntry *)m_ServerlistHeap.Allocate(sizeof(CServerEntry));
@@ -404,7 +419,7 @@ CServerBrowser::CServerEntry *CServerBrowser::Add(const NETADDR &Addr)
 	if(m_NumServers == m_NumServerCapacity)
 	{
 		CServerEntry **ppNewlist;
-		m_NumServerCapacity += 100;
+		m_NumServerCapacity = max(m_NumServerCapacity*2, 128);
 		ppNewlist = (CServerEntry **)mem_alloc(m_NumServerCapacity*sizeof(CServerEntry*), 1);
 		mem_copy(ppNewlist, m_ppServerlist, m_NumServers*sizeof(CServerEntry*));
 		mem_free(m_ppServerlist);
@@ -463,7 +478,8 @@ void CServerBrowser::Set(const NETADDR &Addr, int Type, int Token, const CServer
 		}
 	}
 
-	Sort();
+	// sorted once per update, a master list adds many servers at once
+	m_NeedResort = true;
 }
 
 void CServerBrowser::Refresh(int Type)
@@ -476,6 +492,8 @@ void CServerBrowser::Refresh(int Type)
 	m_pFirstReqServer = 0;
 	m_pLastReqServer = 0;
 	m_NumRequests = 0;
+	for(int i = 0; i < IMasterServer::MAX_MASTERSERVERS; i++)
+		m_aMasterRequests[i].m_Active = false;
 
 	// next token
 	m_CurrentLanToken = (m_CurrentLanToken+1)&0xff;
@@ -557,6 +575,101 @@ void CServerBrowser::Request(const NETADDR &Addr) const
 }
 
 
+void CServerBrowser::RequestList(const NETADDR &Addr) const
+{
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(Packet));
+	Packet.m_ClientID = -1;
+	Packet.m_Address = Addr;
+	Packet.m_Flags = NETSENDFLAG_CONNLESS;
+	Packet.m_DataSize = sizeof(SERVERBROWSE_GETLIST);
+	Packet.m_pData = SERVERBROWSE_GETLIST;
+	m_pNetClient->Send(&Packet);
+}
+
+void CServerBrowser::RequestListPage(int MasterIndex, int Page) const
+{
+	unsigned char aBuffer[sizeof(SERVERBROWSE_GETLIST_PAGED)+2];
+	mem_copy(aBuffer, SERVERBROWSE_GETLIST_PAGED, sizeof(SERVERBROWSE_GETLIST_PAGED));
+	aBuffer[sizeof(SERVERBROWSE_GETLIST_PAGED)] = (Page>>8)&0xff;
+	aBuffer[sizeof(SERVERBROWSE_GETLIST_PAGED)+1] = Page&0xff;
+
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(Packet));
+	Packet.m_ClientID = -1;
+	Packet.m_Address = m_aMasterRequests[MasterIndex].m_Addr;
+	Packet.m_Flags = NETSENDFLAG_CONNLESS;
+	Packet.m_DataSize = sizeof(aBuffer);
+	Packet.m_pData = aBuffer;
+	m_pNetClient->Send(&Packet);
+}
+
+void CServerBrowser::OnListPage(int MasterIndex, int Page, int NumPages)
+{
+	CMasterListRequest *pRequest = &m_aMasterRequests[MasterIndex];
+	if(!pRequest->m_Active)
+		return;
+
+	pRequest->m_Paging = PAGING_SUPPORTED;
+	if(pRequest->m_NumPages == -1)
+		pRequest->m_NumPages = min(NumPages, (int)MAX_LIST_PAGES);
+	if(Page < pRequest->m_NumPages && !pRequest->m_aReceived[Page])
+	{
+		pRequest->m_aReceived[Page] = 1;
+		pRequest->m_NumReceived++;
+	}
+	pRequest->m_LastTime = time_get();
+	pRequest->m_Retries = 0;
+
+	// keep a few pages in flight
+	while(pRequest->m_NextPage < pRequest->m_NumPages && pRequest->m_NextPage-pRequest->m_NumReceived < LIST_PAGE_WINDOW)
+		RequestListPage(MasterIndex, pRequest->m_NextPage++);
+
+	if(pRequest->m_NumReceived >= pRequest->m_NumPages)
+		pRequest->m_Active = false;
+}
+
+void CServerBrowser::UpdateListRequests()
+{
+	int64 Now = time_get();
+	for(int i = 0; i < IMasterServer::MAX_MASTERSERVERS; i++)
+	{
+		CMasterListRequest *pRequest = &m_aMasterRequests[i];
+		if(!pRequest->m_Active || Now < pRequest->m_LastTime+time_freq())
+			continue;
+
+		if(pRequest->m_NumPages == -1 && pRequest->m_Retries < LIST_PAGE_RETRIES)
+		{
+			// the first page or its reply may just have been lost
+			pRequest->m_Retries++;
+			pRequest->m_LastTime = Now;
+			RequestListPage(i, 0);
+		}
+		else if(pRequest->m_NumPages == -1)
+		{
+			// no answer after several tries, the master does not know paged requests (anymore).
+			// an unknown master already got the plain request together with the first page
+			pRequest->m_Active = false;
+			if(pRequest->m_Paging == PAGING_SUPPORTED)
+				RequestList(pRequest->m_Addr);
+			pRequest->m_Paging = PAGING_UNSUPPORTED;
+		}
+		else if(pRequest->m_Retries < LIST_PAGE_RETRIES)
+		{
+			// ask again for the pages that got lost
+			pRequest->m_Retries++;
+			pRequest->m_LastTime = Now;
+			for(int p = 0; p < pRequest->m_NextPage; p++)
+			{
+				if(!pRequest->m_aReceived[p])
+					RequestListPage(i, p);
+			}
+		}
+		else
+			pRequest->m_Active = false;
+	}
+}
+
 void CServerBrowser::Update(bool ForceResort)
 {
 	int64 Timeout = time_freq();
@@ -567,32 +680,44 @@ void CServerBrowser::Update(bool ForceResort)
 	// do server list requests
 	if(m_NeedRefresh && !m_pMasterServer->IsRefreshing())
 	{
-		NETADDR Addr;
-		CNetChunk Packet;
-		int i;
-
 		m_NeedRefresh = 0;
 
-		mem_zero(&Packet, sizeof(Packet));
-		Packet.m_ClientID = -1;
-		Packet.m_Flags = NETSENDFLAG_CONNLESS;
-		Packet.m_DataSize = sizeof(SERVERBROWSE_GETLIST);
-		Packet.m_pData = SERVERBROWSE_GETLIST;
-
-		for(i = 0; i < IMasterServer::MAX_MASTERSERVERS; i++)
+		for(int i = 0; i < IMasterServer::MAX_MASTERSERVERS; i++)
 		{
 			if(!m_pMasterServer->IsValid(i))
 				continue;
 
-			Addr = m_pMasterServer->GetAddr(i);
-			Packet.m_Address = Addr;
-			m_pNetClient->Send(&Packet);
+			CMasterListRequest *pRequest = &m_aMasterRequests[i];
+			NETADDR Addr = m_pMasterServer->GetAddr(i);
+			if(net_addr_comp(&pRequest->m_Addr, &Addr) != 0)
+			{
+				pRequest->m_Addr = Addr;
+				pRequest->m_Paging = PAGING_UNKNOWN;
+			}
+
+			// ask for the plain list right away unless the master is known to page,
+			// so old masters don't wait for the paged request to time out
+			if(pRequest->m_Paging != PAGING_SUPPORTED)
+				RequestList(Addr);
+			if(pRequest->m_Paging == PAGING_UNSUPPORTED)
+				continue;
+
+			pRequest->m_Active = true;
+			pRequest->m_NumPages = -1;
+			pRequest->m_NextPage = 1;
+			pRequest->m_NumReceived = 0;
+			pRequest->m_Retries = 0;
+			pRequest->m_LastTime = Now;
+			mem_zero(pRequest->m_aReceived, sizeof(pRequest->m_aReceived));
+			RequestListPage(i, 0);
 		}
 
 		if(g_Config.m_Debug)
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client_srvbrowse", "requesting server list");
 	}
 
+	UpdateListRequests();
+
 	// do timeouts
 	pEntry = m_pFirstReqServer;
 	while(1)
@@ -631,7 +756,7 @@ void CServerBrowser::Update(bool ForceResort)
 	}
 
 	// check if we need to resort
-	if(m_Sorthash != SortHash() || ForceResort)
+	if(m_Sorthash != SortHash() || ForceResort || m_NeedResort)
 		Sort();
 }
 
@@ -3,6 +3,7 @@
 #ifndef ENGINE_CLIENT_SERVERBROWSER_H
 #define ENGINE_CLIENT_SERVERBROWSER_H
 
+#include <engine/masterserver.h>
 #include <engine/serverbrowser.h>
 
 class CServerBrowser : public IServerBrowser
@@ -33,7 +34,16 @@ public:
 
 	enum
 	{
-		MAX_FAVORITES=256
+		MAX_FAVORITES=256,
+		SERVERLIST_HASH_SIZE=4096, // must be a power of two
+
+		MAX_LIST_PAGES=1024,
+		LIST_PAGE_WINDOW=4, // pages requested at once from a master
+		LIST_PAGE_RETRIES=3,
+
+		PAGING_UNKNOWN=0,
+		PAGING_SUPPORTED,
+		PAGING_UNSUPPORTED,
 	};
 
 	CServerBrowser();
@@ -57,6 +67,8 @@ public:
 	void Update(bool ForceResort);
 	void Set(const NETADDR &Addr, int Type, int Token, const CServerInfo *pInfo);
 	void Request(const NETADDR &Addr) const;
+	void OnListPage(int MasterIndex, int Page, int NumPages);
+	bool IgnoreUnpagedList(int MasterIndex) const { return m_aMasterRequests[MasterIndex].m_Paging == PAGING_SUPPORTED; }
 
 	void SetBaseInfo(class CNetClient *pClient, const char *pNetVersion);
 
@@ -74,13 +86,29 @@ private:
 	NETADDR m_aFavoriteServers[MAX_FAVORITES];
 	int m_NumFavoriteServers;
 
-	CServerEntry *m_aServerlistIp[256]; // ip hash list
+	CServerEntry *m_aServerlistIp[SERVERLIST_HASH_SIZE]; // address hash list
 
 	CServerEntry *m_pFirstReqServer; // request list
 	CServerEntry *m_pLastReqServer;
 	int m_NumRequests;
 
 	int m_NeedRefresh;
+	bool m_NeedResort;
+
+	// paged list requests, masters not known to page also get the plain list request
+	struct CMasterListRequest
+	{
+		NETADDR m_Addr;
+		bool m_Active;
+		int m_Paging; // kept across refreshes until the address changes
+		int m_NumPages; // -1 until the first page arrived
+		int m_NextPage;
+		int m_NumReceived;
+		int m_Retries;
+		int64 m_LastTime;
+		unsigned char m_aReceived[MAX_LIST_PAGES];
+	};
+	CMasterListRequest m_aMasterRequests[IMasterServer::MAX_MASTERSERVERS];
 
 	int m_NumSortedServers;
 	int m_NumSortedServersCapacity;
@@ -117,6 +145,9 @@ private:
 	void QueueRequest(CServerEntry *pEntry);
 
 	void RequestImpl(const NETADDR &Addr, CServerEntry *pEntry) const;
+	void RequestListPage(int MasterIndex, int Page) const;
+	void RequestList(const NETADDR &Addr) const;
+	void UpdateListRequests();
 
 	void SetInfo(CServerEntry *pEntry, const CServerInfo &Info);
 
@@ -120,6 +120,15 @@ public:
 			: m_X0(x0), m_Y0(y0), m_X1(x1), m_Y1(y1), m_X2(x2), m_Y2(y2), m_X3(x3), m_Y3(y3) {}
 	};
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num) = 0;
+
+	// prebuilt quads, 4 vertices each: top left, top right, bottom right and
+	// bottom left. they take the colors from SetColor and aren't rotated
+	struct CQuadVertex
+	{
+		float m_X, m_Y;
+		float m_U, m_V;
+	};
+	virtual void QuadsDrawVertices(const CQuadVertex *pArray, int NumQuads) = 0;
 	virtual void QuadsText(float x, float y, float Size, const char *pText) = 0;
 
 	struct CColorVertex
@@ -147,6 +156,15 @@ class IEngineGraphics : public IGraphics
 {
 	MACRO_INTERFACE("enginegraphics", 0)
 public:
+	// counted over one frame, from swap to swap
+	struct CFrameStats
+	{
+		int m_NumFlushes; // draw calls
+		int m_NumVertices;
+		int m_NumKicks; // command buffers handed to the backend
+		int64 m_WaitTime; // spent waiting for the backend
+	};
+
 	virtual int Init() = 0;
 	virtual void Shutdown() = 0;
 
@@ -156,6 +174,8 @@ public:
 	virtual int WindowActive() = 0;
 	virtual int WindowOpen() = 0;
 
+	// the stats of the last finished frame
+	virtual const CFrameStats *FrameStats() const = 0;
 };
 
 extern IEngineGraphics *CreateEngineGraphics();
@@ -0,0 +1,210 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <engine/storage.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/snapshot.h>
+
+#include "inputlog.h"
+
+static const char gs_aInputLogID[4] = {'T', 'W', 'I', 'L'};
+
+CInputLogWriter::CInputLogWriter()
+{
+	m_File = 0;
+}
+
+bool CInputLogWriter::Start(IStorage *pStorage, const char *pFilename, const CInputLog::CHeader *pHeader)
+{
+	Stop();
+	m_File = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!m_File)
+	{
+		dbg_msg("inputlog", "unable to open '%s' for recording", pFilename);
+		return false;
+	}
+
+	CInputLog::CHeader Header = *pHeader;
+	mem_copy(Header.m_aID, gs_aInputLogID, sizeof(Header.m_aID));
+	Header.m_Version = CInputLog::VERSION;
+	io_write(m_File, &Header, sizeof(Header));
+	dbg_msg("inputlog", "recording inputs to '%s'", pFilename);
+	return true;
+}
+
+void CInputLogWriter::Stop()
+{
+	if(!m_File)
+		return;
+	io_close(m_File);
+	m_File = 0;
+}
+
+void CInputLogWriter::AddRecord(int Tick, int Type, int ClientID, const void *pData, int Size)
+{
+	if(!m_File || Size < 0 || Size > CInputLog::MAX_RECORD_SIZE)
+		return;
+
+	CInputLog::CRecordHeader Header;
+	Header.m_Tick = Tick;
+	Header.m_Type = Type;
+	Header.m_ClientID = ClientID;
+	Header.m_Size = Size;
+	io_write(m_File, &Header, sizeof(Header));
+	if(Size)
+		io_write(m_File, pData, Size);
+}
+
+void CInputLogWriter::AddInput(int Tick, int Type, int ClientID, const int *pInput)
+{
+	if(!m_File)
+		return;
+
+	// only the sent part of the input is set, the rest stays zero
+	int NumInts = MAX_INPUT_SIZE;
+	while(NumInts > 0 && pInput[NumInts-1] == 0)
+		NumInts--;
+
+	unsigned char aData[MAX_INPUT_SIZE*5]; // at most 5 bytes per packed int
+	int Size = CVariableInt::Compress(pInput, NumInts*sizeof(int), aData);
+	AddRecord(Tick, Type, ClientID, aData, Size);
+}
+
+CInputLogReader::CInputLogReader()
+{
+	m_File = 0;
+	mem_zero(&m_Header, sizeof(m_Header));
+}
+
+CInputLogReader::~CInputLogReader()
+{
+	Close();
+}
+
+bool CInputLogReader::Open(IStorage *pStorage, const char *pFilename)
+{
+	Close();
+	m_File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!m_File)
+	{
+		dbg_msg("inputlog", "could not open '%s'", pFilename);
+		return false;
+	}
+
+	if(io_read(m_File, &m_Header, sizeof(m_Header)) != sizeof(m_Header) ||
+		mem_comp(m_Header.m_aID, gs_aInputLogID, sizeof(m_Header.m_aID)) != 0 || m_Header.m_Version != CInputLog::VERSION)
+	{
+		dbg_msg("inputlog", "'%s' is not an input log of this version", pFilename);
+		Close();
+		return false;
+	}
+	m_Header.m_aMapName[sizeof(m_Header.m_aMapName)-1] = 0;
+	return true;
+}
+
+void CInputLogReader::Close()
+{
+	if(!m_File)
+		return;
+	io_close(m_File);
+	m_File = 0;
+}
+
+bool CInputLogReader::Next(CRecord *pRecord)
+{
+	if(!m_File)
+		return false;
+
+	CInputLog::CRecordHeader Header;
+	if(io_read(m_File, &Header, sizeof(Header)) != sizeof(Header))
+		return false;
+	if(Header.m_Type >= CInputLog::NUM_EVENTS || Header.m_ClientID >= MAX_CLIENTS || Header.m_Size > CInputLog::MAX_RECORD_SIZE ||
+		io_read(m_File, pRecord->m_aData, Header.m_Size) != Header.m_Size)
+	{
+		dbg_msg("inputlog", "broken record at tick %d", Header.m_Tick);
+		return false;
+	}
+
+	pRecord->m_Tick = Header.m_Tick;
+	pRecord->m_Type = Header.m_Type;
+	pRecord->m_ClientID = Header.m_ClientID;
+	pRecord->m_Size = Header.m_Size;
+	pRecord->m_aData[Header.m_Size] = 0;
+
+	if(Header.m_Type == CInputLog::EVENT_DIRECT_INPUT || Header.m_Type == CInputLog::EVENT_PREDICTED_INPUT)
+	{
+		// a packed int is at least one byte, so the input can't overflow
+		if(Header.m_Size > MAX_INPUT_SIZE)
+			return false;
+		mem_zero(pRecord->m_aInput, sizeof(pRecord->m_aInput));
+		CVariableInt::Decompress(pRecord->m_aData, Header.m_Size, pRecord->m_aInput);
+	}
+	return true;
+}
+
+class CSnapshotCrcListener : public CDemoPlayer::IListner
+{
+public:
+	CDemoPlayer *m_pPlayer;
+	array<CDemoSnapshotCrcs::CSnapshotCrc> *m_plCrcs;
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		CDemoSnapshotCrcs::CSnapshotCrc Crc;
+		Crc.m_Tick = m_pPlayer->BaseInfo()->m_CurrentTick;
+		Crc.m_Crc = ((CSnapshot *)pData)->Crc();
+		m_plCrcs->add(Crc);
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size) {}
+};
+
+CDemoSnapshotCrcs::CDemoSnapshotCrcs()
+{
+	m_Next = 0;
+	m_NumChecked = 0;
+	m_NumMismatches = 0;
+	m_NumMissing = 0;
+	m_FirstMismatchTick = -1;
+}
+
+bool CDemoSnapshotCrcs::Load(IStorage *pStorage, IConsole *pConsole, CSnapshotDelta *pDelta, const char *pFilename)
+{
+	// the delta has to know the static item sizes of the recording server
+	CDemoPlayer *pPlayer = new CDemoPlayer(pDelta);
+	CSnapshotCrcListener Listener;
+	Listener.m_pPlayer = pPlayer;
+	Listener.m_plCrcs = &m_lCrcs;
+	pPlayer->SetListner(&Listener);
+
+	bool Loaded = pPlayer->Load(pStorage, pConsole, pFilename, IStorage::TYPE_ALL) == 0;
+	if(Loaded)
+	{
+		while(pPlayer->IsPlaying() && !pPlayer->BaseInfo()->m_Paused)
+			pPlayer->NextFrame();
+		pPlayer->Stop();
+	}
+
+	delete pPlayer;
+	return Loaded;
+}
+
+void CDemoSnapshotCrcs::Check(int Tick, int Crc)
+{
+	// both come in tick order
+	while(m_Next < m_lCrcs.size() && m_lCrcs[m_Next].m_Tick < Tick)
+		m_Next++;
+	if(m_Next == m_lCrcs.size() || m_lCrcs[m_Next].m_Tick != Tick)
+	{
+		m_NumMissing++;
+		return;
+	}
+
+	m_NumChecked++;
+	if(m_lCrcs[m_Next].m_Crc != Crc)
+	{
+		if(m_FirstMismatchTick == -1)
+			m_FirstMismatchTick = Tick;
+		m_NumMismatches++;
+	}
+}
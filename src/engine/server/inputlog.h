@@ -0,0 +1,135 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SERVER_INPUTLOG_H
+#define ENGINE_SERVER_INPUTLOG_H
+
+#include <base/system.h>
+#include <base/tl/array.h>
+#include <engine/shared/protocol.h>
+
+/*
+	everything the clients did to the game during one map: connects, drops,
+	inputs, game messages and rcon commands, each tagged with the server tick
+	it happened in. together with the tick and snapshot markers and the seed
+	of rand() this is enough to run the map again offline, see CServer::RunReplay.
+	records are written in native byte order, the file is only meant to be
+	replayed on the same kind of machine.
+*/
+class CInputLog
+{
+public:
+	enum
+	{
+		VERSION=1,
+		MAX_RECORD_SIZE=2048, // more than a chunk can carry
+
+		EVENT_TICK=0, // right before OnTick
+		EVENT_SNAPSHOT, // right before the snapshots are built
+		EVENT_CONNECT,
+		EVENT_ENTER,
+		EVENT_DROP, // data is the reason
+		EVENT_DIRECT_INPUT, // data is the variable int packed input
+		EVENT_PREDICTED_INPUT,
+		EVENT_MESSAGE, // data is the whole chunk, msg id included
+		EVENT_RCON, // data is the access level followed by the command
+		EVENT_DEMO, // an auto recorded demo started, data is its filename
+		EVENT_LATENCY, // data is the measured latency
+		NUM_EVENTS
+	};
+
+	struct CHeader
+	{
+		char m_aID[4];
+		int m_Version;
+		char m_aMapName[64];
+		unsigned m_MapCrc;
+		unsigned m_Seed;
+		int m_MaxClients;
+		int m_Mode;
+	};
+
+	struct CRecordHeader
+	{
+		int m_Tick;
+		unsigned char m_Type;
+		unsigned char m_ClientID;
+		unsigned short m_Size;
+	};
+};
+
+class CInputLogWriter
+{
+	IOHANDLE m_File;
+
+public:
+	CInputLogWriter();
+
+	bool Start(class IStorage *pStorage, const char *pFilename, const CInputLog::CHeader *pHeader);
+	void Stop();
+	bool IsRecording() const { return m_File != 0; }
+
+	void AddRecord(int Tick, int Type, int ClientID, const void *pData, int Size);
+	void AddString(int Tick, int Type, int ClientID, const char *pStr) { AddRecord(Tick, Type, ClientID, pStr, str_length(pStr)+1); }
+	void AddInput(int Tick, int Type, int ClientID, const int *pInput); // MAX_INPUT_SIZE ints
+};
+
+class CInputLogReader
+{
+	IOHANDLE m_File;
+	CInputLog::CHeader m_Header;
+
+public:
+	struct CRecord
+	{
+		int m_Tick;
+		int m_Type;
+		int m_ClientID;
+		int m_Size;
+		unsigned char m_aData[CInputLog::MAX_RECORD_SIZE+1]; // strings are always terminated
+		int m_aInput[MAX_INPUT_SIZE]; // unpacked for the input events
+	};
+
+	CInputLogReader();
+	~CInputLogReader();
+
+	bool Open(class IStorage *pStorage, const char *pFilename);
+	void Close();
+	const CInputLog::CHeader *Header() const { return &m_Header; }
+
+	// false at the end of the file or on a broken record
+	bool Next(CRecord *pRecord);
+};
+
+/*
+	the snapshot crcs of a demo, used to check that a replay builds the same
+	snapshots as the server that recorded it. the crc of a snapshot doesn't
+	depend on the order of its items, so the unpacked demo snapshots compare
+	fine to freshly built ones
+*/
+class CDemoSnapshotCrcs
+{
+public:
+	struct CSnapshotCrc
+	{
+		int m_Tick;
+		int m_Crc;
+	};
+
+private:
+	array<CSnapshotCrc> m_lCrcs;
+	int m_Next;
+
+public:
+	int m_NumChecked;
+	int m_NumMismatches;
+	int m_NumMissing; // built by the replay but not in the demo
+	int m_FirstMismatchTick;
+
+	CDemoSnapshotCrcs();
+
+	bool Load(class IStorage *pStorage, class IConsole *pConsole, class CSnapshotDelta *pDelta, const char *pFilename);
+	void Check(int Tick, int Crc);
+	int NumSnapshots() const { return m_lCrcs.size(); }
+};
+
+#endif
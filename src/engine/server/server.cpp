@@ -20,14 +20,17 @@
 #include <engine/shared/econ.h>
 #include <engine/shared/filecollection.h>
 #include <engine/shared/mapchecker.h>
+#include <engine/shared/moderation.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
+#include <engine/shared/rconcmdlist.h>
 #include <engine/shared/snapshot.h>
 
 #include <mastersrv/mastersrv.h>
 
+#include "inputlog.h"
 #include "register.h"
 #include "server.h"
 
@@ -189,7 +192,7 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 	if(Server()->m_RconClientID >= 0 && Server()->m_RconClientID < MAX_CLIENTS &&
 		Server()->m_aClients[Server()->m_RconClientID].m_State != CServer::CClient::STATE_EMPTY)
 	{
-		if(NetMatch(pData, Server()->m_NetServer.ClientAddr(Server()->m_RconClientID)))
+		if(NetMatch(pData, Server()->NetClientAddr(Server()->m_RconClientID)))
 		{
 			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban error (you can't ban yourself)");
 			return -1;
@@ -200,7 +203,7 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 			if(i == Server()->m_RconClientID || Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY)
 				continue;
 
-			if(Server()->m_aClients[i].m_Authed >= Server()->m_RconAuthLevel && NetMatch(pData, Server()->m_NetServer.ClientAddr(i)))
+			if(Server()->m_aClients[i].m_Authed >= Server()->m_RconAuthLevel && NetMatch(pData, Server()->NetClientAddr(i)))
 			{
 				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban error (command denied)");
 				return -1;
@@ -214,7 +217,7 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 			if(Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY)
 				continue;
 
-			if(Server()->m_aClients[i].m_Authed != CServer::AUTHED_NO && NetMatch(pData, Server()->m_NetServer.ClientAddr(i)))
+			if(Server()->m_aClients[i].m_Authed != CServer::AUTHED_NO && NetMatch(pData, Server()->NetClientAddr(i)))
 			{
 				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban error (command denied)");
 				return -1;
@@ -233,12 +236,11 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 		if(Server()->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY)
 			continue;
 
-		if(NetMatch(&Data, Server()->m_NetServer.ClientAddr(i)))
+		if(NetMatch(&Data, Server()->NetClientAddr(i)))
 		{
-			CNetHash NetHash(&Data);
 			char aBuf[256];
-			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
-			Server()->m_NetServer.Drop(i, aBuf);
+			MakeBanInfo(pBanPool->Find(&Data), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
+			Server()->DropClient(i, aBuf);
 		}
 	}
 
@@ -305,7 +307,7 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 		NETADDR Addr;
 		if(net_addr_from_str(&Addr, pStr) == 0)
 			for(int i = 0; i < MAX_CLIENTS; i++)
-				if(pThis->NetMatch(&Addr, pThis->Server()->m_NetServer.ClientAddr(i)))
+				if(pThis->NetMatch(&Addr, pThis->Server()->NetClientAddr(i)))
 				{
 					CID = i;
 					break;
@@ -318,7 +320,7 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 		if(ClientID < 0 || ClientID >= MAX_CLIENTS || pThis->Server()->m_aClients[ClientID].m_State == CServer::CClient::STATE_EMPTY)
 			pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban error (invalid client id)");
 		else
-			pThis->BanAddr(pThis->Server()->m_NetServer.ClientAddr(ClientID), Minutes*60, pReason);
+			pThis->BanAddr(pThis->Server()->NetClientAddr(ClientID), Minutes*60, pReason);
 	}
 	else
 		ConBan(pResult, pUser);
@@ -328,9 +330,8 @@ void CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 void CServer::CClient::Reset()
 {
 	// reset input
-	for(int i = 0; i < 200; i++)
+	for(int i = 0; i < INPUT_RING_SIZE; i++)
 		m_aInputs[i].m_GameTick = -1;
-	m_CurrentInput = 0;
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
 
 	m_Snapshots.PurgeAll();
@@ -340,7 +341,23 @@ void CServer::CClient::Reset()
 	m_Score = 0;
 }
 
-CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
+void CServer::CClient::AddInput(const CInput *pInput)
+{
+	// several inputs can end up at the same tick when they arrive late or
+	// duplicated, the one the client sent for the most recent tick wins
+	CInput *pSlot = &m_aInputs[pInput->m_GameTick&(INPUT_RING_SIZE-1)];
+	if(pSlot->m_GameTick == pInput->m_GameTick && pSlot->m_IntendedTick > pInput->m_IntendedTick)
+		return;
+	*pSlot = *pInput;
+}
+
+CServer::CClient::CInput *CServer::CClient::GetInput(int Tick)
+{
+	CInput *pSlot = &m_aInputs[Tick&(INPUT_RING_SIZE-1)];
+	return pSlot->m_GameTick == Tick ? pSlot : 0;
+}
+
+CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta, true)
 {
 	m_TickSpeed = SERVER_TICK_SPEED;
 
@@ -356,11 +373,15 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_RconClientID = IServer::RCON_CID_SERV;
 	m_RconAuthLevel = AUTHED_SUBADMIN;
+	m_Offline = false;
+	m_OfflineMaxClients = 0;
+	m_pReplayCrcs = 0;
+	m_ServerInfoDirty = true;
+	m_RconCmdBatchesDirty = true;
 	
 	// when starting there are no admins
 	m_numLoggedInAdmins = 0;
 	
-	m_Votebans = NULL;
 	m_InfoTexts = NULL;
 	m_InfoTextInterval = -1;
 	
@@ -369,14 +390,6 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 CServer::~CServer()
 {
-	// delte votebans
-	while(m_Votebans != NULL)
-	{
-		CVoteban *tmp = m_Votebans->m_Next;
-		delete m_Votebans;
-		m_Votebans = tmp;
-	}
-	
 	// delte info texts
 	while(m_InfoTexts != NULL)
 	{
@@ -436,6 +449,7 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 
 	// set the client name
 	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+	m_ServerInfoDirty = true;
 	return 0;
 }
 
@@ -468,6 +482,8 @@ void CServer::SetClientClan(int ClientID, const char *pClan)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY || !pClan)
 		return;
 
+	if(str_comp(m_aClients[ClientID].m_aClan, pClan) != 0)
+		m_ServerInfoDirty = true;
 	str_copy(m_aClients[ClientID].m_aClan, pClan, MAX_CLAN_LENGTH);
 }
 
@@ -476,6 +492,8 @@ void CServer::SetClientCountry(int ClientID, int Country)
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
 
+	if(m_aClients[ClientID].m_Country != Country)
+		m_ServerInfoDirty = true;
 	m_aClients[ClientID].m_Country = Country;
 }
 
@@ -483,6 +501,8 @@ void CServer::SetClientScore(int ClientID, int Score)
 {
 	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State < CClient::STATE_READY)
 		return;
+	if(m_aClients[ClientID].m_Score != Score)
+		m_ServerInfoDirty = true;
 	m_aClients[ClientID].m_Score = Score;
 }
 
@@ -504,7 +524,7 @@ void CServer::Kick(int ClientID, const char *pReason)
  		return;
 	}
 
-	m_NetServer.Drop(ClientID, pReason);
+	DropClient(ClientID, pReason);
 }
 
 /*int CServer::Tick()
@@ -533,7 +553,6 @@ int CServer::Init()
 		m_aClients[i].m_Snapshots.Init();
 	}
 
-	AdjustVotebanTime(m_CurrentGameTick);
 	m_CurrentGameTick = 0;
 
 	return 0;
@@ -566,7 +585,14 @@ int CServer::GetClientInfo(int ClientID, CClientInfo *pInfo)
 void CServer::GetClientAddr(int ClientID, char *pAddrStr, int Size)
 {
 	if(ClientID >= 0 && ClientID < MAX_CLIENTS && m_aClients[ClientID].m_State == CClient::STATE_INGAME)
-		net_addr_str(m_NetServer.ClientAddr(ClientID), pAddrStr, Size, false);
+		net_addr_str(NetClientAddr(ClientID), pAddrStr, Size, false);
+}
+
+const NETADDR *CServer::ClientAddr(int ClientID)
+{
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS || m_aClients[ClientID].m_State == CClient::STATE_EMPTY)
+		return 0;
+	return NetClientAddr(ClientID);
 }
 
 
@@ -608,7 +634,7 @@ bool CServer::ClientIngame(int ClientID)
 
 int CServer::MaxClients() const
 {
-	return m_NetServer.MaxClients();
+	return m_Offline ? m_OfflineMaxClients : m_NetServer.MaxClients();
 }
 
 int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
@@ -642,7 +668,7 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	if(!(Flags&MSGFLAG_NORECORD))
 		m_DemoRecorder.RecordMessage(pMsg->Data(), pMsg->Size());
 
-	if(!(Flags&MSGFLAG_NOSEND))
+	if(!(Flags&MSGFLAG_NOSEND) && !m_Offline)
 	{
 		if(ClientID == -1)
 		{
@@ -663,10 +689,11 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 
 void CServer::DoSnapshot()
 {
+	m_InputLog.AddRecord(Tick(), CInputLog::EVENT_SNAPSHOT, 0, 0, 0);
 	GameServer()->OnPreSnap();
 
-	// create snapshot for demo recording
-	if(m_DemoRecorder.IsRecording())
+	// create snapshot for demo recording, a replay compares it to the recorded one
+	if(m_DemoRecorder.IsRecording() || m_pReplayCrcs)
 	{
 		char aData[CSnapshot::MAX_SIZE];
 		int SnapshotSize;
@@ -677,7 +704,10 @@ void CServer::DoSnapshot()
 		SnapshotSize = m_SnapshotBuilder.Finish(aData);
 
 		// write snapshot
-		m_DemoRecorder.RecordSnapshot(Tick(), aData, SnapshotSize);
+		if(m_DemoRecorder.IsRecording())
+			m_DemoRecorder.RecordSnapshot(Tick(), aData, SnapshotSize);
+		if(m_pReplayCrcs)
+			m_pReplayCrcs->Check(Tick(), ((CSnapshot *)aData)->Crc());
 	}
 
 	// create snapshots for all clients
@@ -798,6 +828,7 @@ int CServer::NewClientCallback(int ClientID, void *pUser)
 {
 	CServer *pThis = (CServer *)pUser;
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_AUTH;
+	pThis->m_ServerInfoDirty = true;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
 	pThis->m_aClients[ClientID].m_Country = -1;
@@ -813,16 +844,20 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 	CServer *pThis = (CServer *)pUser;
 
 	char aAddrStr[NETADDR_MAXSTRSIZE];
-	net_addr_str(pThis->m_NetServer.ClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
+	net_addr_str(pThis->NetClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "client dropped. cid=%d addr=%s reason='%s'", ClientID, aAddrStr,	pReason);
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 
 	// notify the mod about the drop
 	if(pThis->m_aClients[ClientID].m_State >= CClient::STATE_READY)
+	{
+		pThis->m_InputLog.AddString(pThis->Tick(), CInputLog::EVENT_DROP, ClientID, pReason);
 		pThis->GameServer()->OnClientDrop(ClientID, pReason);
+	}
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
+	pThis->m_ServerInfoDirty = true;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
 	pThis->m_aClients[ClientID].m_Country = -1;
@@ -893,17 +928,100 @@ void CServer::SendRconCmdRem(const IConsole::CCommandInfo *pCommandInfo, int Cli
 	SendMsgEx(&Msg, MSGFLAG_VITAL, ClientID, true);
 }
 
-void CServer::UpdateClientRconCommands()
+void CServer::StartRconCmdSend(int ClientID, int AccessLevel, int Mode)
+{
+	m_aClients[ClientID].m_pRconCmdToSend = Console()->FirstCommandInfo(AccessLevel, CFGFLAG_SERVER);
+	m_aClients[ClientID].m_RconCmdAccessLevel = AccessLevel;
+	m_aClients[ClientID].m_RconCmdPacked = Mode == RCON_CMDLIST_PACKED;
+}
+
+void CServer::BuildRconCmdBatches(int AccessLevel)
+{
+	std::vector<CRconCmdBatch> &lBatches = m_aRconCmdBatches[AccessLevel];
+	lBatches.clear();
+
+	const IConsole::CCommandInfo *pInfo = Console()->FirstCommandInfo(AccessLevel, CFGFLAG_SERVER);
+	while(pInfo)
+	{
+		CRconCmdBatch Batch;
+		Batch.m_pFirst = pInfo;
+
+		// the count goes first, so pack the commands separately
+		CPacker Commands;
+		Commands.Reset();
+		int NumCommands = 0;
+		for(; pInfo; pInfo = pInfo->NextCommandInfo(AccessLevel, CFGFLAG_SERVER))
+		{
+			CPacker Entry;
+			Entry.Reset();
+			Entry.AddString(pInfo->m_pName, IConsole::TEMPCMD_NAME_LENGTH);
+			Entry.AddString(pInfo->m_pHelp, IConsole::TEMPCMD_HELP_LENGTH);
+			Entry.AddString(pInfo->m_pParams, IConsole::TEMPCMD_PARAMS_LENGTH);
+			if(NumCommands && Commands.Size()+Entry.Size() > RCONCMD_BATCH_SIZE-8)
+				break;
+			Commands.AddRaw(Entry.Data(), Entry.Size());
+			NumCommands++;
+		}
+		Batch.m_pNext = pInfo;
+
+		CPacker Payload;
+		Payload.Reset();
+		Payload.AddInt(NumCommands);
+		Payload.AddRaw(Commands.Data(), Commands.Size());
+		Batch.m_Size = Payload.Size();
+		mem_copy(Batch.m_aData, Payload.Data(), Payload.Size());
+		lBatches.push_back(Batch);
+	}
+}
+
+const CServer::CRconCmdBatch *CServer::FindRconCmdBatch(int AccessLevel, const IConsole::CCommandInfo *pFirst)
 {
-	int ClientID = Tick() % MAX_CLIENTS;
+	if(m_RconCmdBatchesDirty)
+	{
+		for(int i = 0; i < NUM_RCONCMD_LISTS; i++)
+			m_aRconCmdBatches[i].clear();
+		m_RconCmdBatchesDirty = false;
+	}
+	if(m_aRconCmdBatches[AccessLevel].empty())
+		BuildRconCmdBatches(AccessLevel);
+
+	for(unsigned i = 0; i < m_aRconCmdBatches[AccessLevel].size(); i++)
+	{
+		if(m_aRconCmdBatches[AccessLevel][i].m_pFirst == pFirst)
+			return &m_aRconCmdBatches[AccessLevel][i];
+	}
+	return 0;
+}
 
-	if(m_aClients[ClientID].m_State != CClient::STATE_EMPTY && m_aClients[ClientID].m_Authed)
+void CServer::UpdateClientRconCommands()
+{
+	for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
 	{
-		int ConsoleAccessLevel = m_aClients[ClientID].m_Authed == AUTHED_ADMIN ? IConsole::ACCESS_LEVEL_ADMIN : (AUTHED_SUBADMIN ? IConsole::ACCESS_LEVEL_SUBADMIN : IConsole::ACCESS_LEVEL_MOD);
-		for(int i = 0; i < MAX_RCONCMD_SEND && m_aClients[ClientID].m_pRconCmdToSend; ++i)
+		CClient *pClient = &m_aClients[ClientID];
+		if(pClient->m_State == CClient::STATE_EMPTY || !pClient->m_Authed || !pClient->m_pRconCmdToSend)
+			continue;
+
+		if(pClient->m_RconCmdPacked)
 		{
-			SendRconCmdAdd(m_aClients[ClientID].m_pRconCmdToSend, ClientID);
-			m_aClients[ClientID].m_pRconCmdToSend = m_aClients[ClientID].m_pRconCmdToSend->NextCommandInfo(ConsoleAccessLevel, CFGFLAG_SERVER);
+			// one batch per tick. if the lists were rebuilt in the meantime, single commands
+			// are sent until the position lines up with the start of a batch again
+			const CRconCmdBatch *pBatch = FindRconCmdBatch(pClient->m_RconCmdAccessLevel, pClient->m_pRconCmdToSend);
+			if(pBatch)
+			{
+				CMsgPacker Msg(NETMSG_RCON_CMD_LIST);
+				Msg.AddRaw(pBatch->m_aData, pBatch->m_Size);
+				SendMsgEx(&Msg, MSGFLAG_VITAL, ClientID, true);
+				pClient->m_pRconCmdToSend = pBatch->m_pNext;
+				continue;
+			}
+		}
+		else if(ClientID != Tick() % MAX_CLIENTS)
+			continue;
+
+		for(int i = 0; i < MAX_RCONCMD_SEND && pClient->m_pRconCmdToSend; ++i)
+		{
+			SendRconCmdAdd(pClient->m_pRconCmdToSend, ClientID);
+			pClient->m_pRconCmdToSend = pClient->m_pRconCmdToSend->NextCommandInfo(pClient->m_RconCmdAccessLevel, CFGFLAG_SERVER);
 		}
 	}
 }
@@ -935,7 +1053,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					// wrong version
 					char aReason[256];
 					str_format(aReason, sizeof(aReason), "Wrong version. Server is running '%s' and client '%s'", GameServer()->NetVersion(), pVersion);
-					m_NetServer.Drop(ClientID, aReason);
+					DropClient(ClientID, aReason);
 					return;
 				}
 
@@ -943,7 +1061,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				if(g_Config.m_Password[0] != 0 && str_comp(g_Config.m_Password, pPassword) != 0)
 				{
 					// wrong password
-					m_NetServer.Drop(ClientID, "Wrong password");
+					DropClient(ClientID, "Wrong password");
 					return;
 				}
 
@@ -993,12 +1111,13 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && m_aClients[ClientID].m_State == CClient::STATE_CONNECTING)
 			{
 				char aAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(m_NetServer.ClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
+				net_addr_str(NetClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
 
 				char aBuf[256];
 				str_format(aBuf, sizeof(aBuf), "player is ready. ClientID=%x addr=%s", ClientID, aAddrStr);
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_READY;
+				m_InputLog.AddRecord(Tick(), CInputLog::EVENT_CONNECT, ClientID, 0, 0);
 				GameServer()->OnClientConnected(ClientID);
 				SendConnectionReady(ClientID);
 			}
@@ -1008,18 +1127,19 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && m_aClients[ClientID].m_State == CClient::STATE_READY && GameServer()->IsClientReady(ClientID))
 			{
 				char aAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(m_NetServer.ClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
+				net_addr_str(NetClientAddr(ClientID), aAddrStr, sizeof(aAddrStr), true);
 
 				char aBuf[256];
 				str_format(aBuf, sizeof(aBuf), "player has entered the game. ClientID=%x addr=%s", ClientID, aAddrStr);
 				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_INGAME;
+				m_InputLog.AddRecord(Tick(), CInputLog::EVENT_ENTER, ClientID, 0, 0);
 				GameServer()->OnClientEnter(ClientID);
 			}
 		}
 		else if(Msg == NETMSG_INPUT)
 		{
-			CClient::CInput *pInput;
+			CClient::CInput Input;
 			int64 TagTime;
 
 			m_aClients[ClientID].m_LastAckedSnapshot = Unpacker.GetInt();
@@ -1034,7 +1154,13 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
 
 			if(m_aClients[ClientID].m_Snapshots.Get(m_aClients[ClientID].m_LastAckedSnapshot, &TagTime, 0, 0) >= 0)
-				m_aClients[ClientID].m_Latency = (int)(((time_get()-TagTime)*1000)/time_freq());
+			{
+				// the latency ends up in the snapshots, a replay has to know it
+				int Latency = (int)(((time_get()-TagTime)*1000)/time_freq());
+				if(Latency != m_aClients[ClientID].m_Latency)
+					m_InputLog.AddRecord(Tick(), CInputLog::EVENT_LATENCY, ClientID, &Latency, sizeof(Latency));
+				m_aClients[ClientID].m_Latency = Latency;
+			}
 
 			// add message to report the input timing
 			// skip packets that are old
@@ -1050,24 +1176,29 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientID].m_LastInputTick = IntendedTick;
 
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
+			mem_zero(&Input, sizeof(Input));
+			Input.m_IntendedTick = IntendedTick;
 
 			if(IntendedTick <= Tick())
 				IntendedTick = Tick()+1;
 
-			pInput->m_GameTick = IntendedTick;
+			Input.m_GameTick = IntendedTick;
 
 			for(int i = 0; i < Size/4; i++)
-				pInput->m_aData[i] = Unpacker.GetInt();
+				Input.m_aData[i] = Unpacker.GetInt();
 
-			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
+			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, Input.m_aData, MAX_INPUT_SIZE*sizeof(int));
 
-			m_aClients[ClientID].m_CurrentInput++;
-			m_aClients[ClientID].m_CurrentInput %= 200;
+			// inputs too far ahead would take the slot of a pending tick
+			if(IntendedTick-Tick() < CClient::INPUT_RING_SIZE)
+				m_aClients[ClientID].AddInput(&Input);
 
 			// call the mod with the fresh input data
 			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
+			{
+				m_InputLog.AddInput(Tick(), CInputLog::EVENT_DIRECT_INPUT, ClientID, m_aClients[ClientID].m_LatestInput.m_aData);
 				GameServer()->OnClientDirectInput(ClientID, m_aClients[ClientID].m_LatestInput.m_aData);
+			}
 		}
 		else if(Msg == NETMSG_RCON_CMD)
 		{
@@ -1090,6 +1221,13 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					char aBuf[256];
 					str_format(aBuf, sizeof(aBuf), "ClientID=%d rcon='%s'", ClientID, pCmd);
 					Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
+					if(m_InputLog.IsRecording())
+					{
+						char aRecord[CInputLog::MAX_RECORD_SIZE];
+						aRecord[0] = m_aClients[ClientID].m_Authed;
+						str_copy(aRecord+1, pCmd, sizeof(aRecord)-1);
+						m_InputLog.AddRecord(Tick(), CInputLog::EVENT_RCON, ClientID, aRecord, str_length(aRecord+1)+2);
+					}
 					m_RconClientID = ClientID;
 					m_RconAuthLevel = m_aClients[ClientID].m_Authed;
 					Console()->SetAccessLevel(m_aClients[ClientID].m_Authed == AUTHED_ADMIN ? IConsole::ACCESS_LEVEL_ADMIN : (m_aClients[ClientID].m_Authed == AUTHED_SUBADMIN ? IConsole::ACCESS_LEVEL_SUBADMIN : IConsole::ACCESS_LEVEL_MOD));
@@ -1146,7 +1284,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					m_aClients[ClientID].m_Authed = AUTHED_ADMIN;
 					int SendRconCmds = Unpacker.GetInt();
 					if(Unpacker.Error() == 0 && SendRconCmds)
-						m_aClients[ClientID].m_pRconCmdToSend = Console()->FirstCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER);
+						StartRconCmdSend(ClientID, IConsole::ACCESS_LEVEL_ADMIN, SendRconCmds);
 					SendRconLine(ClientID, "Admin authentication successful. Full remote console access granted.");
 					char aBuf[256];
 					str_format(aBuf, sizeof(aBuf), "ClientID=%d authed (admin)", ClientID);
@@ -1163,7 +1301,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					m_aClients[ClientID].m_Authed = AUTHED_MOD;
 					int SendRconCmds = Unpacker.GetInt();
 					if(Unpacker.Error() == 0 && SendRconCmds)
-						m_aClients[ClientID].m_pRconCmdToSend = Console()->FirstCommandInfo(IConsole::ACCESS_LEVEL_MOD, CFGFLAG_SERVER);
+						StartRconCmdSend(ClientID, IConsole::ACCESS_LEVEL_MOD, SendRconCmds);
 					SendRconLine(ClientID, "Moderator authentication successful. Limited remote console access granted.");
 					char aBuf[256];
 					str_format(aBuf, sizeof(aBuf), "ClientID=%d authed (moderator)", ClientID);
@@ -1186,7 +1324,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					
 					int SendRconCmds = Unpacker.GetInt();
 					if(Unpacker.Error() == 0 && SendRconCmds)
-						m_aClients[ClientID].m_pRconCmdToSend = Console()->FirstCommandInfo(IConsole::ACCESS_LEVEL_SUBADMIN, CFGFLAG_SERVER);
+						StartRconCmdSend(ClientID, IConsole::ACCESS_LEVEL_SUBADMIN, SendRconCmds);
 					SendRconLine(ClientID, "Subadmin authentication successful. Limited remote console access granted.");
 					char aBuf[256];
 					str_format(aBuf, sizeof(aBuf), "ClientID=%d authed (subadmin:%s)", ClientID, loginit->first.c_str());
@@ -1202,9 +1340,9 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 					if(m_aClients[ClientID].m_AuthTries >= g_Config.m_SvRconMaxTries)
 					{
 						if(!g_Config.m_SvRconBantime)
-							m_NetServer.Drop(ClientID, "Too many remote console authentication tries");
+							DropClient(ClientID, "Too many remote console authentication tries");
 						else
-							m_ServerBan.BanAddr(m_NetServer.ClientAddr(ClientID), g_Config.m_SvRconBantime*60, "Too many remote console authentication tries");
+							m_ServerBan.BanAddr(NetClientAddr(ClientID), g_Config.m_SvRconBantime*60, "Too many remote console authentication tries");
 					}
 				}
 				else
@@ -1244,23 +1382,42 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 	{
 		// game message
 		if((pPacket->m_Flags&NET_CHUNKFLAG_VITAL) != 0 && m_aClients[ClientID].m_State >= CClient::STATE_READY)
+		{
+			m_InputLog.AddRecord(Tick(), CInputLog::EVENT_MESSAGE, ClientID, pPacket->m_pData, pPacket->m_DataSize);
 			GameServer()->OnMessage(Msg, &Unpacker, ClientID);
+		}
 	}
 }
 
-void CServer::SendServerInfo(const NETADDR *pAddr, int Token)
+int CServer::GetServerInfoPlayerMask()
 {
-	CNetChunk Packet;
-	CPacker p;
+	int Mask = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		if(m_aClients[i].m_State != CClient::STATE_EMPTY && GameServer()->IsClientPlayer(i))
+			Mask |= 1<<i;
+	return Mask;
+}
+
+void CServer::CheckServerInfo()
+{
+	// players can join or leave the spectators without the engine being told
+	if(GetServerInfoPlayerMask() != m_ServerInfoPlayerMask || g_Config.m_SvSpectatorSlots != m_ServerInfoSpectatorSlots)
+		m_ServerInfoDirty = true;
+}
+
+void CServer::BuildServerInfo()
+{
+	CPacker &p = m_ServerInfo;
 	char aBuf[128];
 
 	// count the players
+	int PlayerMask = GetServerInfoPlayerMask();
 	int PlayerCount = 0, ClientCount = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 		{
-			if(GameServer()->IsClientPlayer(i))
+			if(PlayerMask&(1<<i))
 				PlayerCount++;
 
 			ClientCount++;
@@ -1269,10 +1426,6 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token)
 
 	p.Reset();
 
-	p.AddRaw(SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
-	str_format(aBuf, sizeof(aBuf), "%d", Token);
-	p.AddString(aBuf, 6);
-
 	p.AddString(GameServer()->Version(), 32);
 	// send the alternative server name when a admin is online
 	p.AddString((m_numLoggedInAdmins && str_length(g_Config.m_SvNameAdmin)) ? g_Config.m_SvNameAdmin : g_Config.m_SvName, 64);
@@ -1301,28 +1454,60 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token)
 			p.AddString(ClientClan(i), MAX_CLAN_LENGTH); // client clan
 			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Country); p.AddString(aBuf, 6); // client country
 			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Score); p.AddString(aBuf, 6); // client score
-			str_format(aBuf, sizeof(aBuf), "%d", GameServer()->IsClientPlayer(i)?1:0); p.AddString(aBuf, 2); // is player?
+			str_format(aBuf, sizeof(aBuf), "%d", (PlayerMask&(1<<i))?1:0); p.AddString(aBuf, 2); // is player?
 		}
 	}
 
+	m_ServerInfoPlayerMask = PlayerMask;
+	m_ServerInfoSpectatorSlots = g_Config.m_SvSpectatorSlots;
+	m_ServerInfoDirty = false;
+}
+
+void CServer::SendServerInfo(const NETADDR *pAddr, int Token)
+{
+	CNetChunk Packet;
+	unsigned char aData[NET_MAX_PAYLOAD];
+	char aToken[16];
+
+	if(m_ServerInfoDirty)
+		BuildServerInfo();
+
+	// splice the token in between the header and the cached info
+	str_format(aToken, sizeof(aToken), "%d", Token);
+	int TokenSize = str_length(aToken)+1;
+	int Size = sizeof(SERVERBROWSE_INFO)+TokenSize+m_ServerInfo.Size();
+	if(Size > (int)sizeof(aData))
+		return;
+	mem_copy(aData, SERVERBROWSE_INFO, sizeof(SERVERBROWSE_INFO));
+	mem_copy(aData+sizeof(SERVERBROWSE_INFO), aToken, TokenSize);
+	mem_copy(aData+sizeof(SERVERBROWSE_INFO)+TokenSize, m_ServerInfo.Data(), m_ServerInfo.Size());
+
 	Packet.m_ClientID = -1;
 	Packet.m_Address = *pAddr;
 	Packet.m_Flags = NETSENDFLAG_CONNLESS;
-	Packet.m_DataSize = p.Size();
-	Packet.m_pData = p.Data();
+	Packet.m_DataSize = Size;
+	Packet.m_pData = aData;
 	m_NetServer.Send(&Packet);
 }
 
 void CServer::UpdateServerInfo()
 {
+	m_ServerInfoDirty = true;
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
-			SendServerInfo(m_NetServer.ClientAddr(i), -1);
+			SendServerInfo(NetClientAddr(i), -1);
 	}
 }
 
 
+void CServer::UpdateRateLimits()
+{
+	CNetRateLimit *pRateLimit = m_NetServer.RateLimit();
+	pRateLimit->SetBudget(CNetRateLimit::TYPE_CONNLESS, g_Config.m_SvConnlessRate, g_Config.m_SvConnlessBurst);
+	pRateLimit->SetBudget(CNetRateLimit::TYPE_CONNECT, g_Config.m_SvConnectRate, g_Config.m_SvConnectBurst);
+}
+
 void CServer::PumpNetwork()
 {
 	CNetChunk Packet;
@@ -1349,6 +1534,7 @@ void CServer::PumpNetwork()
 	}
 
 	m_ServerBan.Update();
+	m_Moderation.Update();
 	m_Econ.Update();
 }
 
@@ -1429,6 +1615,11 @@ int CServer::Run()
 		return -1;
 	}
 
+	if(g_Config.m_SvBenchTicks)
+		return RunBenchmark();
+	if(g_Config.m_SvReplay[0])
+		return RunReplay();
+
 	// start server
 	NETADDR BindAddr;
 	if(g_Config.m_Bindaddr[0] && net_host_lookup(g_Config.m_Bindaddr, &BindAddr, NETTYPE_ALL) == 0)
@@ -1451,13 +1642,21 @@ int CServer::Run()
 	}
 
 	m_NetServer.SetCallbacks(NewClientCallback, DelClientCallback, this);
+	UpdateRateLimits();
 
 	m_Econ.Init(Console(), &m_ServerBan);
 
+	if(g_Config.m_SvModerationFile[0])
+	{
+		m_Moderation.SetFile(g_Config.m_SvModerationFile);
+		m_Moderation.Load();
+	}
+
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", g_Config.m_SvName);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
+	InputLog_HandleMapStart();
 	GameServer()->OnInit();
 	str_format(aBuf, sizeof(aBuf), "version %s", GameServer()->NetVersion());
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
@@ -1506,11 +1705,12 @@ int CServer::Run()
 					}
 
 					m_GameStartTime = time_get();
-					AdjustVotebanTime(m_CurrentGameTick);
 					m_CurrentGameTick = 0;
 					Kernel()->ReregisterInterface(GameServer());
+					InputLog_HandleMapStart();
 					GameServer()->OnInit();
 					UpdateServerInfo();
+					m_RconCmdBatchesDirty = true;
 				}
 				else
 				{
@@ -1528,22 +1728,23 @@ int CServer::Run()
 				// apply new input
 				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
-					if(m_aClients[c].m_State == CClient::STATE_EMPTY)
+					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					for(int i = 0; i < 200; i++)
+					CClient::CInput *pInput = m_aClients[c].GetInput(Tick());
+					if(pInput)
 					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
-						{
-							if(m_aClients[c].m_State == CClient::STATE_INGAME)
-								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
-						}
+						m_InputLog.AddInput(Tick(), CInputLog::EVENT_PREDICTED_INPUT, c, pInput->m_aData);
+						GameServer()->OnClientPredictedInput(c, pInput->m_aData);
 					}
 				}
 
+				m_InputLog.AddRecord(Tick(), CInputLog::EVENT_TICK, 0, 0, 0);
 				GameServer()->OnTick();
 			}
 
+			if(NewTicks)
+				CheckServerInfo();
+
 			// snap game
 			if(NewTicks)
 			{
@@ -1591,11 +1792,14 @@ int CServer::Run()
 	for(int i = 0; i < MAX_CLIENTS; ++i)
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
-			m_NetServer.Drop(i, "Server shutdown");
+			DropClient(i, "Server shutdown");
 
 		m_Econ.Shutdown();
 	}
 
+	m_DemoRecorder.Stop();
+	m_InputLog.Stop();
+	m_Moderation.Save();
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
 
@@ -1604,104 +1808,417 @@ int CServer::Run()
 	return 0;
 }
 
-// returns the time in seconds that the client is votebanned or 0 if he isn't
-int CServer::ClientVotebannedTime(int ClientID)
+const NETADDR *CServer::NetClientAddr(int ClientID) const
 {
-	CVoteban **v = IsVotebannedAddr(m_NetServer.ClientAddr(ClientID));
-	if(v != NULL && (*v)->m_Expire > Tick())
-		return ((*v)->m_Expire - Tick()) / TickSpeed();
-	return 0;
+	static const NETADDR s_OfflineAddr = {NETTYPE_IPV4, {127, 0, 0, 1}, 0};
+	if(m_Offline)
+		return &s_OfflineAddr;
+	return m_NetServer.ClientAddr(ClientID);
 }
 
-// decreases the time of all votebans by the given offset of ticks
-void CServer::AdjustVotebanTime(int offset)
+void CServer::DropClient(int ClientID, const char *pReason)
 {
-	CleanVotebans();
-	CVoteban *v = m_Votebans;
-	while(v != NULL)
-	{
-		v->m_Expire -= offset;
-		v = v->m_Next;
-	}
+	if(m_Offline)
+		DelClientCallback(ClientID, pReason, this);
+	else
+		m_NetServer.Drop(ClientID, pReason);
 }
 
-// adds a new voteban for a specific address
-void CServer::AddVotebanAddr(const NETADDR *addr, int expire)
+void CServer::StartOffline(int MaxClients)
 {
-	CVoteban **v = IsVotebannedAddr(addr);
-	// create new
-	if(!v)
-	{
-		CVoteban *v = new CVoteban;
-		v->m_Addr = *addr;
-		v->m_Expire = expire;
-		// insert front
-		v->m_Next = m_Votebans;
-		m_Votebans = v;
-	}
-	// update existing entry
-	else
-		(*v)->m_Expire = expire;
+	// no socket is opened, clients are only known to the server and dropping them just notifies it
+	m_Offline = true;
+	m_OfflineMaxClients = MaxClients;
 }
 
-// adds a new voteban for a client's address
-void CServer::AddVoteban(int ClientID, int time)
+void CServer::StopOffline()
 {
-	int expire = Tick() + time * TickSpeed();
-	AddVotebanAddr(m_NetServer.ClientAddr(ClientID), expire);
+	m_Offline = false;
+	m_OfflineMaxClients = 0;
 }
 
-// removes a voteban from a client's address
-void CServer::RemoveVotebanClient(int ClientID)
+void CServer::ConnectOfflineClient(int ClientID, const char *pName)
 {
-	RemoveVotebanAddr(m_NetServer.ClientAddr(ClientID));
+	NewClientCallback(ClientID, this);
+	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+	m_aClients[ClientID].m_State = CClient::STATE_READY;
+	m_aClients[ClientID].m_Latency = 0;
+	GameServer()->OnClientConnected(ClientID);
+	m_aClients[ClientID].m_State = CClient::STATE_INGAME;
+	m_aClients[ClientID].m_SnapRate = CClient::SNAPRATE_FULL;
+	GameServer()->OnClientEnter(ClientID);
 }
 
-// removes a voteban on an address
-void CServer::RemoveVotebanAddr(const NETADDR *addr)
+int CServer::RunBenchmark()
 {
-	CVoteban **v = IsVotebannedAddr(addr);
-	if(v != NULL)
-		RemoveVoteban(v);
+	enum
+	{
+		PHASE_INPUT=0,
+		PHASE_TICK,
+		PHASE_SNAP,
+		NUM_PHASES
+	};
+	static const char *s_apPhaseNames[NUM_PHASES] = {"input", "tick", "snap"};
+
+	int NumClients = g_Config.m_SvBenchPlayers;
+	int NumTicks = g_Config.m_SvBenchTicks;
+	int OldMode = g_Config.m_SvMode;
+	int OldRanking = g_Config.m_SvRanking;
+	char aBuf[256];
+
+	// keep the scripted players out of the ranking database
+	g_Config.m_SvRanking = 0;
+	StartOffline(NumClients);
+
+	for(int Mode = 1; Mode <= 5; Mode++)
+	{
+		if(g_Config.m_SvBenchMode && g_Config.m_SvBenchMode != Mode)
+			continue;
+
+		// every mode starts from the same state
+		g_Config.m_SvMode = Mode;
+		srand(Mode);
+		m_CurrentGameTick = 0;
+		m_GameStartTime = time_get();
+		m_IDPool.Reset();
+		Kernel()->ReregisterInterface(GameServer());
+		GameServer()->OnInit();
+		m_pConsole->StoreCommands(false);
+
+		for(int c = 0; c < NumClients; c++)
+		{
+			char aName[MAX_NAME_LENGTH];
+			str_format(aName, sizeof(aName), "bench%d", c);
+			ConnectOfflineClient(c, aName);
+		}
+
+		// measure the cost of recording too
+		DemoRecorder_HandleAutoStart();
+
+		int64 aPhaseTime[NUM_PHASES] = {0};
+		int64 MaxTickTime = 0;
+		for(int t = 0; t < NumTicks; t++)
+		{
+			int64 aStart[NUM_PHASES+1];
+			m_CurrentGameTick++;
+
+			aStart[PHASE_INPUT] = time_get();
+			for(int c = 0; c < NumClients; c++)
+			{
+				if(m_aClients[c].m_State != CClient::STATE_INGAME)
+					continue;
+
+				// the input arrives just in time for this tick
+				CClient::CInput Input;
+				mem_zero(&Input, sizeof(Input));
+				Input.m_GameTick = Input.m_IntendedTick = m_CurrentGameTick;
+				GameServer()->OnBenchmarkInput(c, Input.m_aData);
+				mem_copy(m_aClients[c].m_LatestInput.m_aData, Input.m_aData, sizeof(Input.m_aData));
+				m_aClients[c].AddInput(&Input);
+				GameServer()->OnClientDirectInput(c, m_aClients[c].m_LatestInput.m_aData);
+
+				CClient::CInput *pInput = m_aClients[c].GetInput(m_CurrentGameTick);
+				if(pInput)
+					GameServer()->OnClientPredictedInput(c, pInput->m_aData);
+			}
+
+			aStart[PHASE_TICK] = time_get();
+			GameServer()->OnTick();
+
+			aStart[PHASE_SNAP] = time_get();
+			if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+			{
+				DoSnapshot();
+
+				// clients ack every snapshot right away
+				for(int c = 0; c < NumClients; c++)
+					m_aClients[c].m_LastAckedSnapshot = m_CurrentGameTick;
+			}
+			aStart[NUM_PHASES] = time_get();
+
+			for(int p = 0; p < NUM_PHASES; p++)
+				aPhaseTime[p] += aStart[p+1]-aStart[p];
+			MaxTickTime = max(MaxTickTime, aStart[NUM_PHASES]-aStart[PHASE_INPUT]);
+		}
+
+		int64 Total = 0;
+		str_format(aBuf, sizeof(aBuf), "sv_mode=%d players=%d ticks=%d", Mode, NumClients, NumTicks);
+		for(int p = 0; p < NUM_PHASES; p++)
+		{
+			char aPhase[64];
+			str_format(aPhase, sizeof(aPhase), " %s=%dns", s_apPhaseNames[p], (int)(aPhaseTime[p]*1000000000/time_freq()/max(NumTicks, 1)));
+			str_append(aBuf, aPhase, sizeof(aBuf));
+			Total += aPhaseTime[p];
+		}
+		char aTotal[64];
+		str_format(aTotal, sizeof(aTotal), " total=%dns max=%dns", (int)(Total*1000000000/time_freq()/max(NumTicks, 1)), (int)(MaxTickTime*1000000000/time_freq()));
+		str_append(aBuf, aTotal, sizeof(aBuf));
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "bench", aBuf);
+
+		for(int c = 0; c < NumClients; c++)
+			if(m_aClients[c].m_State != CClient::STATE_EMPTY)
+				DropClient(c, "benchmark done");
+		m_DemoRecorder.Stop();
+		GameServer()->OnShutdown();
+	}
+
+	g_Config.m_SvMode = OldMode;
+	g_Config.m_SvRanking = OldRanking;
+	StopOffline();
+	m_pMap->Unload();
+	if(m_pCurrentMapData)
+		mem_free(m_pCurrentMapData);
+	return 0;
 }
 
-// removes a voteban
-void CServer::RemoveVoteban(CVoteban **v)
+static void ReportReplayDemo(IConsole *pConsole, const char *pDemo, const CDemoSnapshotCrcs *pCrcs)
 {
-	CVoteban *next = (*v)->m_Next;
-	delete *v;
-	*v = next;
+	char aBuf[256];
+	if(pCrcs->m_NumMismatches)
+		str_format(aBuf, sizeof(aBuf), "demo '%s': %d of %d snapshots differ, first at tick %d, %d not in the demo", pDemo,
+			pCrcs->m_NumMismatches, pCrcs->m_NumChecked, pCrcs->m_FirstMismatchTick, pCrcs->m_NumMissing);
+	else
+		str_format(aBuf, sizeof(aBuf), "demo '%s': all %d snapshots match, %d not in the demo", pDemo, pCrcs->m_NumChecked, pCrcs->m_NumMissing);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
 }
 
-// returns the voteban with the given address if it exists
-CServer::CVoteban **CServer::IsVotebannedAddr(const NETADDR *addr)
+int CServer::RunReplay()
 {
-	CVoteban **v = &m_Votebans;
-	while(*v != NULL)
+	enum
+	{
+		PHASE_INPUT=0,
+		PHASE_TICK,
+		PHASE_SNAP,
+		NUM_PHASES,
+
+		NUM_SLOWEST_TICKS=10,
+	};
+	static const char *s_apPhaseNames[NUM_PHASES] = {"input", "tick", "snap"};
+
+	CInputLogReader Reader;
+	if(!Reader.Open(Storage(), g_Config.m_SvReplay))
+		return -1;
+	const CInputLog::CHeader *pHeader = Reader.Header();
+	if(!LoadMap(pHeader->m_aMapName) || m_CurrentMapCrc != pHeader->m_MapCrc)
 	{
-		// only check ip-type and ip, not port
-		if((*v)->m_Addr.type == addr->type && !mem_comp(&(*v)->m_Addr.ip, &addr->ip, sizeof(unsigned char[16])))
-			return v;
-		v = &(*v)->m_Next;
+		dbg_msg("replay", "failed to load the recorded map. mapname='%s' crc=%08x", pHeader->m_aMapName, pHeader->m_MapCrc);
+		return -1;
 	}
-	return NULL;
-}
 
-// removes expired votebans
-void CServer::CleanVotebans()
-{
-	CVoteban **v = &m_Votebans;
-	while(*v != NULL)
+	int OldMode = g_Config.m_SvMode;
+	int OldRanking = g_Config.m_SvRanking;
+	int OldAutoDemoRecord = g_Config.m_SvAutoDemoRecord;
+	char aBuf[256];
+
+	// the replay only reads, the recorded demos are what it is checked against
+	g_Config.m_SvMode = pHeader->m_Mode;
+	g_Config.m_SvRanking = 0;
+	g_Config.m_SvAutoDemoRecord = 0;
+	StartOffline(clamp(pHeader->m_MaxClients, 1, (int)MAX_CLIENTS));
+
+	srand(pHeader->m_Seed);
+	m_CurrentGameTick = 0;
+	m_GameStartTime = time_get();
+	m_IDPool.Reset();
+	Kernel()->ReregisterInterface(GameServer());
+	GameServer()->OnInit();
+	m_pConsole->StoreCommands(false);
+
+	char aDemo[128] = {0};
+	int NumTicks = 0;
+	int64 aPhaseTime[NUM_PHASES] = {0};
+	int aSlowestTicks[NUM_SLOWEST_TICKS];
+	int64 aSlowestTimes[NUM_SLOWEST_TICKS];
+	for(int i = 0; i < NUM_SLOWEST_TICKS; i++)
 	{
-		if((*v)->m_Expire <= Tick())
+		aSlowestTicks[i] = -1;
+		aSlowestTimes[i] = 0;
+	}
+	int CurrentTick = -1;
+	int64 CurrentTickTime = 0;
+
+	CInputLogReader::CRecord *pRecord = new CInputLogReader::CRecord;
+	while(1)
+	{
+		bool More = Reader.Next(pRecord);
+
+		// everything recorded during a tick is accounted to it
+		if(!More || pRecord->m_Tick != CurrentTick)
 		{
-			CVoteban *next = (*v)->m_Next;
-			delete *v;
-			*v = next;
+			if(CurrentTick != -1)
+			{
+				for(int i = 0; i < NUM_SLOWEST_TICKS; i++)
+				{
+					if(CurrentTickTime <= aSlowestTimes[i])
+						continue;
+					for(int j = NUM_SLOWEST_TICKS-1; j > i; j--)
+					{
+						aSlowestTicks[j] = aSlowestTicks[j-1];
+						aSlowestTimes[j] = aSlowestTimes[j-1];
+					}
+					aSlowestTicks[i] = CurrentTick;
+					aSlowestTimes[i] = CurrentTickTime;
+					break;
+				}
+			}
+			CurrentTick = pRecord->m_Tick;
+			CurrentTickTime = 0;
 		}
-		else
-			v = &(*v)->m_Next;
+		if(!More)
+			break;
+
+		int c = pRecord->m_ClientID;
+		int Phase = PHASE_INPUT;
+		int64 Start = time_get();
+		m_CurrentGameTick = pRecord->m_Tick;
+		switch(pRecord->m_Type)
+		{
+		case CInputLog::EVENT_TICK:
+			Phase = PHASE_TICK;
+			NumTicks++;
+			GameServer()->OnTick();
+			break;
+		case CInputLog::EVENT_SNAPSHOT:
+			Phase = PHASE_SNAP;
+			DoSnapshot();
+			for(int i = 0; i < MAX_CLIENTS; i++)
+				m_aClients[i].m_LastAckedSnapshot = m_CurrentGameTick;
+			break;
+		case CInputLog::EVENT_CONNECT:
+			if(m_aClients[c].m_State == CClient::STATE_EMPTY)
+				NewClientCallback(c, this);
+			m_aClients[c].m_State = CClient::STATE_READY;
+			GameServer()->OnClientConnected(c);
+			break;
+		case CInputLog::EVENT_ENTER:
+			if(m_aClients[c].m_State != CClient::STATE_READY)
+				break;
+			m_aClients[c].m_State = CClient::STATE_INGAME;
+			m_aClients[c].m_SnapRate = CClient::SNAPRATE_FULL;
+			GameServer()->OnClientEnter(c);
+			break;
+		case CInputLog::EVENT_DROP:
+			// kicks by the game itself already happened
+			if(m_aClients[c].m_State != CClient::STATE_EMPTY)
+				DropClient(c, (const char *)pRecord->m_aData);
+			break;
+		case CInputLog::EVENT_DIRECT_INPUT:
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				break;
+			mem_copy(m_aClients[c].m_LatestInput.m_aData, pRecord->m_aInput, sizeof(pRecord->m_aInput));
+			GameServer()->OnClientDirectInput(c, m_aClients[c].m_LatestInput.m_aData);
+			break;
+		case CInputLog::EVENT_PREDICTED_INPUT:
+			if(m_aClients[c].m_State == CClient::STATE_INGAME)
+				GameServer()->OnClientPredictedInput(c, pRecord->m_aInput);
+			break;
+		case CInputLog::EVENT_MESSAGE:
+			if(m_aClients[c].m_State >= CClient::STATE_READY)
+			{
+				CUnpacker Unpacker;
+				Unpacker.Reset(pRecord->m_aData, pRecord->m_Size);
+				int Msg = Unpacker.GetInt()>>1;
+				if(!Unpacker.Error())
+					GameServer()->OnMessage(Msg, &Unpacker, c);
+			}
+			break;
+		case CInputLog::EVENT_RCON:
+			if(pRecord->m_Size < 2 || m_aClients[c].m_State == CClient::STATE_EMPTY)
+				break;
+			m_RconClientID = c;
+			m_RconAuthLevel = pRecord->m_aData[0];
+			Console()->SetAccessLevel(m_RconAuthLevel == AUTHED_ADMIN ? IConsole::ACCESS_LEVEL_ADMIN : (m_RconAuthLevel == AUTHED_SUBADMIN ? IConsole::ACCESS_LEVEL_SUBADMIN : IConsole::ACCESS_LEVEL_MOD));
+			Console()->ExecuteLineFlag((const char *)pRecord->m_aData+1, CFGFLAG_SERVER);
+			Console()->SetAccessLevel(IConsole::ACCESS_LEVEL_ADMIN);
+			m_RconClientID = IServer::RCON_CID_SERV;
+			m_RconAuthLevel = AUTHED_SUBADMIN;
+			break;
+		case CInputLog::EVENT_LATENCY:
+			if(pRecord->m_Size == sizeof(int) && m_aClients[c].m_State != CClient::STATE_EMPTY)
+				mem_copy(&m_aClients[c].m_Latency, pRecord->m_aData, sizeof(int));
+			break;
+		case CInputLog::EVENT_DEMO:
+			// check the following snapshots against this demo, loading it isn't part of the timing
+			Phase = -1;
+			if(m_pReplayCrcs)
+				ReportReplayDemo(Console(), aDemo, m_pReplayCrcs);
+			delete m_pReplayCrcs;
+			m_pReplayCrcs = new CDemoSnapshotCrcs;
+			str_copy(aDemo, (const char *)pRecord->m_aData, sizeof(aDemo));
+			if(!m_pReplayCrcs->Load(Storage(), Console(), &m_SnapshotDelta, aDemo))
+			{
+				str_format(aBuf, sizeof(aBuf), "demo '%s' is missing, its snapshots can't be checked", aDemo);
+				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+				delete m_pReplayCrcs;
+				m_pReplayCrcs = 0;
+			}
+			break;
+		}
+
+		if(Phase == -1)
+			continue;
+		int64 Time = time_get()-Start;
+		aPhaseTime[Phase] += Time;
+		CurrentTickTime += Time;
+	}
+	delete pRecord;
+
+	if(m_pReplayCrcs)
+		ReportReplayDemo(Console(), aDemo, m_pReplayCrcs);
+	delete m_pReplayCrcs;
+	m_pReplayCrcs = 0;
+
+	int64 Total = 0;
+	str_format(aBuf, sizeof(aBuf), "map=%s sv_mode=%d ticks=%d", pHeader->m_aMapName, pHeader->m_Mode, NumTicks);
+	for(int p = 0; p < NUM_PHASES; p++)
+	{
+		char aPhase[64];
+		str_format(aPhase, sizeof(aPhase), " %s=%dns", s_apPhaseNames[p], (int)(aPhaseTime[p]*1000000000/time_freq()/max(NumTicks, 1)));
+		str_append(aBuf, aPhase, sizeof(aBuf));
+		Total += aPhaseTime[p];
+	}
+	char aTotal[64];
+	str_format(aTotal, sizeof(aTotal), " total=%dns", (int)(Total*1000000000/time_freq()/max(NumTicks, 1)));
+	str_append(aBuf, aTotal, sizeof(aBuf));
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
+
+	for(int i = 0; i < NUM_SLOWEST_TICKS && aSlowestTicks[i] != -1; i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "slowest tick %d: tick=%d time=%dns", i+1, aSlowestTicks[i], (int)(aSlowestTimes[i]*1000000000/time_freq()));
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "replay", aBuf);
 	}
+
+	for(int c = 0; c < MAX_CLIENTS; c++)
+		if(m_aClients[c].m_State != CClient::STATE_EMPTY)
+			DropClient(c, "replay done");
+	GameServer()->OnShutdown();
+
+	g_Config.m_SvMode = OldMode;
+	g_Config.m_SvRanking = OldRanking;
+	g_Config.m_SvAutoDemoRecord = OldAutoDemoRecord;
+	StopOffline();
+	m_pMap->Unload();
+	if(m_pCurrentMapData)
+		mem_free(m_pCurrentMapData);
+	return 0;
+}
+
+// returns the time in seconds that the client is votebanned or 0 if he isn't
+int CServer::ClientVotebannedTime(int ClientID)
+{
+	return m_Moderation.Remaining(NetClientAddr(ClientID), CModeration::TYPE_VOTEBAN);
+}
+
+// adds a new voteban for a client's address
+void CServer::AddVoteban(int ClientID, int time)
+{
+	m_Moderation.Set(NetClientAddr(ClientID), CModeration::TYPE_VOTEBAN, time);
+}
+
+// removes a voteban from a client's address
+void CServer::RemoveVotebanClient(int ClientID)
+{
+	m_Moderation.Set(NetClientAddr(ClientID), CModeration::TYPE_VOTEBAN, 0);
 }
 
 void CServer::ConVoteban(IConsole::IResult *pResult, void *pUser)
@@ -1727,25 +2244,17 @@ void CServer::ConUnvoteban(IConsole::IResult *pResult, void *pUser)
 	CServer* pThis = static_cast<CServer *>(pUser);
 	
 	// index to unvoteban
-	int index = pResult->GetInteger(0);
-	
-	CVoteban **v = &pThis->m_Votebans;
-	for(int c = 0; *v != NULL; ++c)
+	const CModeration::CRecord *pRecord = pThis->m_Moderation.Get(CModeration::TYPE_VOTEBAN, pResult->GetInteger(0));
+	if(pRecord)
 	{
-		// index found
-		if(index == c)
-		{
-			char aBuf[128], aAddrStr[NETADDR_MAXSTRSIZE];
-			// print to console
-			net_addr_str(&(*v)->m_Addr, aAddrStr, sizeof(aAddrStr), false);
-			str_format(aBuf, sizeof(aBuf), "%s has been un-votebanned.", aAddrStr);
-			pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
-			// remove ban
-			pThis->RemoveVoteban(v);
-			// don't look any further
-			return;
-		}
-		v = &(*v)->m_Next;
+		char aBuf[128], aAddrStr[NETADDR_MAXSTRSIZE];
+		// print to console
+		net_addr_str(&pRecord->m_Addr, aAddrStr, sizeof(aAddrStr), false);
+		str_format(aBuf, sizeof(aBuf), "%s has been un-votebanned.", aAddrStr);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
+		// remove ban
+		pThis->m_Moderation.Set(&pRecord->m_Addr, CModeration::TYPE_VOTEBAN, 0);
+		return;
 	}
 	
 	// not found
@@ -1776,18 +2285,12 @@ void CServer::ConVotebans(IConsole::IResult *pResult, void *pUser)
 	int time;
 	int count = 0;
 	
-	pThis->CleanVotebans();
-	CVoteban *v = pThis->m_Votebans;
-	NETADDR addr;
-	while(v != NULL)
-	{
-		addr.type = v->m_Addr.type;
-		mem_copy(addr.ip, v->m_Addr.ip, sizeof(unsigned char[16]));
-		net_addr_str(&addr, aAddrStr, sizeof(aAddrStr), false);
-		time = (v->m_Expire - pThis->Tick()) / pThis->TickSpeed();
+	for(const CModeration::CRecord *pRecord = pThis->m_Moderation.First(CModeration::TYPE_VOTEBAN); pRecord; pRecord = pThis->m_Moderation.Next(pRecord, CModeration::TYPE_VOTEBAN))
+	{
+		net_addr_str(&pRecord->m_Addr, aAddrStr, sizeof(aAddrStr), false);
+		time = pThis->m_Moderation.Remaining(pRecord, CModeration::TYPE_VOTEBAN);
 		str_format(aBuf, sizeof(aBuf), "#%d addr=%s time=%d:%02d min", count++, aAddrStr, time/60, time%60);
 		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
-		v = v->m_Next;
 	}
 	
 	str_format(aBuf, sizeof(aBuf), "%d votebanned ip(s)", count);
@@ -2007,7 +2510,7 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	{
 		if(pThis->m_aClients[i].m_State != CClient::STATE_EMPTY)
 		{
-			net_addr_str(pThis->m_NetServer.ClientAddr(i), aAddrStr, sizeof(aAddrStr), true);
+			net_addr_str(pThis->NetClientAddr(i), aAddrStr, sizeof(aAddrStr), true);
 			if(pThis->m_aClients[i].m_State == CClient::STATE_INGAME)
 			{
 				char bBuf[32];
@@ -2027,6 +2530,19 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", "Quick help: kick <id> <reason=''> | ban <id> <min=5> <reason=''> | voteban <id> <sec=300> | kill <id>");
 }
 
+void CServer::ConRateLimitStatus(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	CNetRateLimit *pRateLimit = pThis->m_NetServer.RateLimit();
+	const CNetRateLimit::CStats *pStats = pRateLimit->Stats();
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "connless allowed=%u dropped=%u connect allowed=%u dropped=%u sources=%d/%d evictions=%u",
+		pStats->m_aAllowed[CNetRateLimit::TYPE_CONNLESS], pStats->m_aDropped[CNetRateLimit::TYPE_CONNLESS],
+		pStats->m_aAllowed[CNetRateLimit::TYPE_CONNECT], pStats->m_aDropped[CNetRateLimit::TYPE_CONNECT],
+		pRateLimit->NumEntries(), (int)CNetRateLimit::MAX_ENTRIES, pStats->m_Evictions);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "ratelimit", aBuf);
+}
+
 void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 {
 	((CServer *)pUser)->m_RunServer = 0;
@@ -2043,6 +2559,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		str_format(aFilename, sizeof(aFilename), "demos/auto/%s_%s.demo", g_Config.m_SvAutoDemoPrefix, aDate);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "foobar", aFilename);
 		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapCrc, "server");
+		m_InputLog.AddString(Tick(), CInputLog::EVENT_DEMO, 0, aFilename);
 		if(g_Config.m_SvAutoDemoMax)
 		{
 			// clean up auto recorded demos
@@ -2052,6 +2569,35 @@ void CServer::DemoRecorder_HandleAutoStart()
 	}
 }
 
+void CServer::InputLog_HandleMapStart()
+{
+	m_InputLog.Stop();
+	if(!g_Config.m_SvInputRecord)
+		return;
+
+	// a fresh seed per map, the replay starts from it too
+	CInputLog::CHeader Header;
+	mem_zero(&Header, sizeof(Header));
+	str_copy(Header.m_aMapName, m_aCurrentMap, sizeof(Header.m_aMapName));
+	Header.m_MapCrc = m_CurrentMapCrc;
+	Header.m_Seed = (unsigned)time_get();
+	Header.m_MaxClients = MaxClients();
+	Header.m_Mode = g_Config.m_SvMode;
+
+	char aFilename[128];
+	char aDate[20];
+	str_timestamp(aDate, sizeof(aDate));
+	str_format(aFilename, sizeof(aFilename), "demos/auto/%s_%s.input", g_Config.m_SvAutoDemoPrefix, aDate);
+	if(m_InputLog.Start(Storage(), aFilename, &Header))
+		srand(Header.m_Seed);
+	if(g_Config.m_SvInputRecordMax)
+	{
+		// clean up recorded input logs
+		CFileCollection InputLogs;
+		InputLogs.Init(Storage(), "demos/auto", g_Config.m_SvAutoDemoPrefix, ".input", g_Config.m_SvInputRecordMax);
+	}
+}
+
 void CServer::MapReload()
 {
 	m_MapReload = 1;
@@ -2128,6 +2674,13 @@ void CServer::ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pU
 		((CServer *)pUserData)->m_NetServer.SetMaxClientsPerIP(pResult->GetInteger(0));
 }
 
+void CServer::ConchainRateLimitUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		((CServer *)pUserData)->UpdateRateLimits();
+}
+
 void CServer::ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	if(pResult->NumArguments() == 2)
@@ -2140,6 +2693,7 @@ void CServer::ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserDa
 		pfnCallback(pResult, pCallbackUserData);
 		if(pInfo && OldAccessLevel != pInfo->GetAccessLevel())
 		{
+			pThis->m_RconCmdBatchesDirty = true;
 			for(int i = 0; i < MAX_CLIENTS; ++i)
 			{
 				if(pThis->m_aClients[i].m_State == CServer::CClient::STATE_EMPTY || pThis->m_aClients[i].m_Authed != CServer::AUTHED_MOD ||
@@ -2179,6 +2733,7 @@ void CServer::RegisterCommands()
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
+	Console()->Register("ratelimit_status", "", CFGFLAG_SERVER, ConRateLimitStatus, this, "Show the connectionless and connect rate limit counters");
 
 	Console()->Register("record", "?s", CFGFLAG_SERVER|CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -2190,6 +2745,10 @@ void CServer::RegisterCommands()
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
 
 	Console()->Chain("sv_max_clients_per_ip", ConchainMaxclientsperipUpdate, this);
+	Console()->Chain("sv_connless_rate", ConchainRateLimitUpdate, this);
+	Console()->Chain("sv_connless_burst", ConchainRateLimitUpdate, this);
+	Console()->Chain("sv_connect_rate", ConchainRateLimitUpdate, this);
+	Console()->Chain("sv_connect_burst", ConchainRateLimitUpdate, this);
 	Console()->Chain("mod_command", ConchainModCommandUpdate, this);
 	Console()->Chain("console_output_level", ConchainConsoleOutputLevelUpdate, this);
 	
@@ -2207,6 +2766,7 @@ void CServer::RegisterCommands()
 
 	// register console commands in sub parts
 	m_ServerBan.InitServerBan(Console(), Storage(), this);
+	m_Moderation.Init(Console(), Storage());
 	m_pGameServer->OnConsoleInit();
 }
 
@@ -8,6 +8,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 
 class CSnapIDPool
@@ -101,6 +102,8 @@ public:
 		AUTHED_ADMIN,
 
 		MAX_RCONCMD_SEND=16,
+		RCONCMD_BATCH_SIZE=1024,
+		NUM_RCONCMD_LISTS=IConsole::ACCESS_LEVEL_MOD+1,
 	};
 
 	class CClient
@@ -117,7 +120,9 @@ public:
 
 			SNAPRATE_INIT=0,
 			SNAPRATE_FULL,
-			SNAPRATE_RECOVER
+			SNAPRATE_RECOVER,
+
+			INPUT_RING_SIZE=256, // must be a power of two
 		};
 
 		class CInput
@@ -125,6 +130,7 @@ public:
 		public:
 			int m_aData[MAX_INPUT_SIZE];
 			int m_GameTick; // the tick that was chosen for the input
+			int m_IntendedTick; // the tick the client sent the input for
 		};
 
 		// connection state info
@@ -137,8 +143,7 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInput m_aInputs[INPUT_RING_SIZE]; // indexed by m_GameTick
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -151,8 +156,12 @@ public:
 		int m_SubAdminCommandPassFails;
 
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
+		int m_RconCmdAccessLevel;
+		bool m_RconCmdPacked;
 
 		void Reset();
+		void AddInput(const CInput *pInput);
+		CInput *GetInput(int Tick);
 	};
 
 	CClient m_aClients[MAX_CLIENTS];
@@ -163,6 +172,7 @@ public:
 	CNetServer m_NetServer;
 	CEcon m_Econ;
 	CServerBan m_ServerBan;
+	CModeration m_Moderation;
 
 	IEngineMap *m_pMap;
 
@@ -173,6 +183,8 @@ public:
 	int m_RconClientID;
 	int m_RconAuthLevel;
 	int m_PrintCBIndex;
+	bool m_Offline; // simulating without network, the net server is never opened
+	int m_OfflineMaxClients;
 
 	int64 m_Lastheartbeat;
 	//static NETADDR4 master_server;
@@ -183,6 +195,8 @@ public:
 	int m_CurrentMapSize;
 
 	CDemoRecorder m_DemoRecorder;
+	CInputLogWriter m_InputLog;
+	CDemoSnapshotCrcs *m_pReplayCrcs; // the demo a replay is compared to
 	CRegister m_Register;
 	CMapChecker m_MapChecker;
 
@@ -200,6 +214,7 @@ public:
 
 	void DemoRecorder_HandleAutoStart();
 	bool DemoRecorder_IsRecording();
+	void InputLog_HandleMapStart();
 
 	//int Tick()
 	int64 TickStartTime(int Tick);
@@ -211,6 +226,8 @@ public:
 	bool IsAuthed(int ClientID);
 	int GetClientInfo(int ClientID, CClientInfo *pInfo);
 	void GetClientAddr(int ClientID, char *pAddrStr, int Size);
+	const NETADDR *ClientAddr(int ClientID);
+	CModeration *Moderation() { return &m_Moderation; }
 	const char *ClientName(int ClientID);
 	const char *ClientClan(int ClientID);
 	int ClientCountry(int ClientID);
@@ -232,14 +249,38 @@ public:
 
 	void SendRconCmdAdd(const IConsole::CCommandInfo *pCommandInfo, int ClientID);
 	void SendRconCmdRem(const IConsole::CCommandInfo *pCommandInfo, int ClientID);
+	void StartRconCmdSend(int ClientID, int AccessLevel, int Mode);
 	void UpdateClientRconCommands();
 
+	// serialized command list per access level, each batch is the payload of one NETMSG_RCON_CMD_LIST
+	struct CRconCmdBatch
+	{
+		const IConsole::CCommandInfo *m_pFirst;
+		const IConsole::CCommandInfo *m_pNext;
+		int m_Size;
+		unsigned char m_aData[RCONCMD_BATCH_SIZE];
+	};
+	std::vector<CRconCmdBatch> m_aRconCmdBatches[NUM_RCONCMD_LISTS];
+	bool m_RconCmdBatchesDirty;
+	void BuildRconCmdBatches(int AccessLevel);
+	const CRconCmdBatch *FindRconCmdBatch(int AccessLevel, const IConsole::CCommandInfo *pFirst);
+
 	void ProcessClientPacket(CNetChunk *pPacket);
 
+	// the info response without its token, rebuilt when something in it changed
+	CPacker m_ServerInfo;
+	bool m_ServerInfoDirty;
+	int m_ServerInfoPlayerMask;
+	int m_ServerInfoSpectatorSlots;
+	int GetServerInfoPlayerMask();
+	void CheckServerInfo();
+	void BuildServerInfo();
+
 	void SendServerInfo(const NETADDR *pAddr, int Token);
 	void UpdateServerInfo();
 
 	void PumpNetwork();
+	void UpdateRateLimits();
 
 	char *GetMapName();
 	int LoadMap(const char *pMapName);
@@ -247,6 +288,16 @@ public:
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
 	int Run();
 
+	// clients of an offline server have no connection, these don't touch the net server then
+	const NETADDR *NetClientAddr(int ClientID) const;
+	void DropClient(int ClientID, const char *pReason);
+
+	void StartOffline(int MaxClients);
+	void StopOffline();
+	void ConnectOfflineClient(int ClientID, const char *pName);
+	int RunBenchmark();
+	int RunReplay();
+
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
@@ -254,8 +305,10 @@ public:
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
+	static void ConRateLimitStatus(IConsole::IResult *pResult, void *pUser);
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainRateLimitUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainModCommandUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainConsoleOutputLevelUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
@@ -271,28 +324,9 @@ public:
 	virtual void MapReload();
 	
 	// voteban system
-	// struct CVotebanAddr
-	// {
-		// unsigned char ip[16];
-		// unsigned int type;
-	// };
-	struct CVoteban
-	{
-		// CVotebanAddr m_Addr;
-		NETADDR m_Addr;
-		int m_Expire;
-		CVoteban *m_Next;
-	};
-	CVoteban *m_Votebans;
 	int ClientVotebannedTime(int ClientID);
-	void AdjustVotebanTime(int offset);
-	void AddVotebanAddr(const NETADDR *addr, int expire);
 	void AddVoteban(int ClientID, int time);
-	void RemoveVoteban(CVoteban **v);
-	void RemoveVotebanAddr(const NETADDR *addr);
 	void RemoveVotebanClient(int ClientID);
-	CVoteban **IsVotebannedAddr(const NETADDR *addr);
-	void CleanVotebans();
 	static void ConVoteban(IConsole::IResult *pResult, void *pUser);
 	static void ConUnvoteban(IConsole::IResult *pResult, void *pUser);
 	static void ConUnvotebanClient(IConsole::IResult *pResult, void *pUser);
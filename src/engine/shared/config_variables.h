@@ -15,6 +15,8 @@ MACRO_CONFIG_INT(PlayerCountry, player_country, -1, -1, 1000, CFGFLAG_SAVE|CFGFL
 MACRO_CONFIG_STR(Password, password, 32, "", CFGFLAG_CLIENT|CFGFLAG_SERVER, "Password to the server")
 MACRO_CONFIG_STR(Logfile, logfile, 128, "", CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Filename to log all output to")
 MACRO_CONFIG_INT(ConsoleOutputLevel, console_output_level, 0, 0, 2, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Adjusts the amount of information in the console")
+MACRO_CONFIG_INT(LogThreaded, log_threaded, 0, 0, 1, CFGFLAG_SERVER, "Write log output from a background thread (server only)")
+MACRO_CONFIG_INT(LogFormat, log_format, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Format of log lines (0=plain, 1=json)")
 
 MACRO_CONFIG_INT(ClCpuThrottle, cl_cpu_throttle, 0, 0, 100, CFGFLAG_SAVE|CFGFLAG_CLIENT, "")
 MACRO_CONFIG_INT(ClEditor, cl_editor, 0, 0, 1, CFGFLAG_CLIENT, "")
@@ -24,6 +26,7 @@ MACRO_CONFIG_INT(ClAutoDemoRecord, cl_auto_demo_record, 0, 0, 1, CFGFLAG_SAVE|CF
 MACRO_CONFIG_INT(ClAutoDemoMax, cl_auto_demo_max, 10, 0, 1000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Maximum number of automatically recorded demos (0 = no limit)")
 MACRO_CONFIG_INT(ClAutoScreenshot, cl_auto_screenshot, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Automatically take game over screenshot")
 MACRO_CONFIG_INT(ClAutoScreenshotMax, cl_auto_screenshot_max, 10, 0, 1000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Maximum number of automatically created screenshots (0 = no limit)")
+MACRO_CONFIG_STR(ClBenchmark, cl_benchmark, 128, "", CFGFLAG_CLIENT, "Play this demo as fast as possible, print where the frame time went and quit")
 
 MACRO_CONFIG_INT(ClEventthread, cl_eventthread, 0, 0, 1, CFGFLAG_CLIENT, "Enables the usage of a thread to pump the events")
 
@@ -76,26 +79,40 @@ MACRO_CONFIG_INT(GfxFinish, gfx_finish, 1, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, ""
 MACRO_CONFIG_INT(GfxAsyncRender, gfx_asyncrender, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Do rendering async from the the update")
 
 MACRO_CONFIG_INT(GfxThreaded, gfx_threaded, 0, 0, 1, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Use the threaded graphics backend")
+MACRO_CONFIG_INT(GfxNull, gfx_null, 0, 0, 1, CFGFLAG_CLIENT, "Use a graphics backend that renders nothing, for benchmarking without a gpu")
+MACRO_CONFIG_INT(GfxCommandBuffers, gfx_command_buffers, 2, 2, 8, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Number of command buffers the threaded graphics can have in flight, each one above 2 adds a frame of input latency with vsync")
 
 MACRO_CONFIG_INT(InpMousesens, inp_mousesens, 100, 5, 100000, CFGFLAG_SAVE|CFGFLAG_CLIENT, "Mouse sensitivity")
 
 MACRO_CONFIG_STR(SvName, sv_name, 128, "unnamed server", CFGFLAG_SERVER, "Server name")
 MACRO_CONFIG_STR(SvNameAdmin, sv_name_admin, 128, "", CFGFLAG_SERVER, "Server name when an admin is logged in")
 MACRO_CONFIG_STR(Bindaddr, bindaddr, 128, "", CFGFLAG_CLIENT|CFGFLAG_SERVER|CFGFLAG_MASTER, "Address to bind the client/server to")
+MACRO_CONFIG_INT(MsMaxServers, ms_max_servers, 65535, 1, 65535, CFGFLAG_MASTER, "Maximum number of servers the master server lists")
 MACRO_CONFIG_INT(SvPort, sv_port, 8303, 0, 0, CFGFLAG_SERVER, "Port to use for the server")
 MACRO_CONFIG_INT(SvExternalPort, sv_external_port, 0, 0, 0, CFGFLAG_SERVER, "External port to report to the master servers")
 MACRO_CONFIG_STR(SvMap, sv_map, 128, "dm1", CFGFLAG_SERVER, "Map to use on the server")
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 8, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
+MACRO_CONFIG_INT(SvConnlessRate, sv_connless_rate, 10, 0, 1000, CFGFLAG_SERVER, "Connectionless packets (e.g. server info requests) per second answered per address (0 = unlimited)")
+MACRO_CONFIG_INT(SvConnlessBurst, sv_connless_burst, 20, 1, 1000, CFGFLAG_SERVER, "Connectionless packets an address can send at once before sv_connless_rate applies")
+MACRO_CONFIG_INT(SvConnectRate, sv_connect_rate, 1, 0, 1000, CFGFLAG_SERVER, "Connection attempts per second accepted per address (0 = unlimited)")
+MACRO_CONFIG_INT(SvConnectBurst, sv_connect_burst, 5, 1, 1000, CFGFLAG_SERVER, "Connection attempts an address can make at once before sv_connect_rate applies")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR_ACCESSLEVEL(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER, "Remote console password (full access)", IConsole::ACCESS_LEVEL_ADMIN)
 MACRO_CONFIG_STR_ACCESSLEVEL(SvRconModPassword, sv_rcon_mod_password, 32, "", CFGFLAG_SERVER, "Remote console password for moderators (limited access)", IConsole::ACCESS_LEVEL_ADMIN)
 MACRO_CONFIG_INT_ACCESSLEVEL(SvRconMaxTries, sv_rcon_max_tries, 3, 0, 100, CFGFLAG_SERVER, "Maximum number of tries for remote console authentication", IConsole::ACCESS_LEVEL_ADMIN)
 MACRO_CONFIG_INT_ACCESSLEVEL(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SERVER, "The time a client gets banned if remote console authentication fails. 0 makes it just use kick", IConsole::ACCESS_LEVEL_ADMIN)
+MACRO_CONFIG_STR(SvModerationFile, sv_moderation_file, 128, "", CFGFLAG_SERVER, "File to keep mutes and votebans in across restarts (empty = off)")
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
 MACRO_CONFIG_STR(SvAutoDemoPrefix, sv_auto_demo_prefix, 64, "autorecord", CFGFLAG_SERVER, "Prefix for automatically recorded demos")
+MACRO_CONFIG_INT(SvBenchTicks, sv_bench_ticks, 0, 0, 1000000, CFGFLAG_SERVER, "Run the offline simulation benchmark for this many ticks per mode instead of starting the server")
+MACRO_CONFIG_INT(SvBenchPlayers, sv_bench_players, 16, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Number of scripted players in the simulation benchmark")
+MACRO_CONFIG_INT(SvBenchMode, sv_bench_mode, 0, 0, 5, CFGFLAG_SERVER, "sv_mode to run the simulation benchmark in (0 = all modes)")
+MACRO_CONFIG_INT(SvInputRecord, sv_input_record, 0, 0, 1, CFGFLAG_SERVER, "Record the inputs of all clients per map to demos/auto, for sv_replay")
+MACRO_CONFIG_INT(SvInputRecordMax, sv_input_record_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of recorded input logs (0 = no limit)")
+MACRO_CONFIG_STR(SvReplay, sv_replay, 128, "", CFGFLAG_SERVER, "Replay this input log offline and compare it to its demos instead of starting the server")
 
 MACRO_CONFIG_STR(EcBindaddr, ec_bindaddr, 128, "localhost", CFGFLAG_ECON, "Address to bind the external console to. Anything but 'localhost' is dangerous")
 MACRO_CONFIG_INT(EcPort, ec_port, 0, 0, 0, CFGFLAG_ECON, "Port to use for the external console")
@@ -103,6 +120,7 @@ MACRO_CONFIG_STR(EcPassword, ec_password, 32, "", CFGFLAG_ECON, "External consol
 MACRO_CONFIG_INT(EcBantime, ec_bantime, 0, 0, 1440, CFGFLAG_ECON, "The time a client gets banned if econ authentication fails. 0 just closes the connection")
 MACRO_CONFIG_INT(EcAuthTimeout, ec_auth_timeout, 30, 1, 120, CFGFLAG_ECON, "Time in seconds before the the econ authentification times out")
 MACRO_CONFIG_INT(EcOutputLevel, ec_output_level, 1, 0, 2, CFGFLAG_ECON, "Adjusts the amount of information in the external console")
+MACRO_CONFIG_INT(EcOutputOverflow, ec_output_overflow, 0, 0, 1, CFGFLAG_ECON, "What to do when a client can't keep up with the output (0=drop lines, 1=disconnect)")
 
 MACRO_CONFIG_INT(SvGlobalBantime, sv_global_bantime, 60, 0, 1440, CFGFLAG_SERVER, "The time a client gets banned if the ban server reports it. 0 to disable")
 
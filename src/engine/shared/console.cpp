@@ -195,12 +195,15 @@ void CConsole::SetPrintOutputLevel(int Index, int OutputLevel)
 void CConsole::Print(int Level, const char *pFrom, const char *pStr)
 {
 	dbg_msg(pFrom ,"%s", pStr);
+	char aBuf[1024];
+	aBuf[0] = 0;
 	for(int i = 0; i < m_NumPrintCB; ++i)
 	{
 		if(Level <= m_aPrintCB[i].m_OutputLevel && m_aPrintCB[i].m_pfnPrintCallback)
 		{
-			char aBuf[1024];
-			str_format(aBuf, sizeof(aBuf), "[%s]: %s", pFrom, pStr);
+			// format once for all callbacks
+			if(!aBuf[0])
+				str_format(aBuf, sizeof(aBuf), "[%s]: %s", pFrom, pStr);
 			m_aPrintCB[i].m_pfnPrintCallback(aBuf, m_aPrintCB[i].m_pPrintCallbackUserdata);
 		}
 	}
@@ -356,9 +359,42 @@ void CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPoss
 	}
 }
 
+unsigned CConsole::HashCommandName(const char *pName)
+{
+	// fnv-1a over the lower case name
+	unsigned Hash = 2166136261u;
+	for(; *pName; pName++)
+	{
+		unsigned char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a'-'A';
+		Hash = (Hash^c)*16777619u;
+	}
+	return Hash&(COMMAND_HASH_SIZE-1);
+}
+
+void CConsole::HashAdd(CCommand *pCommand)
+{
+	unsigned Hash = HashCommandName(pCommand->m_pName);
+	pCommand->m_pHashNext = m_apCommandHash[Hash];
+	m_apCommandHash[Hash] = pCommand;
+}
+
+void CConsole::HashRemove(CCommand *pCommand)
+{
+	for(CCommand **ppEntry = &m_apCommandHash[HashCommandName(pCommand->m_pName)]; *ppEntry; ppEntry = &(*ppEntry)->m_pHashNext)
+	{
+		if(*ppEntry == pCommand)
+		{
+			*ppEntry = pCommand->m_pHashNext;
+			break;
+		}
+	}
+}
+
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[HashCommandName(pName)]; pCommand; pCommand = pCommand->m_pHashNext)
 	{
 		if(pCommand->m_Flags&FlagMask)
 		{
@@ -654,6 +690,7 @@ CConsole::CConsole(int FlagMask)
 	m_paStrokeStr[1] = "1";
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
 	m_pFirstExec = 0;
 	mem_zero(m_aPrintCB, sizeof(m_aPrintCB));
 	m_NumPrintCB = 0;
@@ -749,6 +786,8 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 			}
 		}
 	}
+
+	HashAdd(pCommand);
 }
 
 void CConsole::Register(const char *pName, const char *pParams,
@@ -838,6 +877,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		HashRemove(pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -859,6 +899,18 @@ void CConsole::DeregisterTempAll()
 		}
 	}
 
+	// remove temp entries from the index
+	for(int i = 0; i < COMMAND_HASH_SIZE; i++)
+	{
+		for(CCommand **ppEntry = &m_apCommandHash[i]; *ppEntry;)
+		{
+			if((*ppEntry)->m_Temp)
+				*ppEntry = (*ppEntry)->m_pHashNext;
+			else
+				ppEntry = &(*ppEntry)->m_pHashNext;
+		}
+	}
+
 	m_TempCommands.Reset();
 	m_pRecycleList = 0;
 }
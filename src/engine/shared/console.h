@@ -12,6 +12,7 @@ class CConsole : public IConsole
 	{
 	public:
 		CCommand *m_pNext;
+		CCommand *m_pHashNext;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -37,6 +38,16 @@ class CConsole : public IConsole
 	const char *m_paStrokeStr[2];
 	CCommand *m_pFirstCommand;
 
+	// case insensitive index over the command list
+	enum
+	{
+		COMMAND_HASH_SIZE=1024,
+	};
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+	static unsigned HashCommandName(const char *pName);
+	void HashAdd(CCommand *pCommand);
+	void HashRemove(CCommand *pCommand);
+
 	class CExecFile
 	{
 	public:
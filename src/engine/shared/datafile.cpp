@@ -55,15 +55,36 @@ struct CDatafileInfo
 	char *m_pDataStart;
 };
 
+enum
+{
+	// bytes of decompressed data that is kept around after it has been unloaded
+	DATA_CACHE_SIZE=8*1024*1024,
+};
+
+struct CDatafileBlock
+{
+	char *m_pData; // 0 if not loaded
+	int m_AllocSize;
+	bool m_Cached; // unloaded, but still held by the cache
+	int m_CachePrev;
+	int m_CacheNext;
+};
+
 struct CDatafile
 {
 	IOHANDLE m_File;
+	unsigned m_FileSize;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
 	int m_DataStartOffset;
-	char **m_ppDataPtrs;
+	CDatafileBlock *m_pBlocks;
 	char *m_pData;
+
+	// unloaded blocks, least recently used first
+	int m_CacheFirst;
+	int m_CacheLast;
+	int m_CacheSize;
 };
 
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
@@ -77,9 +98,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
-
 	// take the CRC of the file and store it
 	unsigned Crc = 0;
+	unsigned FileSize = 0;
 	{
 		enum
 		{
@@ -94,20 +115,26 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 			if(Bytes <= 0)
 				break;
 			Crc = crc32(Crc, aBuffer, Bytes); // ignore_convention
+			FileSize += Bytes;
 		}
 
 		io_seek(File, 0, IOSEEK_START);
 	}
 
-
 	// TODO: change this header
 	CDatafileHeader Header;
-	io_read(File, &Header, sizeof(Header));
+	if(io_read(File, &Header, sizeof(Header)) != sizeof(Header))
+	{
+		io_close(File);
+		dbg_msg("datafile", "file too small. size=%d", FileSize);
+		return false;
+	}
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			io_close(File);
 			return 0;
 		}
 	}
@@ -118,10 +145,11 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		io_close(File);
 		return 0;
 	}
 
-	// read in the rest except the data
+	// read in the rest except the data, the data blocks are read when they are requested
 	unsigned Size = 0;
 	Size += Header.m_NumItemTypes*sizeof(CDatafileItemType);
 	Size += (Header.m_NumItems+Header.m_NumRawData)*sizeof(int);
@@ -129,28 +157,39 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		Size += Header.m_NumRawData*sizeof(int); // v4 has uncompressed data sizes aswell
 	Size += Header.m_ItemSize;
 
-	unsigned AllocSize = Size;
-	AllocSize += sizeof(CDatafile); // add space for info structure
-	AllocSize += Header.m_NumRawData*sizeof(void*); // add space for data pointers
+	if(Header.m_NumItemTypes < 0 || Header.m_NumItems < 0 || Header.m_NumRawData < 0 || Header.m_ItemSize < 0 ||
+		Size > FileSize-sizeof(CDatafileHeader))
+	{
+		io_close(File);
+		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, FileSize-(unsigned)sizeof(CDatafileHeader));
+		return false;
+	}
 
-	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc(AllocSize, 1);
+	unsigned AllocSize = sizeof(CDatafile); // info structure
+	AllocSize += Header.m_NumRawData*sizeof(CDatafileBlock); // data blocks
+	AllocSize += Size;
+
+	CDatafile *pTmpDataFile = (CDatafile*)mem_alloc(AllocSize, sizeof(int));
+	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_FileSize = FileSize;
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
-	pTmpDataFile->m_ppDataPtrs = (char**)(pTmpDataFile+1);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
-	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pBlocks = (CDatafileBlock *)(pTmpDataFile+1);
+	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pBlocks+Header.m_NumRawData);
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_CacheFirst = -1;
+	pTmpDataFile->m_CacheLast = -1;
+	pTmpDataFile->m_CacheSize = 0;
 
-	// clear the data pointers
-	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
+	// clear the data blocks
+	mem_zero(pTmpDataFile->m_pBlocks, Header.m_NumRawData*sizeof(CDatafileBlock));
 
 	// read types, offsets, sizes and item data
 	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
 	if(ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
+		io_close(File);
 		mem_free(pTmpDataFile);
-		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
 		return false;
 	}
@@ -165,7 +204,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	//if(DEBUG)
 	{
 		dbg_msg("datafile", "allocsize=%d", AllocSize);
-		dbg_msg("datafile", "readsize=%d", ReadSize);
+		dbg_msg("datafile", "filesize=%d", FileSize);
 		dbg_msg("datafile", "swaplen=%d", Header.m_Swaplen);
 		dbg_msg("datafile", "item_size=%d", m_pDataFile->m_Header.m_ItemSize);
 	}
@@ -264,15 +303,54 @@ int CDataFileReader::GetDataSize(int Index)
 	return m_pDataFile->m_Info.m_pDataOffsets[Index+1]-m_pDataFile->m_Info.m_pDataOffsets[Index];
 }
 
-void *CDataFileReader::GetDataImpl(int Index, int Swap)
+// size of the data returned by GetData
+int CDataFileReader::GetUncompressedDataSize(int Index)
 {
 	if(!m_pDataFile) { return 0; }
 
+	if(m_pDataFile->m_Header.m_Version == 4)
+		return m_pDataFile->m_Info.m_pDataSizes[Index];
+	return GetDataSize(Index);
+}
+
+void CDataFileReader::CacheRemove(int Index)
+{
+	CDatafileBlock *pBlock = &m_pDataFile->m_pBlocks[Index];
+	if(pBlock->m_CachePrev != -1)
+		m_pDataFile->m_pBlocks[pBlock->m_CachePrev].m_CacheNext = pBlock->m_CacheNext;
+	else
+		m_pDataFile->m_CacheFirst = pBlock->m_CacheNext;
+	if(pBlock->m_CacheNext != -1)
+		m_pDataFile->m_pBlocks[pBlock->m_CacheNext].m_CachePrev = pBlock->m_CachePrev;
+	else
+		m_pDataFile->m_CacheLast = pBlock->m_CachePrev;
+
+	pBlock->m_Cached = false;
+	m_pDataFile->m_CacheSize -= pBlock->m_AllocSize;
+}
+
+void *CDataFileReader::GetDataImpl(int Index, int Swap)
+{
+	if(!m_pDataFile || Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData) { return 0; }
+
+	CDatafileBlock *pBlock = &m_pDataFile->m_pBlocks[Index];
+
+	// unloaded earlier but still cached
+	if(pBlock->m_Cached)
+		CacheRemove(Index);
+
 	// load it if needed
-	if(!m_pDataFile->m_ppDataPtrs[Index])
+	if(!pBlock->m_pData)
 	{
 		// fetch the data size
 		int DataSize = GetDataSize(Index);
+		int Offset = m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index];
+		if(DataSize < 0 || Offset < m_pDataFile->m_DataStartOffset || (unsigned)Offset+DataSize > m_pDataFile->m_FileSize)
+		{
+			dbg_msg("datafile", "invalid data index=%d offset=%d size=%d", Index, Offset, DataSize);
+			return 0;
+		}
+		io_seek(m_pDataFile->m_File, Offset, IOSEEK_START);
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		int SwapSize = DataSize;
 #endif
@@ -280,43 +358,58 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			void *pTemp = (char *)mem_alloc(DataSize, 1);
+			char *pTemp = (char *)mem_alloc(max(DataSize, 1), 1);
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
 			unsigned long s;
 
 			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
+			pBlock->m_pData = (char *)mem_alloc(max(UncompressedSize, 1ul), sizeof(int));
+			pBlock->m_AllocSize = max(UncompressedSize, 1ul);
 
 			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+			bool Read = io_read(m_pDataFile->m_File, pTemp, DataSize) == (unsigned)DataSize;
 
-			// decompress the data, TODO: check for errors
+			// decompress the data
 			s = UncompressedSize;
-			uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef*)pTemp, DataSize); // ignore_convention
-#if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = s;
-#endif
+			if(!Read || uncompress((Bytef*)pBlock->m_pData, &s, (Bytef*)pTemp, DataSize) != Z_OK) // ignore_convention
+			{
+				dbg_msg("datafile", "couldn't %s data index=%d", Read ? "decompress" : "read", Index);
+				mem_free(pTemp);
+				mem_free(pBlock->m_pData);
+				pBlock->m_pData = 0x0;
+				pBlock->m_AllocSize = 0;
+				return 0;
+			}
 
 			// clean up the temporary buffers
 			mem_free(pTemp);
+#if defined(CONF_ARCH_ENDIAN_BIG)
+			SwapSize = s;
+#endif
 		}
 		else
 		{
-			// load the data
+			// v3 data is stored as is, just read it
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			pBlock->m_pData = (char *)mem_alloc(max(DataSize, 1), sizeof(int));
+			pBlock->m_AllocSize = max(DataSize, 1);
+			if(io_read(m_pDataFile->m_File, pBlock->m_pData, DataSize) != (unsigned)DataSize)
+			{
+				dbg_msg("datafile", "couldn't read data index=%d", Index);
+				mem_free(pBlock->m_pData);
+				pBlock->m_pData = 0x0;
+				pBlock->m_AllocSize = 0;
+				return 0;
+			}
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		if(Swap && SwapSize)
-			swap_endian(m_pDataFile->m_ppDataPtrs[Index], sizeof(int), SwapSize/sizeof(int));
+			swap_endian(pBlock->m_pData, sizeof(int), SwapSize/sizeof(int));
 #endif
 	}
 
-	return m_pDataFile->m_ppDataPtrs[Index];
+	return pBlock->m_pData;
 }
 
 void *CDataFileReader::GetData(int Index)
@@ -331,20 +424,42 @@ void *CDataFileReader::GetDataSwapped(int Index)
 
 void CDataFileReader::UnloadData(int Index)
 {
-	if(Index < 0)
+	if(!m_pDataFile || Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
+		return;
+
+	CDatafileBlock *pBlock = &m_pDataFile->m_pBlocks[Index];
+	if(!pBlock->m_pData || pBlock->m_Cached)
 		return;
 
-	//
-	mem_free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
+	// keep the decompressed data around in case it is requested again
+	pBlock->m_Cached = true;
+	pBlock->m_CachePrev = m_pDataFile->m_CacheLast;
+	pBlock->m_CacheNext = -1;
+	if(m_pDataFile->m_CacheLast != -1)
+		m_pDataFile->m_pBlocks[m_pDataFile->m_CacheLast].m_CacheNext = Index;
+	else
+		m_pDataFile->m_CacheFirst = Index;
+	m_pDataFile->m_CacheLast = Index;
+	m_pDataFile->m_CacheSize += pBlock->m_AllocSize;
+
+	// drop the least recently used blocks that don't fit
+	while(m_pDataFile->m_CacheSize > DATA_CACHE_SIZE)
+	{
+		int Oldest = m_pDataFile->m_CacheFirst;
+		CacheRemove(Oldest);
+		mem_free(m_pDataFile->m_pBlocks[Oldest].m_pData);
+		m_pDataFile->m_pBlocks[Oldest].m_pData = 0x0;
+		m_pDataFile->m_pBlocks[Oldest].m_AllocSize = 0;
+	}
 }
 
+// size of the item data returned by GetItem, without the item header
 int CDataFileReader::GetItemSize(int Index)
 {
 	if(!m_pDataFile) { return 0; }
 	if(Index == m_pDataFile->m_Header.m_NumItems-1)
-		return m_pDataFile->m_Header.m_ItemSize-m_pDataFile->m_Info.m_pItemOffsets[Index];
-	return m_pDataFile->m_Info.m_pItemOffsets[Index+1]-m_pDataFile->m_Info.m_pItemOffsets[Index];
+		return m_pDataFile->m_Header.m_ItemSize-m_pDataFile->m_Info.m_pItemOffsets[Index]-sizeof(CDatafileItem);
+	return m_pDataFile->m_Info.m_pItemOffsets[Index+1]-m_pDataFile->m_Info.m_pItemOffsets[Index]-sizeof(CDatafileItem);
 }
 
 void *CDataFileReader::GetItem(int Index, int *pType, int *pID)
@@ -405,10 +520,13 @@ bool CDataFileReader::Close()
 	if(!m_pDataFile)
 		return true;
 
-	// free the data that is loaded
+	// free the data that is loaded or cached
 	int i;
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		mem_free(m_pDataFile->m_ppDataPtrs[i]);
+	{
+		if(m_pDataFile->m_pBlocks[i].m_pData)
+			mem_free(m_pDataFile->m_pBlocks[i].m_pData);
+	}
 
 	io_close(m_pDataFile->m_File);
 	mem_free(m_pDataFile);
@@ -423,9 +541,14 @@ unsigned CDataFileReader::Crc()
 }
 
 
+CJobPool CDataFileWriter::ms_CompressionPool;
+bool CDataFileWriter::ms_CompressionPoolStarted = false;
+
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_NumItems = 0;
+	m_NumDatas = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1));
 	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS, 1));
 	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS, 1));
@@ -433,6 +556,12 @@ CDataFileWriter::CDataFileWriter()
 
 CDataFileWriter::~CDataFileWriter()
 {
+	// the jobs still reference the data of an unfinished file
+	WaitForData();
+	FreeData();
+	if(m_File)
+		io_close(m_File);
+
 	mem_free(m_pItemTypes);
 	m_pItemTypes = 0;
 	mem_free(m_pItems);
@@ -498,28 +627,35 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	return m_NumItems-1;
 }
 
+int CDataFileWriter::CompressJob(void *pUser)
+{
+	CDataInfo *pInfo = (CDataInfo *)pUser;
+	unsigned long s = pInfo->m_CompressedSize;
+	int Result = compress((Bytef*)pInfo->m_pCompressedData, &s, (Bytef*)pInfo->m_pUncompressedData, pInfo->m_UncompressedSize); // ignore_convention
+	pInfo->m_CompressedSize = (int)s;
+	return Result;
+}
+
 int CDataFileWriter::AddData(int Size, void *pData)
 {
 	if(!m_File) return 0;
 
 	dbg_assert(m_NumDatas < 1024, "too much data");
 
-	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = mem_alloc(s, 1); // temporary buffer that we use during compression
-
-	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, Size); // ignore_convention
-	if(Result != Z_OK)
+	if(!ms_CompressionPoolStarted)
 	{
-		dbg_msg("datafile", "compression error %d", Result);
-		dbg_assert(0, "zlib error");
+		ms_CompressionPool.Init(COMPRESSION_THREADS);
+		ms_CompressionPoolStarted = true;
 	}
 
+	// the workers only compress, all buffers are allocated here as mem_alloc is not thread safe
+	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
 	pInfo->m_UncompressedSize = Size;
-	pInfo->m_CompressedSize = (int)s;
+	pInfo->m_pUncompressedData = mem_alloc(max(Size, 1), 1);
+	mem_copy(pInfo->m_pUncompressedData, pData, Size);
+	pInfo->m_CompressedSize = (int)compressBound(Size);
 	pInfo->m_pCompressedData = mem_alloc(pInfo->m_CompressedSize, 1);
-	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
-	mem_free(pCompData);
+	ms_CompressionPool.Add(&pInfo->m_Job, CompressJob, pInfo);
 
 	m_NumDatas++;
 	return m_NumDatas-1;
@@ -551,6 +687,17 @@ int CDataFileWriter::Finish()
 	int DataSize = 0;
 	CDatafileHeader Header;
 
+	// wait for the compression, the blocks are written in the order they were added
+	WaitForData();
+	for(int i = 0; i < m_NumDatas; i++)
+	{
+		if(m_pDatas[i].m_Job.Result() != Z_OK)
+		{
+			dbg_msg("datafile", "compression error %d", m_pDatas[i].m_Job.Result());
+			dbg_assert(0, "zlib error");
+		}
+	}
+
 	// we should now write this file!
 	if(DEBUG)
 		dbg_msg("datafile", "writing");
@@ -709,10 +856,7 @@ int CDataFileWriter::Finish()
 	}
 
 	// free data
-	for(int i = 0; i < m_NumItems; i++)
-		mem_free(m_pItems[i].m_pData);
-	for(int i = 0; i < m_NumDatas; ++i)
-		mem_free(m_pDatas[i].m_pCompressedData);
+	FreeData();
 
 	io_close(m_File);
 	m_File = 0;
@@ -721,3 +865,25 @@ int CDataFileWriter::Finish()
 		dbg_msg("datafile", "done");
 	return 0;
 }
+
+void CDataFileWriter::WaitForData()
+{
+	for(int i = 0; i < m_NumDatas; i++)
+	{
+		while(m_pDatas[i].m_Job.Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+	}
+}
+
+void CDataFileWriter::FreeData()
+{
+	for(int i = 0; i < m_NumItems; i++)
+		mem_free(m_pItems[i].m_pData);
+	for(int i = 0; i < m_NumDatas; ++i)
+	{
+		mem_free(m_pDatas[i].m_pUncompressedData);
+		mem_free(m_pDatas[i].m_pCompressedData);
+	}
+	m_NumItems = 0;
+	m_NumDatas = 0;
+}
@@ -3,11 +3,15 @@
 #ifndef ENGINE_SHARED_DATAFILE_H
 #define ENGINE_SHARED_DATAFILE_H
 
-// raw datafile access
+#include <base/system.h>
+#include "jobs.h"
+// raw datafile access, only the header and items are kept in memory, data blocks are read on demand.
+// pointers from GetData stay valid until UnloadData or Close
 class CDataFileReader
 {
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	void CacheRemove(int Index);
 public:
 	CDataFileReader() : m_pDataFile(0) {}
 	~CDataFileReader() { Close(); }
@@ -22,6 +26,7 @@ public:
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
 	int GetDataSize(int Index);
+	int GetUncompressedDataSize(int Index);
 	void UnloadData(int Index);
 	void *GetItem(int Index, int *pType, int *pID);
 	int GetItemSize(int Index);
@@ -34,14 +39,17 @@ public:
 	unsigned Crc();
 };
 
-// write access
+// write access, data blocks are compressed in the background between AddData and Finish.
+// a writer must only be used from one thread
 class CDataFileWriter
 {
 	struct CDataInfo
 	{
 		int m_UncompressedSize;
 		int m_CompressedSize;
+		void *m_pUncompressedData;
 		void *m_pCompressedData;
+		CJob m_Job;
 	};
 
 	struct CItemInfo
@@ -66,8 +74,14 @@ class CDataFileWriter
 		MAX_ITEM_TYPES=0xffff,
 		MAX_ITEMS=1024,
 		MAX_DATAS=1024,
+
+		COMPRESSION_THREADS=4,
 	};
 
+	static CJobPool ms_CompressionPool;
+	static bool ms_CompressionPoolStarted;
+	static int CompressJob(void *pUser);
+
 	IOHANDLE m_File;
 	int m_NumItems;
 	int m_NumDatas;
@@ -76,6 +90,9 @@ class CDataFileWriter
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
 
+	void WaitForData();
+	void FreeData();
+
 public:
 	CDataFileWriter();
 	~CDataFileWriter();
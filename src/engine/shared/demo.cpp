@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -17,13 +18,21 @@ static const unsigned char gs_ActVersion = 4;
 static const unsigned char gs_OldVersion = 3;
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
+static const unsigned char gs_aIndexMarker[4] = {'T', 'W', 'I', 'X'};
 
 
-CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
+CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool Threaded)
 {
 	m_File = 0;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+	m_Threaded = Threaded;
+	m_pWriterThread = 0;
+	m_MapFile = 0;
+	m_pRing = 0;
+	m_pWriteBuffer = 0;
+	mem_zero(m_apSeekPoints, sizeof(m_apSeekPoints));
+	m_NumSeekPoints = 0;
 }
 
 // Record
@@ -95,6 +104,39 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	io_write(DemoFile, &Header, sizeof(Header));
 	io_write(DemoFile, &TimelineMarkers, sizeof(TimelineMarkers)); // fill this on stop
 
+	m_LastKeyFrame = -1;
+	m_LastTickMarker = -1;
+	m_FirstTick = -1;
+	m_LastSnapshotSize = 0;
+	m_NumTimelineMarkers = 0;
+	m_NumSeekPoints = 0;
+	m_LastSeekPoint = -1;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
+	m_File = DemoFile;
+
+	if(m_Threaded)
+	{
+		// the writer copies the map data before any chunk
+		m_MapFile = MapFile;
+		m_pRing = (unsigned char *)mem_alloc(RING_SIZE, 8);
+		m_RingRead = 0;
+		m_RingWrite = 0;
+		m_WriterStop = 0;
+		m_ProducerWaiting = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+		semaphore_init(&m_SpaceFreed);
+#endif
+		m_pWriteBuffer = (unsigned char *)mem_alloc(WRITE_BUFFER_SIZE, 1);
+		m_WriteBufferSize = 0;
+		m_NumDropped = 0;
+		m_NumStalls = 0;
+		m_pWriterThread = thread_create(WriterThread, this);
+		return 0;
+	}
+
 	// write map data
 	while(1)
 	{
@@ -106,16 +148,6 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	}
 	io_close(MapFile);
 
-	m_LastKeyFrame = -1;
-	m_LastTickMarker = -1;
-	m_FirstTick = -1;
-	m_NumTimelineMarkers = 0;
-
-	char aBuf[256];
-	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
-	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
-	m_File = DemoFile;
-
 	return 0;
 }
 
@@ -129,6 +161,15 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 		7 = Not set
 		5-6	= Type
 		0-4	= Size
+
+	Index chunks have type 0, which older players decode and ignore. The
+	first int of their data tells what they hold:
+		snapshot	= the snapshot the next delta is based on, written at
+					  seek points between keyframes before a full tickmarker
+		table		= tick and file position of seek points
+
+	A demo with an index ends with a footer chunk. Its data is an empty
+	compressed chunk followed by the raw CIndexFooter.
 */
 
 enum
@@ -140,16 +181,276 @@ enum
 	CHUNKMASK_TYPE = 0x60,
 	CHUNKMASK_SIZE = 0x1f,
 
+	CHUNKTYPE_INDEX = 0,
 	CHUNKTYPE_SNAPSHOT = 1,
 	CHUNKTYPE_MESSAGE = 2,
 	CHUNKTYPE_DELTA = 3,
 
-	CHUNKFLAG_BIGSIZE = 0x10
+	CHUNKFLAG_BIGSIZE = 0x10,
+
+	INDEXKIND_SNAPSHOT = 1,
+	INDEXKIND_TABLE = 2,
+
+	INDEX_TABLE_ENTRIES = 1024, // per chunk
+};
+
+// at the very end of a demo with an index, all values are big endian
+struct CIndexFooter
+{
+	unsigned char m_aNumSeekPoints[4];
+	unsigned char m_aFirstTick[4];
+	unsigned char m_aLastTick[4];
+	unsigned char m_aTablePos[4];
+	unsigned char m_aMarker[4];
 };
 
-void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
+static void PackInt(unsigned char *pBuf, int Value)
+{
+	pBuf[0] = (Value>>24)&0xff;
+	pBuf[1] = (Value>>16)&0xff;
+	pBuf[2] = (Value>>8)&0xff;
+	pBuf[3] = (Value)&0xff;
+}
+
+static int UnpackInt(const unsigned char *pBuf)
+{
+	return (pBuf[0]<<24) | (pBuf[1]<<16) | (pBuf[2]<<8) | pBuf[3];
+}
+
+// chunk in the writer ring, followed by its data padded to 8 bytes
+struct CRingChunk
+{
+	int m_Type;
+	int m_Size;
+};
+
+enum
+{
+	RINGCHUNK_WRAP=-1, // rest of the ring is unused, continue at the start
+	RINGCHUNK_RAW=-2, // written as is, the chunk types are compressed
+	RINGCHUNK_SEEKPOINT=-3, // the data is the seek point that gets the current file position
+};
+
+static int RingChunkSize(int Size)
+{
+	return sizeof(CRingChunk) + ((Size+7)&~7);
+}
+
+/* pad the data with 0 so we get an alignment of 4,
+else the compression won't work and miss some bytes.
+pOut receives the chunk header and the compressed data */
+static int CompressChunk(int Type, const void *pData, int Size, unsigned char *pOut)
+{
+	char aBuffer[64*1024];
+	char aBuffer2[64*1024];
+
+	mem_copy(aBuffer2, pData, Size);
+	while(Size&3)
+		aBuffer2[Size++] = 0;
+	Size = CVariableInt::Compress(aBuffer2, Size, aBuffer); // buffer2 -> buffer
+	Size = CNetBase::Compress(aBuffer, Size, aBuffer2, sizeof(aBuffer2)); // buffer -> buffer2
+
+	int HeaderSize;
+	pOut[0] = ((Type&0x3)<<5);
+	if(Size < 30)
+	{
+		pOut[0] |= Size;
+		HeaderSize = 1;
+	}
+	else
+	{
+		if(Size < 256)
+		{
+			pOut[0] |= 30;
+			pOut[1] = Size&0xff;
+			HeaderSize = 2;
+		}
+		else
+		{
+			pOut[0] |= 31;
+			pOut[1] = Size&0xff;
+			pOut[2] = Size>>8;
+			HeaderSize = 3;
+		}
+	}
+
+	mem_copy(pOut+HeaderSize, aBuffer2, Size);
+	return HeaderSize+Size;
+}
+
+bool CDemoRecorder::RingReserve(int Size) const
+{
+	// a chunk that does not fit at the end of the ring wastes the rest of it
+	unsigned Free = RING_SIZE - (m_RingWrite - m_RingRead);
+	return Free >= 2*(unsigned)RingChunkSize(Size);
+}
+
+bool CDemoRecorder::QueueChunk(int Type, const void *pData, int Size)
+{
+	unsigned Write = m_RingWrite;
+	unsigned Used = Write - m_RingRead;
+	unsigned Offset = Write&(RING_SIZE-1);
+	unsigned Tail = RING_SIZE-Offset;
+	unsigned Need = RingChunkSize(Size);
+	unsigned Waste = Tail < Need ? Tail : 0;
+	if(Used+Waste+Need > RING_SIZE)
+		return false;
+
+	if(Waste)
+	{
+		((CRingChunk *)(m_pRing+Offset))->m_Type = RINGCHUNK_WRAP;
+		Write += Waste;
+		Offset = 0;
+	}
+
+	CRingChunk *pChunk = (CRingChunk *)(m_pRing+Offset);
+	pChunk->m_Type = Type;
+	pChunk->m_Size = Size;
+	mem_copy(pChunk+1, pData, Size);
+
+	// publish the chunk after its data is visible
+	sync_barrier();
+	m_RingWrite = Write+Need;
+	return true;
+}
+
+void CDemoRecorder::QueueChunkWait(int Type, const void *pData, int Size)
+{
+	if(QueueChunk(Type, pData, Size))
+		return;
+
+	// announce the wait before checking again, so the writer can't miss it
+	m_NumStalls++;
+	while(1)
+	{
+		m_ProducerWaiting = 1;
+		sync_barrier();
+		if(QueueChunk(Type, pData, Size))
+			break;
+#if !defined(CONF_PLATFORM_MACOSX)
+		semaphore_wait(&m_SpaceFreed);
+#else
+		thread_sleep(1);
+#endif
+	}
+	m_ProducerWaiting = 0;
+}
+
+int CDemoRecorder::ProcessRing()
+{
+	unsigned Read = m_RingRead;
+	unsigned Write = m_RingWrite;
+	sync_barrier();
+
+	int Num = 0;
+	while(Read != Write)
+	{
+		unsigned Offset = Read&(RING_SIZE-1);
+		CRingChunk *pChunk = (CRingChunk *)(m_pRing+Offset);
+		if(pChunk->m_Type == RINGCHUNK_WRAP)
+		{
+			Read += RING_SIZE-Offset;
+			continue;
+		}
+
+		// make sure the largest possible chunk fits
+		if(m_WriteBufferSize + 3 + 64*1024 > WRITE_BUFFER_SIZE)
+			FlushWriteBuffer();
+
+		if(pChunk->m_Type == RINGCHUNK_RAW)
+		{
+			mem_copy(m_pWriteBuffer+m_WriteBufferSize, pChunk+1, pChunk->m_Size);
+			m_WriteBufferSize += pChunk->m_Size;
+		}
+		else if(pChunk->m_Type == RINGCHUNK_SEEKPOINT)
+		{
+			CSeekPoint *pPoint;
+			mem_copy(&pPoint, pChunk+1, sizeof(pPoint));
+			pPoint->m_Filepos = io_tell(m_File)+m_WriteBufferSize;
+		}
+		else
+			m_WriteBufferSize += CompressChunk(pChunk->m_Type, pChunk+1, pChunk->m_Size, m_pWriteBuffer+m_WriteBufferSize);
+
+		Read += RingChunkSize(pChunk->m_Size);
+		Num++;
+
+		// hand the space back to the producer
+		sync_barrier();
+		m_RingRead = Read;
+	}
+
+	return Num;
+}
+
+void CDemoRecorder::FlushWriteBuffer()
+{
+	if(m_WriteBufferSize)
+		io_write(m_File, m_pWriteBuffer, m_WriteBufferSize);
+	m_WriteBufferSize = 0;
+}
+
+void CDemoRecorder::WriterThread(void *pUser)
+{
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+
+	// write map data
+	while(1)
+	{
+		int Bytes = io_read(pSelf->m_MapFile, pSelf->m_pWriteBuffer, WRITE_BUFFER_SIZE);
+		if(Bytes <= 0)
+			break;
+		io_write(pSelf->m_File, pSelf->m_pWriteBuffer, Bytes);
+	}
+	io_close(pSelf->m_MapFile);
+	pSelf->m_MapFile = 0;
+
+	int64 LastFlush = time_get();
+	while(1)
+	{
+		// everything queued before the stop request is visible after this
+		unsigned Stop = pSelf->m_WriterStop;
+		sync_barrier();
+
+		int Num = pSelf->ProcessRing();
+
+		// wake up a producer waiting for space
+		sync_barrier();
+		if(pSelf->m_ProducerWaiting)
+		{
+			pSelf->m_ProducerWaiting = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+			semaphore_signal(&pSelf->m_SpaceFreed);
+#endif
+		}
+
+		// write in large blocks, but do not keep data back for long
+		if(pSelf->m_WriteBufferSize >= FLUSH_SIZE || (pSelf->m_WriteBufferSize && (Stop || time_get()-LastFlush > time_freq())))
+		{
+			pSelf->FlushWriteBuffer();
+			LastFlush = time_get();
+		}
+
+		if(Stop)
+			break;
+		if(!Num)
+			thread_sleep(5);
+	}
+}
+
+void CDemoRecorder::WriteRaw(const void *pData, int Size)
 {
-	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe)
+	if(m_Threaded)
+	{
+		// tick markers can't be dropped without breaking the file, wait for the writer instead
+		QueueChunkWait(RINGCHUNK_RAW, pData, Size);
+	}
+	else
+		io_write(m_File, pData, Size);
+}
+
+void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe, bool Full)
+{
+	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe || Full)
 	{
 		unsigned char aChunk[5];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
@@ -161,13 +462,13 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 		if(Keyframe)
 			aChunk[0] |= CHUNKTICKFLAG_KEYFRAME;
 
-		io_write(m_File, aChunk, sizeof(aChunk));
+		WriteRaw(aChunk, sizeof(aChunk));
 	}
 	else
 	{
 		unsigned char aChunk[1];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastTickMarker);
-		io_write(m_File, aChunk, sizeof(aChunk));
+		WriteRaw(aChunk, sizeof(aChunk));
 	}
 
 	m_LastTickMarker = Tick;
@@ -177,60 +478,72 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
 {
-	char aBuffer[64*1024];
-	char aBuffer2[64*1024];
-	unsigned char aChunk[3];
-
 	if(!m_File)
 		return;
 
-	/* pad the data with 0 so we get an alignment of 4,
-	else the compression won't work and miss some bytes */
-	mem_copy(aBuffer2, pData, Size);
-	while(Size&3)
-		aBuffer2[Size++] = 0;
-	Size = CVariableInt::Compress(aBuffer2, Size, aBuffer); // buffer2 -> buffer
-	Size = CNetBase::Compress(aBuffer, Size, aBuffer2, sizeof(aBuffer2)); // buffer -> buffer2
+	if(m_Threaded)
+	{
+		// only whole snapshots are skipped when the writer falls behind, see RecordSnapshot
+		QueueChunkWait(Type, pData, Size);
+		return;
+	}
 
+	unsigned char aChunk[3+64*1024];
+	io_write(m_File, aChunk, CompressChunk(Type, pData, Size, aChunk));
+}
 
-	aChunk[0] = ((Type&0x3)<<5);
-	if(Size < 30)
+bool CDemoRecorder::AddSeekPoint(int Tick)
+{
+	int Block = m_NumSeekPoints/SEEKPOINT_BLOCK_SIZE;
+	if(Block >= MAX_SEEKPOINT_BLOCKS)
+		return false;
+	if(!m_apSeekPoints[Block])
+		m_apSeekPoints[Block] = (CSeekPoint *)mem_alloc(SEEKPOINT_BLOCK_SIZE*sizeof(CSeekPoint), 1);
+
+	CSeekPoint *pPoint = &m_apSeekPoints[Block][m_NumSeekPoints%SEEKPOINT_BLOCK_SIZE];
+	pPoint->m_Tick = Tick;
+	if(m_Threaded)
 	{
-		aChunk[0] |= Size;
-		io_write(m_File, aChunk, 1);
+		// only the writer knows the file position, the blocks never move
+		if(!QueueChunk(RINGCHUNK_SEEKPOINT, &pPoint, sizeof(pPoint)))
+			return false;
 	}
 	else
-	{
-		if(Size < 256)
-		{
-			aChunk[0] |= 30;
-			aChunk[1] = Size&0xff;
-			io_write(m_File, aChunk, 2);
-		}
-		else
-		{
-			aChunk[0] |= 31;
-			aChunk[1] = Size&0xff;
-			aChunk[2] = Size>>8;
-			io_write(m_File, aChunk, 3);
-		}
-	}
+		pPoint->m_Filepos = io_tell(m_File);
 
-	io_write(m_File, aBuffer2, Size);
+	m_NumSeekPoints++;
+	return true;
 }
 
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
-	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
+	bool KeyFrame = m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5;
+
+	// between keyframes the last snapshot is stored once a second, so seeking
+	// can continue with the deltas from there
+	bool SeekPoint = !KeyFrame && Tick-m_LastSeekPoint >= SERVER_TICK_SPEED && m_LastSnapshotSize+(int)sizeof(int) <= CSnapshot::MAX_SIZE;
+
+	// skip the snapshot when the writer falls behind, the next one becomes a keyframe
+	if(m_Threaded && !RingReserve((SeekPoint ? 2 : 1)*(CSnapshot::MAX_SIZE+64)))
+	{
+		m_NumDropped++;
+		m_LastKeyFrame = -1;
+		return;
+	}
+
+	if(KeyFrame)
 	{
 		// write full tickmarker
+		AddSeekPoint(Tick);
 		WriteTickMarker(Tick, 1);
 
 		// write snapshot
 		Write(CHUNKTYPE_SNAPSHOT, pData, Size);
 
 		m_LastKeyFrame = Tick;
+		m_LastSeekPoint = Tick;
 		mem_copy(m_aLastSnapshotData, pData, Size);
+		m_LastSnapshotSize = Size;
 	}
 	else
 	{
@@ -238,8 +551,20 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
 		int DeltaSize;
 
-		// write tickmarker
-		WriteTickMarker(Tick, 0);
+		if(SeekPoint && AddSeekPoint(Tick))
+		{
+			// write the snapshot the delta is based on
+			int aIndexData[CSnapshot::MAX_SIZE/sizeof(int)];
+			aIndexData[0] = INDEXKIND_SNAPSHOT;
+			mem_copy(&aIndexData[1], m_aLastSnapshotData, m_LastSnapshotSize);
+			Write(CHUNKTYPE_INDEX, aIndexData, sizeof(int)+m_LastSnapshotSize);
+			m_LastSeekPoint = Tick;
+		}
+		else
+			SeekPoint = false;
+
+		// write tickmarker, a full one at seek points
+		WriteTickMarker(Tick, 0, SeekPoint);
 
 		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
 		if(DeltaSize)
@@ -247,6 +572,7 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 			// record delta
 			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
 			mem_copy(m_aLastSnapshotData, pData, Size);
+			m_LastSnapshotSize = Size;
 		}
 	}
 }
@@ -256,11 +582,79 @@ void CDemoRecorder::RecordMessage(const void *pData, int Size)
 	Write(CHUNKTYPE_MESSAGE, pData, Size);
 }
 
+void CDemoRecorder::WriteIndex()
+{
+	unsigned char aChunk[3+64*1024];
+	int aTable[2+2*INDEX_TABLE_ENTRIES];
+	int TablePos = io_tell(m_File);
+
+	for(int i = 0; i < m_NumSeekPoints; i += INDEX_TABLE_ENTRIES)
+	{
+		int Num = min(m_NumSeekPoints-i, (int)INDEX_TABLE_ENTRIES);
+		aTable[0] = INDEXKIND_TABLE;
+		aTable[1] = Num;
+		for(int j = 0; j < Num; j++)
+		{
+			const CSeekPoint *pPoint = &m_apSeekPoints[(i+j)/SEEKPOINT_BLOCK_SIZE][(i+j)%SEEKPOINT_BLOCK_SIZE];
+			aTable[2+j*2] = pPoint->m_Tick;
+			aTable[3+j*2] = pPoint->m_Filepos;
+		}
+		io_write(m_File, aChunk, CompressChunk(CHUNKTYPE_INDEX, aTable, (2+Num*2)*sizeof(int), aChunk));
+	}
+
+	CIndexFooter Footer;
+	PackInt(Footer.m_aNumSeekPoints, m_NumSeekPoints);
+	PackInt(Footer.m_aFirstTick, m_FirstTick);
+	PackInt(Footer.m_aLastTick, m_LastTickMarker);
+	PackInt(Footer.m_aTablePos, TablePos);
+	mem_copy(Footer.m_aMarker, gs_aIndexMarker, sizeof(Footer.m_aMarker));
+
+	// the decompression stops at the end of the empty data, the footer is never looked at
+	int Size = CNetBase::Compress(aTable, 0, aChunk+2, 64);
+	mem_copy(aChunk+2+Size, &Footer, sizeof(Footer));
+	Size += sizeof(Footer);
+	aChunk[0] = (CHUNKTYPE_INDEX<<5) | 30;
+	aChunk[1] = Size;
+	io_write(m_File, aChunk, 2+Size);
+}
+
 int CDemoRecorder::Stop()
 {
 	if(!m_File)
 		return -1;
 
+	if(m_Threaded)
+	{
+		// let the writer drain the queue
+		sync_barrier();
+		m_WriterStop = 1;
+		thread_wait(m_pWriterThread);
+		m_pWriterThread = 0;
+#if !defined(CONF_PLATFORM_MACOSX)
+		semaphore_destroy(&m_SpaceFreed);
+#endif
+		mem_free(m_pRing);
+		m_pRing = 0;
+		mem_free(m_pWriteBuffer);
+		m_pWriteBuffer = 0;
+
+		if(m_NumDropped || m_NumStalls)
+		{
+			char aBuf[128];
+			str_format(aBuf, sizeof(aBuf), "Writer fell behind, skipped %d snapshots, waited for it %d times", m_NumDropped, m_NumStalls);
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
+		}
+	}
+
+	// add the index
+	if(m_NumSeekPoints)
+		WriteIndex();
+	for(int i = 0; i < MAX_SEEKPOINT_BLOCKS; i++)
+	{
+		mem_free(m_apSeekPoints[i]);
+		m_apSeekPoints[i] = 0;
+	}
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -317,13 +711,17 @@ void CDemoRecorder::AddDemoMarker()
 
 
 
-CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
+CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta, bool Threaded)
 {
 	m_File = 0;
 	m_pKeyFrames = 0;
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
+
+	m_Threaded = Threaded;
+	m_pDecoderThread = 0;
+	m_pRing = 0;
 }
 
 void CDemoPlayer::SetListner(IListner *pListner)
@@ -445,25 +843,315 @@ void CDemoPlayer::ScanFile()
 	io_seek(m_File, StartPos, IOSEEK_START);
 }
 
+bool CDemoPlayer::ReadIndex()
+{
+	long StartPos = io_tell(m_File);
+
+	CIndexFooter Footer;
+	if(io_seek(m_File, -(int)sizeof(Footer), IOSEEK_END) != 0 || io_read(m_File, &Footer, sizeof(Footer)) != sizeof(Footer) ||
+		mem_comp(Footer.m_aMarker, gs_aIndexMarker, sizeof(gs_aIndexMarker)) != 0)
+	{
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	long EndPos = io_tell(m_File);
+	int Num = UnpackInt(Footer.m_aNumSeekPoints);
+	int TablePos = UnpackInt(Footer.m_aTablePos);
+	int NumRead = 0;
+	if(Num > 0 && TablePos >= StartPos && TablePos < EndPos && Num <= EndPos-TablePos)
+	{
+		m_pKeyFrames = (CKeyFrame*)mem_alloc(Num*sizeof(CKeyFrame), 1);
+		io_seek(m_File, TablePos, IOSEEK_START);
+		while(NumRead < Num)
+		{
+			int ChunkType, ChunkSize, ChunkTick = 0;
+			const char *pError;
+			if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) || ChunkType != CHUNKTYPE_INDEX)
+				break;
+
+			int DataSize = ReadChunkData(ChunkSize, &pError);
+			const int *pTable = (const int *)m_aDecodeData;
+			if(DataSize < (int)(2*sizeof(int)) || pTable[0] != INDEXKIND_TABLE || pTable[1] <= 0 || pTable[1] > Num-NumRead ||
+				DataSize < (int)((2+pTable[1]*2)*sizeof(int)))
+				break;
+
+			for(int i = 0; i < pTable[1]; i++, NumRead++)
+			{
+				m_pKeyFrames[NumRead].m_Tick = pTable[2+i*2];
+				m_pKeyFrames[NumRead].m_Filepos = pTable[3+i*2];
+			}
+		}
+	}
+
+	io_seek(m_File, StartPos, IOSEEK_START);
+	if(NumRead != Num || NumRead == 0)
+	{
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "invalid index, scanning the file");
+		mem_free(m_pKeyFrames);
+		m_pKeyFrames = 0;
+		return false;
+	}
+
+	m_Info.m_SeekablePoints = Num;
+	m_Info.m_Info.m_FirstTick = UnpackInt(Footer.m_aFirstTick);
+	m_Info.m_Info.m_LastTick = UnpackInt(Footer.m_aLastTick);
+	return true;
+}
+
+enum
+{
+	DECODED_EOF=-1,
+	DECODED_ERROR=-2, // the data is the message
+	DECODED_BADDELTA=-3, // the size is the error
+	DECODED_WRAP=-4, // rest of the ring is unused, continue at the start
+};
+
+// decoded chunk in the player ring, followed by its data padded to 8 bytes
+struct CDecodedChunk
+{
+	int m_Type;
+	int m_Size;
+	int m_Tick;
+	int m_Reserved;
+};
+
+static int DecodedChunkSize(int Size)
+{
+	return sizeof(CDecodedChunk) + ((Size+7)&~7);
+}
+
+// reads and decompresses the data of a normal chunk into m_aDecodeData
+int CDemoPlayer::ReadChunkData(int ChunkSize, const char **ppError)
+{
+	if(!ChunkSize)
+		return 0;
+
+	if(io_read(m_File, m_aDecodeCompressed, ChunkSize) != (unsigned)ChunkSize)
+	{
+		*ppError = "error reading chunk";
+		return -1;
+	}
+
+	int DataSize = CNetBase::Decompress(m_aDecodeCompressed, ChunkSize, m_aDecodeDecompressed, sizeof(m_aDecodeDecompressed));
+	if(DataSize < 0)
+	{
+		*ppError = "error during network decompression";
+		return -1;
+	}
+
+	DataSize = CVariableInt::Decompress(m_aDecodeDecompressed, DataSize, m_aDecodeData);
+	if(DataSize < 0)
+	{
+		*ppError = "error during intpack decompression";
+		return -1;
+	}
+	return DataSize;
+}
+
+/* reads the next chunk from the file. deltas are unpacked against the last
+decoded snapshot and returned as CHUNKTYPE_SNAPSHOT, the data is in m_aDecodeOut */
+int CDemoPlayer::DecodeChunk(CSnapshotDelta *pDelta, int *pTick, int *pSize, const char **ppError)
+{
+	int ChunkType, ChunkSize;
+	*pSize = 0;
+
+	if(ReadChunkHeader(&ChunkType, &ChunkSize, &m_DecodeTick))
+		return DECODED_EOF;
+	*pTick = m_DecodeTick;
+
+	bool AtSeekPoint = m_DecodeAtSeekPoint;
+	m_DecodeAtSeekPoint = false;
+
+	if(ChunkType&CHUNKTYPEFLAG_TICKMARKER)
+		return CHUNKTYPEFLAG_TICKMARKER;
+
+	// read the chunk
+	int DataSize = ReadChunkData(ChunkSize, ppError);
+	if(DataSize < 0)
+		return DECODED_ERROR;
+
+	if(ChunkType == CHUNKTYPE_INDEX)
+	{
+		/* the snapshot of a seek point is the base of the next delta. it is only
+		used when starting there, the items of the unpacked snapshots are in a
+		different order and playing on keeps them as they are. tables are only used on load */
+		if(AtSeekPoint && DataSize > (int)sizeof(int) && *(int *)m_aDecodeData == INDEXKIND_SNAPSHOT)
+		{
+			DataSize -= sizeof(int);
+			mem_copy(m_aDecodeSnapshot, m_aDecodeData+1, DataSize);
+			mem_copy(m_aDecodeOut, m_aDecodeData+1, DataSize);
+			*pSize = DataSize;
+		}
+		return CHUNKTYPE_INDEX;
+	}
+
+	if(ChunkType == CHUNKTYPE_DELTA)
+	{
+		DataSize = pDelta->UnpackDelta((CSnapshot*)m_aDecodeSnapshot, (CSnapshot*)m_aDecodeOut, m_aDecodeData, DataSize);
+		if(DataSize < 0)
+		{
+			*pSize = DataSize;
+			return DECODED_BADDELTA;
+		}
+		mem_copy(m_aDecodeSnapshot, m_aDecodeOut, DataSize);
+		*pSize = DataSize;
+		return CHUNKTYPE_SNAPSHOT;
+	}
+
+	if(ChunkType == CHUNKTYPE_SNAPSHOT)
+		mem_copy(m_aDecodeSnapshot, m_aDecodeData, DataSize);
+	mem_copy(m_aDecodeOut, m_aDecodeData, DataSize);
+	*pSize = DataSize;
+	return ChunkType;
+}
+
+bool CDemoPlayer::QueueChunk(int Type, int Tick, const void *pData, int Size)
+{
+	unsigned Write = m_RingWrite;
+	unsigned Used = Write - m_RingRead;
+	unsigned Offset = Write&(RING_SIZE-1);
+	unsigned Tail = RING_SIZE-Offset;
+	unsigned Need = DecodedChunkSize(Size);
+	unsigned Waste = Tail < Need ? Tail : 0;
+	if(Used+Waste+Need > RING_SIZE)
+		return false;
+
+	if(Waste)
+	{
+		((CDecodedChunk *)(m_pRing+Offset))->m_Type = DECODED_WRAP;
+		Write += Waste;
+		Offset = 0;
+	}
+
+	CDecodedChunk *pChunk = (CDecodedChunk *)(m_pRing+Offset);
+	pChunk->m_Type = Type;
+	pChunk->m_Size = Size;
+	pChunk->m_Tick = Tick;
+	mem_copy(pChunk+1, pData, Size);
+
+	// publish the chunk after its data is visible
+	sync_barrier();
+	m_RingWrite = Write+Need;
+	return true;
+}
+
+void CDemoPlayer::DecoderThread(void *pUser)
+{
+	CDemoPlayer *pSelf = (CDemoPlayer *)pUser;
+
+	while(!pSelf->m_DecoderStop)
+	{
+		// a chunk that does not fit at the end of the ring wastes the rest of it
+		unsigned Free = RING_SIZE - (pSelf->m_RingWrite - pSelf->m_RingRead);
+		if(Free < 2*(unsigned)DecodedChunkSize(CSnapshot::MAX_SIZE))
+		{
+			thread_sleep(1);
+			continue;
+		}
+
+		int Tick = 0, Size;
+		const char *pError = "";
+		int Type = pSelf->DecodeChunk(&pSelf->m_DecoderDelta, &Tick, &Size, &pError);
+		if(Type == DECODED_ERROR)
+			pSelf->QueueChunk(Type, Tick, pError, str_length(pError)+1);
+		else
+			pSelf->QueueChunk(Type, Tick, pSelf->m_aDecodeOut, max(Size, 0));
+
+		// the player stops at the end, seeking starts a new decoder
+		if(Type == DECODED_EOF || Type == DECODED_ERROR)
+			break;
+	}
+}
+
+void CDemoPlayer::StartDecoder()
+{
+	if(!m_Threaded)
+		return;
+
+	m_RingRead = 0;
+	m_RingWrite = 0;
+	m_DecoderStop = 0;
+	sync_barrier();
+	m_pDecoderThread = thread_create(DecoderThread, this);
+}
+
+void CDemoPlayer::StopDecoder()
+{
+	if(!m_pDecoderThread)
+		return;
+
+	m_DecoderStop = 1;
+	sync_barrier();
+	thread_wait(m_pDecoderThread);
+	m_pDecoderThread = 0;
+}
+
+int CDemoPlayer::NextChunk(int *pTick, const void **ppData, int *pSize)
+{
+	if(!m_Threaded)
+	{
+		const char *pError = "";
+		int Type = DecodeChunk(m_pSnapshotDelta, pTick, pSize, &pError);
+		*ppData = Type == DECODED_ERROR ? (const void *)pError : (const void *)m_aDecodeOut;
+		return Type;
+	}
+
+	while(1)
+	{
+		unsigned Read = m_RingRead;
+		if(Read == m_RingWrite)
+		{
+			// the decoder always ends with a chunk, so this can't wait forever
+			thread_yield();
+			continue;
+		}
+		sync_barrier();
+
+		unsigned Offset = Read&(RING_SIZE-1);
+		CDecodedChunk *pChunk = (CDecodedChunk *)(m_pRing+Offset);
+		if(pChunk->m_Type == DECODED_WRAP)
+		{
+			m_RingRead = Read+RING_SIZE-Offset;
+			continue;
+		}
+
+		*pTick = pChunk->m_Tick;
+		*pSize = pChunk->m_Size;
+		*ppData = pChunk+1;
+		return pChunk->m_Type;
+	}
+}
+
+void CDemoPlayer::ReleaseChunk()
+{
+	if(!m_Threaded)
+		return;
+
+	// hand the space back to the decoder
+	CDecodedChunk *pChunk = (CDecodedChunk *)(m_pRing+(m_RingRead&(RING_SIZE-1)));
+	unsigned Read = m_RingRead+DecodedChunkSize(pChunk->m_Size);
+	sync_barrier();
+	m_RingRead = Read;
+}
+
 void CDemoPlayer::DoTick()
 {
-	static char aCompresseddata[CSnapshot::MAX_SIZE];
-	static char aDecompressed[CSnapshot::MAX_SIZE];
-	static char aData[CSnapshot::MAX_SIZE];
-	int ChunkType, ChunkTick, ChunkSize;
-	int DataSize = 0;
 	int GotSnapshot = 0;
 
 	// update ticks
 	m_Info.m_PreviousTick = m_Info.m_Info.m_CurrentTick;
 	m_Info.m_Info.m_CurrentTick = m_Info.m_NextTick;
-	ChunkTick = m_Info.m_Info.m_CurrentTick;
 
 	while(1)
 	{
-		if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick))
+		int ChunkTick, DataSize;
+		const void *pData;
+		int ChunkType = NextChunk(&ChunkTick, &pData, &DataSize);
+
+		if(ChunkType == DECODED_EOF)
 		{
-			// stop on error or eof
+			// stop on error or eof, the end stays queued for the next tick
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "end of file");
 			if(m_Info.m_PreviousTick == -1)
 			{
@@ -474,70 +1162,40 @@ void CDemoPlayer::DoTick()
 				Pause();
 			break;
 		}
-
-		// read the chunk
-		if(ChunkSize)
+		else if(ChunkType == DECODED_ERROR)
 		{
-			if(io_read(m_File, aCompresseddata, ChunkSize) != (unsigned)ChunkSize)
-			{
-				// stop on error or eof
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error reading chunk");
-				Stop();
-				break;
-			}
-
-			DataSize = CNetBase::Decompress(aCompresseddata, ChunkSize, aDecompressed, sizeof(aDecompressed));
-			if(DataSize < 0)
-			{
-				// stop on error or eof
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during network decompression");
-				Stop();
-				break;
-			}
-
-			DataSize = CVariableInt::Decompress(aDecompressed, DataSize, aData);
-
-			if(DataSize < 0)
-			{
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "error during intpack decompression");
-				Stop();
-				break;
-			}
+			// stop on error or eof
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", (const char *)pData);
+			Stop();
+			break;
 		}
 
-		if(ChunkType == CHUNKTYPE_DELTA)
+		if(ChunkType == CHUNKTYPE_INDEX)
 		{
-			// process delta snapshot
-			static char aNewsnap[CSnapshot::MAX_SIZE];
-
-			GotSnapshot = 1;
-
-			DataSize = m_pSnapshotDelta->UnpackDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)aNewsnap, aData, DataSize);
-
-			if(DataSize >= 0)
+			// after seeking this is replayed when the first tick has no delta
+			if(DataSize)
 			{
-				if(m_pListner)
-					m_pListner->OnDemoPlayerSnapshot(aNewsnap, DataSize);
-
 				m_LastSnapshotDataSize = DataSize;
-				mem_copy(m_aLastSnapshotData, aNewsnap, DataSize);
-			}
-			else
-			{
-				char aBuf[256];
-				str_format(aBuf, sizeof(aBuf), "error during unpacking of delta, err=%d", DataSize);
-				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", aBuf);
+				mem_copy(m_aLastSnapshotData, pData, DataSize);
 			}
 		}
 		else if(ChunkType == CHUNKTYPE_SNAPSHOT)
 		{
-			// process full snapshot
+			// process full snapshot, deltas are already unpacked
 			GotSnapshot = 1;
 
 			m_LastSnapshotDataSize = DataSize;
-			mem_copy(m_aLastSnapshotData, aData, DataSize);
+			mem_copy(m_aLastSnapshotData, pData, DataSize);
 			if(m_pListner)
-				m_pListner->OnDemoPlayerSnapshot(aData, DataSize);
+				m_pListner->OnDemoPlayerSnapshot(m_aLastSnapshotData, DataSize);
+		}
+		else if(ChunkType == DECODED_BADDELTA)
+		{
+			GotSnapshot = 1;
+
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "error during unpacking of delta, err=%d", DataSize);
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", aBuf);
 		}
 		else
 		{
@@ -552,14 +1210,17 @@ void CDemoPlayer::DoTick()
 			if(ChunkType&CHUNKTYPEFLAG_TICKMARKER)
 			{
 				m_Info.m_NextTick = ChunkTick;
+				ReleaseChunk();
 				break;
 			}
 			else if(ChunkType == CHUNKTYPE_MESSAGE)
 			{
 				if(m_pListner)
-					m_pListner->OnDemoPlayerMessage(aData, DataSize);
+					m_pListner->OnDemoPlayerMessage((void *)pData, DataSize);
 			}
 		}
+
+		ReleaseChunk();
 	}
 }
 
@@ -680,8 +1341,20 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// scan the file for interessting points
-	ScanFile();
+	// use the index of the demo, older demos are scanned for interessting points
+	if(!ReadIndex())
+		ScanFile();
+
+	// start decoding
+	m_DecodeTick = -1;
+	m_DecodeAtSeekPoint = false;
+	mem_zero(m_aDecodeSnapshot, sizeof(m_aDecodeSnapshot));
+	if(m_Threaded)
+	{
+		m_DecoderDelta = *m_pSnapshotDelta;
+		m_pRing = (unsigned char *)mem_alloc(RING_SIZE, 8);
+		StartDecoder();
+	}
 
 	// ready for playback
 	return 0;
@@ -730,16 +1403,23 @@ int CDemoPlayer::SetPos(float Percent)
 	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
 		Keyframe--;
 
-	// seek to the correct keyframe
-	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
-
-	//m_Info.start_tick = -1;
-	m_Info.m_NextTick = -1;
-	m_Info.m_Info.m_CurrentTick = -1;
-	m_Info.m_PreviousTick = -1;
+	// short jumps forward keep playing from the current position and what is decoded already
+	if(m_pKeyFrames[Keyframe].m_Tick > m_Info.m_Info.m_CurrentTick || WantedTick <= m_Info.m_Info.m_CurrentTick)
+	{
+		// seek to the correct keyframe, the decoder restarts from there
+		StopDecoder();
+		io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
+		m_DecodeAtSeekPoint = true;
+		StartDecoder();
+
+		//m_Info.start_tick = -1;
+		m_Info.m_NextTick = -1;
+		m_Info.m_Info.m_CurrentTick = -1;
+		m_Info.m_PreviousTick = -1;
+	}
 
 	// playback everything until we hit our tick
-	while(m_Info.m_PreviousTick < WantedTick)
+	while(m_Info.m_PreviousTick < WantedTick && IsPlaying())
 		DoTick();
 
 	Play();
@@ -757,7 +1437,11 @@ int CDemoPlayer::Update()
 	int64 Now = time_get();
 	int64 Deltatime = Now-m_Info.m_LastUpdate;
 	m_Info.m_LastUpdate = Now;
+	return Update(Deltatime);
+}
 
+int CDemoPlayer::Update(int64 Deltatime)
+{
 	if(!IsPlaying())
 		return 0;
 
@@ -812,6 +1496,9 @@ int CDemoPlayer::Stop()
 		return -1;
 
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_player", "Stopped playback");
+	StopDecoder();
+	mem_free(m_pRing);
+	m_pRing = 0;
 	io_close(m_File);
 	m_File = 0;
 	mem_free(m_pKeyFrames);
@@ -16,14 +16,69 @@ class CDemoRecorder : public IDemoRecorder
 	int m_LastKeyFrame;
 	int m_FirstTick;
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+	int m_LastSnapshotSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
-	void WriteTickMarker(int Tick, int Keyframe);
+	// seek points are positions the player can start decoding at, they are listed
+	// in an index at the end of the demo so loading it doesn't have to scan the file
+	enum
+	{
+		SEEKPOINT_BLOCK_SIZE=1024,
+		MAX_SEEKPOINT_BLOCKS=256,
+	};
+
+	struct CSeekPoint
+	{
+		int m_Tick;
+		int m_Filepos;
+	};
+
+	CSeekPoint *m_apSeekPoints[MAX_SEEKPOINT_BLOCKS];
+	int m_NumSeekPoints;
+	int m_LastSeekPoint;
+
+	bool AddSeekPoint(int Tick);
+	void WriteIndex();
+
+	// threaded recording: chunks are queued in a single producer/consumer ring and
+	// compressed and written by a background thread in large sequential blocks
+	enum
+	{
+		RING_SIZE=2*1024*1024,
+		WRITE_BUFFER_SIZE=256*1024,
+		FLUSH_SIZE=64*1024,
+	};
+
+	bool m_Threaded;
+	void *m_pWriterThread;
+	IOHANDLE m_MapFile;
+	unsigned char *m_pRing;
+	volatile unsigned m_RingRead;
+	volatile unsigned m_RingWrite;
+	volatile unsigned m_WriterStop;
+	volatile unsigned m_ProducerWaiting; // set while a chunk waits for ring space
+#if !defined(CONF_PLATFORM_MACOSX)
+	SEMAPHORE m_SpaceFreed;
+#endif
+	unsigned char *m_pWriteBuffer;
+	int m_WriteBufferSize;
+	int m_NumDropped; // skipped snapshots
+	int m_NumStalls; // chunks that had to wait for the writer
+
+	static void WriterThread(void *pUser);
+	bool RingReserve(int Size) const;
+	bool QueueChunk(int Type, const void *pData, int Size);
+	void QueueChunkWait(int Type, const void *pData, int Size);
+	int ProcessRing();
+	void FlushWriteBuffer();
+
+	void WriteRaw(const void *pData, int Size);
+	void WriteTickMarker(int Tick, int Keyframe, bool Full = false);
 	void Write(int Type, const void *pData, int Size);
 public:
-	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta);
+	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool Threaded = false);
 
 	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType);
 	int Stop();
@@ -95,14 +150,48 @@ private:
 	int m_LastSnapshotDataSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
 
+	// chunks are decoded into full snapshots and messages before playback uses them
+	// the buffers are read as ints and snapshots, so they are int arrays
+	int m_DecodeTick;
+	bool m_DecodeAtSeekPoint;
+	int m_aDecodeSnapshot[CSnapshot::MAX_SIZE/sizeof(int)];
+	int m_aDecodeCompressed[CSnapshot::MAX_SIZE/sizeof(int)];
+	int m_aDecodeDecompressed[CSnapshot::MAX_SIZE/sizeof(int)];
+	int m_aDecodeData[CSnapshot::MAX_SIZE/sizeof(int)];
+	int m_aDecodeOut[CSnapshot::MAX_SIZE/sizeof(int)];
+
+	// threaded playback: a decoder thread reads ahead into a single producer/consumer
+	// ring of decoded chunks, the player only copies snapshots out of it
+	enum
+	{
+		RING_SIZE=4*1024*1024,
+	};
+
+	bool m_Threaded;
+	void *m_pDecoderThread;
+	CSnapshotDelta m_DecoderDelta; // the decoder's own copy, the shared one keeps statistics
+	unsigned char *m_pRing;
+	volatile unsigned m_RingRead;
+	volatile unsigned m_RingWrite;
+	volatile unsigned m_DecoderStop;
+
+	static void DecoderThread(void *pUser);
+	void StartDecoder();
+	void StopDecoder();
+	bool QueueChunk(int Type, int Tick, const void *pData, int Size);
+
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
+	int ReadChunkData(int ChunkSize, const char **ppError);
+	int DecodeChunk(CSnapshotDelta *pDelta, int *pTick, int *pSize, const char **ppError);
+	int NextChunk(int *pTick, const void **ppData, int *pSize);
+	void ReleaseChunk();
 	void DoTick();
 	void ScanFile();
-	int NextFrame();
+	bool ReadIndex();
 
 public:
 
-	CDemoPlayer(class CSnapshotDelta *m_pSnapshotDelta);
+	CDemoPlayer(class CSnapshotDelta *m_pSnapshotDelta, bool Threaded = false);
 
 	void SetListner(IListner *pListner);
 
@@ -119,6 +208,8 @@ public:
 	int GetDemoType() const;
 
 	int Update();
+	int Update(int64 Deltatime); // advances by a fixed time instead of the clock, for benchmarks
+	int NextFrame(); // plays the next tick right away, for tools without a clock
 
 	const CPlaybackInfo *Info() const { return &m_Info; }
 	int IsPlaying() const { return m_File != 0; }
@@ -98,6 +98,10 @@ public:
 		// open logfile if needed
 		if(g_Config.m_Logfile[0])
 			dbg_logger_file(g_Config.m_Logfile);
+
+		dbg_logger_format(g_Config.m_LogFormat);
+		if(g_Config.m_LogThreaded)
+			dbg_enable_threaded();
 	}
 
 	void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype)
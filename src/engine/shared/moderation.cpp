@@ -0,0 +1,480 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdio.h> // sscanf
+
+#include <base/math.h>
+
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
+#include <engine/shared/protocol.h>
+
+#include "moderation.h"
+
+
+static const char *s_apTypeNames[CModeration::NUM_TYPES] = { "mute", "voteban" };
+
+CModeration::CModeration()
+{
+	m_pConsole = 0;
+	m_pStorage = 0;
+	m_ppBuckets = 0;
+	m_NumBuckets = 0;
+	m_NumRecords = 0;
+	m_pFirst = 0;
+	m_pLast = 0;
+	m_aFilename[0] = 0;
+	m_Dirty = false;
+	m_LastSave = 0;
+	Reset();
+}
+
+CModeration::~CModeration()
+{
+	Reset();
+	if(m_ppBuckets)
+		mem_free(m_ppBuckets);
+}
+
+void CModeration::Init(IConsole *pConsole, IStorage *pStorage)
+{
+	m_pConsole = pConsole;
+	m_pStorage = pStorage;
+	Reset();
+
+	m_pConsole->Register("moderation_save", "", CFGFLAG_SERVER, ConModerationSave, this, "Write mutes and votebans to sv_moderation_file");
+}
+
+void CModeration::Reset()
+{
+	while(m_pFirst)
+	{
+		CRecord *pNext = m_pFirst->m_pNext;
+		delete m_pFirst;
+		m_pFirst = pNext;
+	}
+	m_pLast = 0;
+	m_NumRecords = 0;
+	mem_zero(m_apWheel, sizeof(m_apWheel));
+	m_WheelTime = time_timestamp();
+
+	if(m_ppBuckets)
+		mem_free(m_ppBuckets);
+	m_NumBuckets = 64;
+	m_ppBuckets = (CRecord **)mem_alloc(m_NumBuckets*sizeof(CRecord *), 1);
+	mem_zero(m_ppBuckets, m_NumBuckets*sizeof(CRecord *));
+}
+
+unsigned CModeration::Hash(const NETADDR *pAddr)
+{
+	// fnv-1a over type and address, keys have the port zeroed
+	const unsigned char *pData = (const unsigned char *)pAddr;
+	unsigned h = 2166136261u;
+	for(int i = 0; i < (int)(sizeof(pAddr->type)+sizeof(pAddr->ip)); i++)
+		h = (h^pData[i])*16777619u;
+	return h;
+}
+
+void CModeration::MakeKey(NETADDR *pKey, const NETADDR *pAddr)
+{
+	mem_zero(pKey, sizeof(*pKey));
+	pKey->type = pAddr->type;
+	mem_copy(pKey->ip, pAddr->ip, pAddr->type == NETTYPE_IPV4 ? 4 : 16);
+}
+
+void CModeration::Grow()
+{
+	int NumBuckets = m_NumBuckets*2;
+	CRecord **ppBuckets = (CRecord **)mem_alloc(NumBuckets*sizeof(CRecord *), 1);
+	mem_zero(ppBuckets, NumBuckets*sizeof(CRecord *));
+	for(CRecord *pRecord = m_pFirst; pRecord; pRecord = pRecord->m_pNext)
+	{
+		unsigned h = Hash(&pRecord->m_Addr)&(NumBuckets-1);
+		pRecord->m_pHashNext = ppBuckets[h];
+		ppBuckets[h] = pRecord;
+	}
+	mem_free(m_ppBuckets);
+	m_ppBuckets = ppBuckets;
+	m_NumBuckets = NumBuckets;
+}
+
+CModeration::CRecord *CModeration::Find(const NETADDR *pAddr) const
+{
+	if(!pAddr)
+		return 0;
+
+	NETADDR Key;
+	MakeKey(&Key, pAddr);
+	for(CRecord *pRecord = m_ppBuckets[Hash(&Key)&(m_NumBuckets-1)]; pRecord; pRecord = pRecord->m_pHashNext)
+	{
+		if(mem_comp(&pRecord->m_Addr, &Key, sizeof(Key)) == 0)
+			return pRecord;
+	}
+	return 0;
+}
+
+CModeration::CRecord *CModeration::FindOrAdd(const NETADDR *pAddr)
+{
+	CRecord *pRecord = Find(pAddr);
+	if(pRecord)
+		return pRecord;
+
+	if(m_NumRecords >= m_NumBuckets)
+		Grow();
+
+	pRecord = new CRecord;
+	mem_zero(pRecord, sizeof(*pRecord));
+	MakeKey(&pRecord->m_Addr, pAddr);
+
+	unsigned h = Hash(&pRecord->m_Addr)&(m_NumBuckets-1);
+	pRecord->m_pHashNext = m_ppBuckets[h];
+	m_ppBuckets[h] = pRecord;
+
+	pRecord->m_pPrev = m_pLast;
+	if(m_pLast)
+		m_pLast->m_pNext = pRecord;
+	else
+		m_pFirst = pRecord;
+	m_pLast = pRecord;
+	m_NumRecords++;
+	return pRecord;
+}
+
+void CModeration::Delete(CRecord *pRecord)
+{
+	WheelRemove(pRecord);
+
+	CRecord **ppLink = &m_ppBuckets[Hash(&pRecord->m_Addr)&(m_NumBuckets-1)];
+	while(*ppLink != pRecord)
+		ppLink = &(*ppLink)->m_pHashNext;
+	*ppLink = pRecord->m_pHashNext;
+
+	if(pRecord->m_pPrev)
+		pRecord->m_pPrev->m_pNext = pRecord->m_pNext;
+	else
+		m_pFirst = pRecord->m_pNext;
+	if(pRecord->m_pNext)
+		pRecord->m_pNext->m_pPrev = pRecord->m_pPrev;
+	else
+		m_pLast = pRecord->m_pPrev;
+
+	m_NumRecords--;
+	delete pRecord;
+}
+
+void CModeration::DecayChat(CRecord *pRecord, int64 Now)
+{
+	if(pRecord->m_ChatTicks <= 0)
+	{
+		pRecord->m_ChatTicks = 0;
+		pRecord->m_ChatTime = Now;
+		return;
+	}
+
+	int64 Ticks = (Now-pRecord->m_ChatTime)*SERVER_TICK_SPEED/time_freq();
+	if(Ticks >= pRecord->m_ChatTicks)
+	{
+		pRecord->m_ChatTicks = 0;
+		pRecord->m_ChatTime = Now;
+	}
+	else if(Ticks > 0)
+	{
+		pRecord->m_ChatTicks -= (int)Ticks;
+		pRecord->m_ChatTime += Ticks*time_freq()/SERVER_TICK_SPEED;
+	}
+}
+
+int CModeration::NextExpiry(const CRecord *pRecord) const
+{
+	int Next = 0;
+	for(int i = 0; i < NUM_TYPES; i++)
+	{
+		if(pRecord->m_aExpires[i] && (!Next || pRecord->m_aExpires[i] < Next))
+			Next = pRecord->m_aExpires[i];
+	}
+	if(pRecord->m_ChatTicks > 0)
+	{
+		int ChatExpires = time_timestamp()+pRecord->m_ChatTicks/SERVER_TICK_SPEED+1;
+		if(!Next || ChatExpires < Next)
+			Next = ChatExpires;
+	}
+	return Next;
+}
+
+void CModeration::WheelInsert(CRecord *pRecord, int Time)
+{
+	CRecord **ppSlot = &m_apWheel[Time&(WHEEL_SIZE-1)];
+	pRecord->m_WheelTime = Time;
+	pRecord->m_pWheelPrev = 0;
+	pRecord->m_pWheelNext = *ppSlot;
+	if(*ppSlot)
+		(*ppSlot)->m_pWheelPrev = pRecord;
+	*ppSlot = pRecord;
+}
+
+void CModeration::WheelRemove(CRecord *pRecord)
+{
+	if(!pRecord->m_WheelTime)
+		return;
+
+	if(pRecord->m_pWheelPrev)
+		pRecord->m_pWheelPrev->m_pWheelNext = pRecord->m_pWheelNext;
+	else
+		m_apWheel[pRecord->m_WheelTime&(WHEEL_SIZE-1)] = pRecord->m_pWheelNext;
+	if(pRecord->m_pWheelNext)
+		pRecord->m_pWheelNext->m_pWheelPrev = pRecord->m_pWheelPrev;
+	pRecord->m_pWheelNext = 0;
+	pRecord->m_pWheelPrev = 0;
+	pRecord->m_WheelTime = 0;
+}
+
+void CModeration::Schedule(CRecord *pRecord)
+{
+	int Next = NextExpiry(pRecord);
+	if(!Next)
+	{
+		Delete(pRecord);
+		return;
+	}
+
+	// only move records forward in time, a late wakeup just reschedules
+	if(pRecord->m_WheelTime && pRecord->m_WheelTime <= Next)
+		return;
+	WheelRemove(pRecord);
+	WheelInsert(pRecord, max(Next, m_WheelTime+1));
+}
+
+void CModeration::Expire(CRecord *pRecord, int Now)
+{
+	for(int i = 0; i < NUM_TYPES; i++)
+	{
+		if(pRecord->m_aExpires[i] && pRecord->m_aExpires[i] <= Now)
+		{
+			pRecord->m_aExpires[i] = 0;
+			m_Dirty = true;
+		}
+	}
+	DecayChat(pRecord, time_get());
+}
+
+void CModeration::Update()
+{
+	int Now = time_timestamp();
+
+	// after a long stall every slot has to be visited once
+	int Steps = min(Now-m_WheelTime, (int)WHEEL_SIZE);
+	for(int s = 0; s < Steps; s++)
+	{
+		m_WheelTime++;
+		CRecord *pRecord = m_apWheel[m_WheelTime&(WHEEL_SIZE-1)];
+		m_apWheel[m_WheelTime&(WHEEL_SIZE-1)] = 0;
+
+		while(pRecord)
+		{
+			CRecord *pNext = pRecord->m_pWheelNext;
+			int Time = pRecord->m_WheelTime;
+			pRecord->m_pWheelNext = 0;
+			pRecord->m_pWheelPrev = 0;
+			pRecord->m_WheelTime = 0;
+
+			if(Time > Now)
+				WheelInsert(pRecord, Time); // a later round of the wheel
+			else
+			{
+				Expire(pRecord, Now);
+				Schedule(pRecord);
+			}
+			pRecord = pNext;
+		}
+	}
+	m_WheelTime = Now;
+
+	if(m_Dirty && m_aFilename[0] && Now-m_LastSave >= SAVE_INTERVAL)
+		Save();
+}
+
+void CModeration::Set(const NETADDR *pAddr, int Type, int Seconds)
+{
+	if(!pAddr || Type < 0 || Type >= NUM_TYPES)
+		return;
+
+	if(Seconds <= 0)
+	{
+		CRecord *pRecord = Find(pAddr);
+		if(pRecord && pRecord->m_aExpires[Type])
+		{
+			pRecord->m_aExpires[Type] = 0;
+			m_Dirty = true;
+			if(!NextExpiry(pRecord))
+				Delete(pRecord);
+		}
+		return;
+	}
+
+	CRecord *pRecord = FindOrAdd(pAddr);
+	pRecord->m_aExpires[Type] = time_timestamp()+Seconds;
+	m_Dirty = true;
+	Schedule(pRecord);
+}
+
+int CModeration::Remaining(const CRecord *pRecord, int Type) const
+{
+	if(!pRecord || !pRecord->m_aExpires[Type])
+		return 0;
+	return max(pRecord->m_aExpires[Type]-time_timestamp(), 0);
+}
+
+int CModeration::Remaining(const NETADDR *pAddr, int Type) const
+{
+	return Remaining(Find(pAddr), Type);
+}
+
+int CModeration::AddChatTicks(const NETADDR *pAddr, int Ticks)
+{
+	if(!pAddr)
+		return 0;
+
+	CRecord *pRecord = FindOrAdd(pAddr);
+	DecayChat(pRecord, time_get());
+	pRecord->m_ChatTicks += Ticks;
+	int Result = pRecord->m_ChatTicks;
+	Schedule(pRecord);
+	return Result;
+}
+
+void CModeration::ResetChatTicks(const NETADDR *pAddr)
+{
+	CRecord *pRecord = Find(pAddr);
+	if(pRecord)
+	{
+		pRecord->m_ChatTicks = 0;
+		if(!NextExpiry(pRecord))
+			Delete(pRecord);
+	}
+}
+
+const CModeration::CRecord *CModeration::Seek(const CRecord *pRecord, int Type) const
+{
+	for(; pRecord; pRecord = pRecord->m_pNext)
+	{
+		if(Remaining(pRecord, Type) > 0)
+			return pRecord;
+	}
+	return 0;
+}
+
+const CModeration::CRecord *CModeration::First(int Type) const
+{
+	return Seek(m_pFirst, Type);
+}
+
+const CModeration::CRecord *CModeration::Next(const CRecord *pRecord, int Type) const
+{
+	return pRecord ? Seek(pRecord->m_pNext, Type) : 0;
+}
+
+const CModeration::CRecord *CModeration::Get(int Type, int Index) const
+{
+	const CRecord *pRecord = First(Type);
+	for(int i = 0; pRecord && i < Index; i++)
+		pRecord = Next(pRecord, Type);
+	return Index >= 0 ? pRecord : 0;
+}
+
+void CModeration::SetFile(const char *pFilename)
+{
+	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
+}
+
+bool CModeration::Load()
+{
+	if(!m_aFilename[0] || !m_pStorage)
+		return false;
+
+	IOHANDLE File = m_pStorage->OpenFile(m_aFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+
+	CLineReader LineReader;
+	LineReader.Init(File);
+	int Now = time_timestamp();
+	int NumLoaded = 0;
+	while(char *pLine = LineReader.Get())
+	{
+		// <type> <address> <expires>
+		char aType[16], aAddr[NETADDR_MAXSTRSIZE];
+		int Expires;
+		if(sscanf(pLine, "%15s %47s %d", aType, aAddr, &Expires) != 3 || Expires <= Now)
+			continue;
+
+		NETADDR Addr;
+		if(net_addr_from_str(&Addr, aAddr) != 0)
+			continue;
+
+		for(int i = 0; i < NUM_TYPES; i++)
+		{
+			if(str_comp(aType, s_apTypeNames[i]) == 0)
+			{
+				CRecord *pRecord = FindOrAdd(&Addr);
+				pRecord->m_aExpires[i] = Expires;
+				Schedule(pRecord);
+				NumLoaded++;
+			}
+		}
+	}
+	io_close(File);
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "loaded %d entries from '%s'", NumLoaded, m_aFilename);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "moderation", aBuf);
+	m_LastSave = Now;
+	return true;
+}
+
+bool CModeration::Save()
+{
+	if(!m_aFilename[0] || !m_pStorage)
+		return false;
+
+	m_Dirty = false;
+	m_LastSave = time_timestamp();
+
+	IOHANDLE File = m_pStorage->OpenFile(m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "failed to save to '%s'", m_aFilename);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "moderation", aBuf);
+		return false;
+	}
+
+	char aAddrStr[NETADDR_MAXSTRSIZE], aBuf[128];
+	for(const CRecord *pRecord = m_pFirst; pRecord; pRecord = pRecord->m_pNext)
+	{
+		for(int i = 0; i < NUM_TYPES; i++)
+		{
+			if(Remaining(pRecord, i) <= 0)
+				continue;
+			net_addr_str(&pRecord->m_Addr, aAddrStr, sizeof(aAddrStr), false);
+			str_format(aBuf, sizeof(aBuf), "%s %s %d", s_apTypeNames[i], aAddrStr, pRecord->m_aExpires[i]);
+			io_write(File, aBuf, str_length(aBuf));
+			io_write_newline(File);
+		}
+	}
+	io_close(File);
+	return true;
+}
+
+void CModeration::ConModerationSave(IConsole::IResult *pResult, void *pUser)
+{
+	CModeration *pThis = static_cast<CModeration *>(pUser);
+	if(!pThis->m_aFilename[0])
+		pThis->m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "moderation", "sv_moderation_file is not set");
+	else if(pThis->Save())
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "saved to '%s'", pThis->m_aFilename);
+		pThis->m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "moderation", aBuf);
+	}
+}
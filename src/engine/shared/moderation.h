@@ -0,0 +1,109 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_MODERATION_H
+#define ENGINE_SHARED_MODERATION_H
+
+#include <base/system.h>
+
+/*
+	per address moderation state (mutes, votebans and the chat spam score),
+	kept independent of client slots and maps. records are hashed by the
+	binary address and expire through a timer wheel with one second slots
+*/
+class CModeration
+{
+public:
+	enum
+	{
+		TYPE_MUTE=0,
+		TYPE_VOTEBAN,
+		NUM_TYPES,
+	};
+
+	struct CRecord
+	{
+		NETADDR m_Addr; // port is always 0
+		int m_aExpires[NUM_TYPES]; // unix time, 0 if not set
+
+		// chat spam score in ticks, decays by one each tick
+		int m_ChatTicks;
+		int64 m_ChatTime;
+
+		CRecord *m_pNext; // all records in insertion order
+		CRecord *m_pPrev;
+		CRecord *m_pHashNext;
+		CRecord *m_pWheelNext;
+		CRecord *m_pWheelPrev;
+		int m_WheelTime; // second the record is scheduled for, 0 if not scheduled
+	};
+
+private:
+	enum
+	{
+		WHEEL_SIZE=256, // must be a power of two
+		SAVE_INTERVAL=10,
+	};
+
+	class IConsole *m_pConsole;
+	class IStorage *m_pStorage;
+
+	CRecord **m_ppBuckets;
+	int m_NumBuckets;
+	int m_NumRecords;
+	CRecord *m_pFirst;
+	CRecord *m_pLast;
+
+	CRecord *m_apWheel[WHEEL_SIZE];
+	int m_WheelTime;
+
+	char m_aFilename[128];
+	bool m_Dirty;
+	int m_LastSave;
+
+	static unsigned Hash(const NETADDR *pAddr);
+	static void MakeKey(NETADDR *pKey, const NETADDR *pAddr);
+	void Grow();
+
+	CRecord *Find(const NETADDR *pAddr) const;
+	CRecord *FindOrAdd(const NETADDR *pAddr);
+	void Delete(CRecord *pRecord);
+
+	void DecayChat(CRecord *pRecord, int64 Now);
+	int NextExpiry(const CRecord *pRecord) const;
+	void WheelInsert(CRecord *pRecord, int Time);
+	void WheelRemove(CRecord *pRecord);
+	void Schedule(CRecord *pRecord);
+	void Expire(CRecord *pRecord, int Now);
+	const CRecord *Seek(const CRecord *pRecord, int Type) const;
+
+	static void ConModerationSave(class IConsole::IResult *pResult, void *pUser);
+
+public:
+	CModeration();
+	~CModeration();
+
+	void Init(class IConsole *pConsole, class IStorage *pStorage);
+	void Reset();
+	void Update();
+
+	// seconds <= 0 removes the entry
+	void Set(const NETADDR *pAddr, int Type, int Seconds);
+	int Remaining(const NETADDR *pAddr, int Type) const;
+	int Remaining(const CRecord *pRecord, int Type) const;
+
+	// adds to the chat spam score and returns the new score
+	int AddChatTicks(const NETADDR *pAddr, int Ticks);
+	void ResetChatTicks(const NETADDR *pAddr);
+
+	// records with an entry of the given type in insertion order
+	const CRecord *First(int Type) const;
+	const CRecord *Next(const CRecord *pRecord, int Type) const;
+	const CRecord *Get(int Type, int Index) const;
+
+	// optional persistence of mutes and votebans
+	void SetFile(const char *pFilename);
+	bool Load();
+	bool Save();
+};
+
+#endif
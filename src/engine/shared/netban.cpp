@@ -3,6 +3,7 @@
 #include <engine/console.h>
 #include <engine/storage.h>
 #include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
 
 #include "netban.h"
 
@@ -19,134 +20,485 @@ bool CNetBan::StrAllnum(const char *pStr)
 }
 
 
-CNetBan::CNetHash::CNetHash(const NETADDR *pAddr)
+CNetBan::CAddrHash::CAddrHash()
 {
-	if(pAddr->type==NETTYPE_IPV4)
-		m_Hash = (pAddr->ip[0]+pAddr->ip[1]+pAddr->ip[2]+pAddr->ip[3])&0xFF;
-	else
-		m_Hash = (pAddr->ip[0]+pAddr->ip[1]+pAddr->ip[2]+pAddr->ip[3]+pAddr->ip[4]+pAddr->ip[5]+pAddr->ip[6]+pAddr->ip[7]+
-			pAddr->ip[8]+pAddr->ip[9]+pAddr->ip[10]+pAddr->ip[11]+pAddr->ip[12]+pAddr->ip[13]+pAddr->ip[14]+pAddr->ip[15])&0xFF;
-	m_HashIndex = 0;
+	m_ppBuckets = 0;
+	m_NumBuckets = 0;
+	m_Num = 0;
 }
 
-CNetBan::CNetHash::CNetHash(const CNetRange *pRange)
+CNetBan::CAddrHash::~CAddrHash()
 {
-	m_Hash = 0;
-	m_HashIndex = 0;
-	for(int i = 0; pRange->m_LB.ip[i] == pRange->m_UB.ip[i]; ++i)
-	{
-		m_Hash += pRange->m_LB.ip[i];
-		++m_HashIndex;
-	}
-	m_Hash &= 0xFF;
+	if(m_ppBuckets)
+		mem_free(m_ppBuckets);
+}
+
+unsigned CNetBan::CAddrHash::Hash(const NETADDR *pAddr)
+{
+	// fnv-1a over the bytes NetComp compares
+	const unsigned char *pData = (const unsigned char *)pAddr;
+	int Size = pAddr->type==NETTYPE_IPV4 ? 8 : 20;
+	unsigned h = 2166136261u;
+	for(int i = 0; i < Size; i++)
+		h = (h^pData[i])*16777619u;
+	return h;
+}
+
+void CNetBan::CAddrHash::Reset()
+{
+	if(m_ppBuckets)
+		mem_free(m_ppBuckets);
+	m_NumBuckets = 256;
+	m_ppBuckets = (CBanAddr **)mem_alloc(m_NumBuckets*sizeof(CBanAddr *), 1);
+	mem_zero(m_ppBuckets, m_NumBuckets*sizeof(CBanAddr *));
+	m_Num = 0;
 }
 
-int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
+void CNetBan::CAddrHash::Grow()
 {
-	int Length = pAddr->type==NETTYPE_IPV4 ? 4 : 16;
-	aHash[0].m_Hash = 0;
-	aHash[0].m_HashIndex = 0;
-	for(int i = 1, Sum = 0; i <= Length; ++i)
+	int NumBuckets = m_NumBuckets*2;
+	CBanAddr **ppBuckets = (CBanAddr **)mem_alloc(NumBuckets*sizeof(CBanAddr *), 1);
+	mem_zero(ppBuckets, NumBuckets*sizeof(CBanAddr *));
+	for(int i = 0; i < m_NumBuckets; i++)
 	{
-		Sum += pAddr->ip[i-1];
-		aHash[i].m_Hash = Sum&0xFF;
-		aHash[i].m_HashIndex = i%Length;
+		CBanAddr *pNext;
+		for(CBanAddr *pBan = m_ppBuckets[i]; pBan; pBan = pNext)
+		{
+			pNext = pBan->m_pHashNext;
+			unsigned h = Hash(&pBan->m_Data)&(NumBuckets-1);
+			pBan->m_pHashNext = ppBuckets[h];
+			ppBuckets[h] = pBan;
+		}
 	}
-	return Length;
+	mem_free(m_ppBuckets);
+	m_ppBuckets = ppBuckets;
+	m_NumBuckets = NumBuckets;
 }
 
+void CNetBan::CAddrHash::Insert(CBanAddr *pBan)
+{
+	if(m_Num >= m_NumBuckets)
+		Grow();
+
+	unsigned h = Hash(&pBan->m_Data)&(m_NumBuckets-1);
+	pBan->m_pHashNext = m_ppBuckets[h];
+	m_ppBuckets[h] = pBan;
+	m_Num++;
+}
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData, const CBanInfo *pInfo,  const CNetHash *pNetHash)
+void CNetBan::CAddrHash::Remove(CBanAddr *pBan)
 {
-	if(!m_pFirstFree)
-		return 0;
+	CBanAddr **ppLink = &m_ppBuckets[Hash(&pBan->m_Data)&(m_NumBuckets-1)];
+	while(*ppLink != pBan)
+		ppLink = &(*ppLink)->m_pHashNext;
+	*ppLink = pBan->m_pHashNext;
+	pBan->m_pHashNext = 0;
+	m_Num--;
+}
+
+CNetBan::CBanAddr *CNetBan::CAddrHash::Find(const NETADDR *pAddr) const
+{
+	for(CBanAddr *pBan = m_ppBuckets[Hash(pAddr)&(m_NumBuckets-1)]; pBan; pBan = pBan->m_pHashNext)
+	{
+		if(NetComp(&pBan->m_Data, pAddr) == 0)
+			return pBan;
+	}
+	return 0;
+}
 
-	// create new ban
-	CBan<T> *pBan = m_pFirstFree;
-	pBan->m_Data = *pData;
-	pBan->m_Info = *pInfo;
-	pBan->m_NetHash = *pNetHash;
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstFree = pBan->m_pNext;
 
-	// add it to the hash list
-	if(m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash])
-		m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]->m_pHashPrev = pBan;
-	pBan->m_pHashPrev = 0;
-	pBan->m_pHashNext = m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash];
-	m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash] = pBan;
+static inline int PrefixBit(const unsigned char *pPrefix, int Bit)
+{
+	return (pPrefix[Bit>>3]>>(7-(Bit&7)))&1;
+}
 
-	// insert it into the used list
-	if(m_pFirstUsed)
+// number of leading bits that match, at most MaxBits
+static int PrefixCommon(const unsigned char *pPrefix1, const unsigned char *pPrefix2, int MaxBits)
+{
+	int Bits = 0;
+	for(int i = 0; Bits < MaxBits; i++, Bits += 8)
 	{
-		for(CBan<T> *p = m_pFirstUsed; ; p = p->m_pNext)
+		unsigned char Diff = pPrefix1[i]^pPrefix2[i];
+		if(Diff)
 		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pInfo->m_Expires != CBanInfo::EXPIRES_NEVER && pInfo->m_Expires <= p->m_Info.m_Expires))
+			while(!(Diff&0x80))
 			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
+				Diff <<= 1;
+				Bits++;
 			}
+			break;
+		}
+	}
+	return min(Bits, MaxBits);
+}
+
+static void PrefixMask(unsigned char *pPrefix, int Length)
+{
+	for(int i = Length; i < 128; i++)
+		pPrefix[i>>3] &= ~(0x80>>(i&7));
+}
+
+CNetBan::CRangeTrie::CRangeTrie()
+{
+	m_apRoot[0] = m_apRoot[1] = 0;
+}
+
+CNetBan::CRangeTrie::~CRangeTrie()
+{
+	Reset();
+}
+
+void CNetBan::CRangeTrie::FreeNodes(CTrieNode *pNode)
+{
+	if(!pNode)
+		return;
+	FreeNodes(pNode->m_apChild[0]);
+	FreeNodes(pNode->m_apChild[1]);
+	CTrieRef *pNext;
+	for(CTrieRef *pRef = pNode->m_pRefs; pRef; pRef = pNext)
+	{
+		pNext = pRef->m_pNodeNext;
+		mem_free(pRef);
+	}
+	mem_free(pNode);
+}
+
+void CNetBan::CRangeTrie::Reset()
+{
+	for(int i = 0; i < 2; i++)
+	{
+		FreeNodes(m_apRoot[i]);
+		m_apRoot[i] = 0;
+	}
+}
+
+CNetBan::CTrieNode **CNetBan::CRangeTrie::Link(CTrieNode *pNode)
+{
+	if(!pNode->m_pParent)
+		return m_apRoot[0] == pNode ? &m_apRoot[0] : &m_apRoot[1];
+	return &pNode->m_pParent->m_apChild[PrefixBit(pNode->m_aPrefix, pNode->m_pParent->m_Length)];
+}
 
-			if(!p->m_pNext)
+CNetBan::CTrieNode *CNetBan::CRangeTrie::Insert(unsigned Type, const unsigned char *pPrefix, int Length)
+{
+	CTrieNode **ppLink = Root(Type);
+	CTrieNode *pParent = 0;
+	while(1)
+	{
+		CTrieNode *pNode = *ppLink;
+		if(!pNode || PrefixCommon(pNode->m_aPrefix, pPrefix, min(pNode->m_Length, Length)) < min(pNode->m_Length, Length) || pNode->m_Length > Length)
+		{
+			// new node, possibly above or next to the node in its place
+			CTrieNode *pNew = (CTrieNode *)mem_alloc(sizeof(CTrieNode), 1);
+			mem_zero(pNew, sizeof(CTrieNode));
+			mem_copy(pNew->m_aPrefix, pPrefix, sizeof(pNew->m_aPrefix));
+			pNew->m_Length = Length;
+			pNew->m_pParent = pParent;
+			*ppLink = pNew;
+			if(!pNode)
+				return pNew;
+
+			int Common = PrefixCommon(pNode->m_aPrefix, pPrefix, min(pNode->m_Length, Length));
+			if(Common == Length)
 			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
+				// the old node is below the new one
+				pNew->m_apChild[PrefixBit(pNode->m_aPrefix, Length)] = pNode;
+				pNode->m_pParent = pNew;
+				return pNew;
 			}
+
+			// both hang below a new branch
+			CTrieNode *pBranch = (CTrieNode *)mem_alloc(sizeof(CTrieNode), 1);
+			mem_zero(pBranch, sizeof(CTrieNode));
+			mem_copy(pBranch->m_aPrefix, pPrefix, sizeof(pBranch->m_aPrefix));
+			PrefixMask(pBranch->m_aPrefix, Common);
+			pBranch->m_Length = Common;
+			pBranch->m_pParent = pParent;
+			pBranch->m_apChild[PrefixBit(pPrefix, Common)] = pNew;
+			pBranch->m_apChild[PrefixBit(pNode->m_aPrefix, Common)] = pNode;
+			pNew->m_pParent = pBranch;
+			pNode->m_pParent = pBranch;
+			*ppLink = pBranch;
+			return pNew;
 		}
+
+		if(pNode->m_Length == Length)
+			return pNode;
+
+		pParent = pNode;
+		ppLink = &pNode->m_apChild[PrefixBit(pPrefix, pNode->m_Length)];
 	}
-	else
+}
+
+CNetBan::CTrieNode *CNetBan::CRangeTrie::FindNode(unsigned Type, const unsigned char *pPrefix, int Length) const
+{
+	const CTrieNode *pNode = *Root(Type);
+	while(pNode && pNode->m_Length <= Length && PrefixCommon(pNode->m_aPrefix, pPrefix, pNode->m_Length) == pNode->m_Length)
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		if(pNode->m_Length == Length)
+			return (CTrieNode *)pNode;
+		pNode = pNode->m_apChild[PrefixBit(pPrefix, pNode->m_Length)];
+	}
+	return 0;
+}
+
+void CNetBan::CRangeTrie::Prune(CTrieNode *pNode)
+{
+	// remove nodes that neither hold bans nor branch
+	while(pNode && !pNode->m_pRefs && !(pNode->m_apChild[0] && pNode->m_apChild[1]))
+	{
+		CTrieNode *pChild = pNode->m_apChild[0] ? pNode->m_apChild[0] : pNode->m_apChild[1];
+		CTrieNode *pParent = pNode->m_pParent;
+		*Link(pNode) = pChild;
+		if(pChild)
+			pChild->m_pParent = pParent;
+		mem_free(pNode);
+		if(pChild)
+			break;
+		pNode = pParent;
+	}
+}
+
+/*
+	splits a range into the largest aligned prefixes, starting at the lower bound.
+	returns 0 once the range is covered
+*/
+static int NextRangePrefix(unsigned char *pCurrent, const unsigned char *pUpper, int Bits, unsigned char *pPrefix, int *pLength)
+{
+	// the largest block that starts at pCurrent and does not go past pUpper
+	int Free = 0;
+	while(Free < Bits && !PrefixBit(pCurrent, Bits-1-Free))
+		Free++;
+	unsigned char aLast[16];
+	while(1)
+	{
+		mem_copy(aLast, pCurrent, sizeof(aLast));
+		for(int i = Bits-Free; i < Bits; i++)
+			aLast[i>>3] |= 0x80>>(i&7);
+		if(mem_comp(aLast, pUpper, Bits/8) <= 0)
+			break;
+		Free--;
+	}
+
+	mem_copy(pPrefix, pCurrent, 16);
+	*pLength = Bits-Free;
+
+	// step past the block
+	if(mem_comp(aLast, pUpper, Bits/8) == 0)
+		return 0;
+	mem_copy(pCurrent, aLast, 16);
+	for(int i = Bits/8-1; i >= 0; i--)
+	{
+		if(++pCurrent[i])
+			break;
+	}
+	return 1;
+}
+
+void CNetBan::CRangeTrie::Insert(CBanRange *pBan)
+{
+	const CNetRange *pRange = &pBan->m_Data;
+	int Bits = pRange->m_LB.type==NETTYPE_IPV4 ? 32 : 128;
+	unsigned char aCurrent[16] = {0}, aUpper[16] = {0}, aPrefix[16];
+	mem_copy(aCurrent, pRange->m_LB.ip, Bits/8);
+	mem_copy(aUpper, pRange->m_UB.ip, Bits/8);
+
+	pBan->m_pTrieRefs = 0;
+	CTrieRef **ppLast = &pBan->m_pTrieRefs;
+	int More;
+	do
+	{
+		int Length;
+		More = NextRangePrefix(aCurrent, aUpper, Bits, aPrefix, &Length);
+
+		CTrieRef *pRef = (CTrieRef *)mem_alloc(sizeof(CTrieRef), 1);
+		pRef->m_pBan = pBan;
+		pRef->m_pNode = Insert(pRange->m_LB.type, aPrefix, Length);
+		pRef->m_pNodeNext = pRef->m_pNode->m_pRefs;
+		pRef->m_pNode->m_pRefs = pRef;
+		pRef->m_pBanNext = 0;
+		*ppLast = pRef;
+		ppLast = &pRef->m_pBanNext;
+	}
+	while(More);
+}
+
+void CNetBan::CRangeTrie::Remove(CBanRange *pBan)
+{
+	CTrieRef *pNext;
+	for(CTrieRef *pRef = pBan->m_pTrieRefs; pRef; pRef = pNext)
+	{
+		pNext = pRef->m_pBanNext;
+		CTrieRef **ppLink = &pRef->m_pNode->m_pRefs;
+		while(*ppLink != pRef)
+			ppLink = &(*ppLink)->m_pNodeNext;
+		*ppLink = pRef->m_pNodeNext;
+		Prune(pRef->m_pNode);
+		mem_free(pRef);
+	}
+	pBan->m_pTrieRefs = 0;
+}
+
+CNetBan::CBanRange *CNetBan::CRangeTrie::Find(const CNetRange *pRange) const
+{
+	// an equal range was split the same way, so it has a ref at the first prefix
+	int Bits = pRange->m_LB.type==NETTYPE_IPV4 ? 32 : 128;
+	unsigned char aCurrent[16] = {0}, aUpper[16] = {0}, aPrefix[16];
+	mem_copy(aCurrent, pRange->m_LB.ip, Bits/8);
+	mem_copy(aUpper, pRange->m_UB.ip, Bits/8);
+	int Length;
+	NextRangePrefix(aCurrent, aUpper, Bits, aPrefix, &Length);
+
+	CTrieNode *pNode = FindNode(pRange->m_LB.type, aPrefix, Length);
+	for(CTrieRef *pRef = pNode ? pNode->m_pRefs : 0; pRef; pRef = pRef->m_pNodeNext)
+	{
+		if(NetComp(&pRef->m_pBan->m_Data, pRange) == 0)
+			return pRef->m_pBan;
+	}
+	return 0;
+}
+
+CNetBan::CBanRange *CNetBan::CRangeTrie::Match(const NETADDR *pAddr) const
+{
+	int Bits = pAddr->type==NETTYPE_IPV4 ? 32 : 128;
+	const CTrieNode *pNode = *Root(pAddr->type);
+	while(pNode && PrefixCommon(pNode->m_aPrefix, pAddr->ip, pNode->m_Length) == pNode->m_Length)
+	{
+		if(pNode->m_pRefs)
+			return pNode->m_pRefs->m_pBan;
+		if(pNode->m_Length == Bits)
+			break;
+		pNode = pNode->m_apChild[PrefixBit(pAddr->ip, pNode->m_Length)];
+	}
+	return 0;
+}
+
+
+template<class T, class TIndex>
+void CNetBan::CBanPool<T, TIndex>::ExpiryMove(CBan<T> *pBan, int Index)
+{
+	// sift up, then down
+	while(Index > 0 && m_ppExpiry[(Index-1)/2]->m_Info.m_Expires > pBan->m_Info.m_Expires)
+	{
+		m_ppExpiry[Index] = m_ppExpiry[(Index-1)/2];
+		m_ppExpiry[Index]->m_ExpiryIndex = Index;
+		Index = (Index-1)/2;
+	}
+	while(1)
+	{
+		int Child = Index*2+1;
+		if(Child >= m_NumExpiring)
+			break;
+		if(Child+1 < m_NumExpiring && m_ppExpiry[Child+1]->m_Info.m_Expires < m_ppExpiry[Child]->m_Info.m_Expires)
+			Child++;
+		if(m_ppExpiry[Child]->m_Info.m_Expires >= pBan->m_Info.m_Expires)
+			break;
+		m_ppExpiry[Index] = m_ppExpiry[Child];
+		m_ppExpiry[Index]->m_ExpiryIndex = Index;
+		Index = Child;
+	}
+	m_ppExpiry[Index] = pBan;
+	pBan->m_ExpiryIndex = Index;
+}
+
+template<class T, class TIndex>
+void CNetBan::CBanPool<T, TIndex>::ExpiryPush(CBan<T> *pBan)
+{
+	if(pBan->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER)
+	{
+		pBan->m_ExpiryIndex = -1;
+		return;
+	}
+
+	if(m_NumExpiring == m_ExpiryCapacity)
+	{
+		int Capacity = max(m_ExpiryCapacity*2, 64);
+		CBan<T> **ppExpiry = (CBan<T> **)mem_alloc(Capacity*sizeof(CBan<T> *), 1);
+		if(m_ppExpiry)
+		{
+			mem_copy(ppExpiry, m_ppExpiry, m_NumExpiring*sizeof(CBan<T> *));
+			mem_free(m_ppExpiry);
+		}
+		m_ppExpiry = ppExpiry;
+		m_ExpiryCapacity = Capacity;
 	}
 
+	ExpiryMove(pBan, m_NumExpiring++);
+}
+
+template<class T, class TIndex>
+void CNetBan::CBanPool<T, TIndex>::ExpiryRemove(CBan<T> *pBan)
+{
+	if(pBan->m_ExpiryIndex == -1)
+		return;
+
+	// move the last entry into the gap
+	CBan<T> *pLast = m_ppExpiry[--m_NumExpiring];
+	if(pLast != pBan)
+		ExpiryMove(pLast, pBan->m_ExpiryIndex);
+	pBan->m_ExpiryIndex = -1;
+}
+
+template<class T, class TIndex>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T, TIndex>::Add(const T *pData, const CBanInfo *pInfo)
+{
+	if(!m_pFirstFree)
+	{
+		// allocate a new block of bans
+		CBlock *pBlock = (CBlock *)mem_alloc(sizeof(CBlock), 1);
+		pBlock->m_pNext = m_pFirstBlock;
+		m_pFirstBlock = pBlock;
+		for(int i = 0; i < BLOCK_SIZE; ++i)
+			pBlock->m_aBans[i].m_pNext = i < BLOCK_SIZE-1 ? &pBlock->m_aBans[i+1] : 0;
+		m_pFirstFree = &pBlock->m_aBans[0];
+	}
+
+	// create new ban
+	CBan<T> *pBan = m_pFirstFree;
+	m_pFirstFree = pBan->m_pNext;
+	pBan->m_Data = *pData;
+	pBan->m_Info = *pInfo;
+	pBan->m_pHashNext = 0;
+	pBan->m_pTrieRefs = 0;
+
+	m_Index.Insert(pBan);
+	ExpiryPush(pBan);
+
+	// append it to the used list
+	pBan->m_pPrev = m_pLastUsed;
+	pBan->m_pNext = 0;
+	if(m_pLastUsed)
+		m_pLastUsed->m_pNext = pBan;
+	else
+		m_pFirstUsed = pBan;
+	m_pLastUsed = pBan;
+
 	// update ban count
 	++m_CountUsed;
 
 	return pBan;
 }
 
-template<class T, int HashCount>
-int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
+template<class T, class TIndex>
+int CNetBan::CBanPool<T, TIndex>::Remove(CBan<T> *pBan)
 {
 	if(pBan == 0)
 		return -1;
 
-	// remove from hash list
-	if(pBan->m_pHashNext)
-		pBan->m_pHashNext->m_pHashPrev = pBan->m_pHashPrev;
-	if(pBan->m_pHashPrev)
-		pBan->m_pHashPrev->m_pHashNext = pBan->m_pHashNext;
-	else
-		m_paaHashList[pBan->m_NetHash.m_HashIndex][pBan->m_NetHash.m_Hash] = pBan->m_pHashNext;
-	pBan->m_pHashNext = pBan->m_pHashPrev = 0;
+	m_Index.Remove(pBan);
+	ExpiryRemove(pBan);
 
 	// remove from used list
 	if(pBan->m_pNext)
 		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
+	else
+		m_pLastUsed = pBan->m_pPrev;
 	if(pBan->m_pPrev)
 		pBan->m_pPrev->m_pNext = pBan->m_pNext;
 	else
 		m_pFirstUsed = pBan->m_pNext;
 
 	// add to recycle list
-	if(m_pFirstFree)
-		m_pFirstFree->m_pPrev = pBan;
 	pBan->m_pPrev = 0;
 	pBan->m_pNext = m_pFirstFree;
 	m_pFirstFree = pBan;
@@ -157,75 +509,43 @@ int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
 	return 0;
 }
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
+template<class T, class TIndex>
+void CNetBan::CBanPool<T, TIndex>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
 {
+	ExpiryRemove(pBan);
 	pBan->m_Info = *pInfo;
+	ExpiryPush(pBan);
+}
 
-	// remove from used list
-	if(pBan->m_pNext)
-		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
-	if(pBan->m_pPrev)
-		pBan->m_pPrev->m_pNext = pBan->m_pNext;
-	else
-		m_pFirstUsed = pBan->m_pNext;
+template<class T, class TIndex>
+void CNetBan::CBanPool<T, TIndex>::Reset()
+{
+	m_Index.Reset();
 
-	// insert it into the used list
-	if(m_pFirstUsed)
+	// keep the first block for new bans
+	CBlock *pNext;
+	for(CBlock *pBlock = m_pFirstBlock ? m_pFirstBlock->m_pNext : 0; pBlock; pBlock = pNext)
 	{
-		for(CBan<T> *p = m_pFirstUsed; ; p = p->m_pNext)
-		{
-			if(p->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || (pInfo->m_Expires != CBanInfo::EXPIRES_NEVER && pInfo->m_Expires <= p->m_Info.m_Expires))
-			{
-				// insert before
-				pBan->m_pNext = p;
-				pBan->m_pPrev = p->m_pPrev;
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = pBan;
-				else
-					m_pFirstUsed = pBan;
-				p->m_pPrev = pBan;
-				break;
-			}
-
-			if(!p->m_pNext)
-			{
-				// last entry
-				p->m_pNext = pBan;
-				pBan->m_pPrev = p;
-				pBan->m_pNext = 0;
-				break;
-			}
-		}
+		pNext = pBlock->m_pNext;
+		mem_free(pBlock);
 	}
-	else
+	m_pFirstFree = 0;
+	if(m_pFirstBlock)
 	{
-		m_pFirstUsed = pBan;
-		pBan->m_pNext = pBan->m_pPrev = 0;
+		m_pFirstBlock->m_pNext = 0;
+		for(int i = 0; i < BLOCK_SIZE; ++i)
+			m_pFirstBlock->m_aBans[i].m_pNext = i < BLOCK_SIZE-1 ? &m_pFirstBlock->m_aBans[i+1] : 0;
+		m_pFirstFree = &m_pFirstBlock->m_aBans[0];
 	}
-}
 
-template<class T, int HashCount>
-void CNetBan::CBanPool<T, HashCount>::Reset()
-{
-	mem_zero(m_paaHashList, sizeof(m_paaHashList));
-	mem_zero(m_aBans, sizeof(m_aBans));
 	m_pFirstUsed = 0;
+	m_pLastUsed = 0;
 	m_CountUsed = 0;
-
-	for(int i = 1; i < MAX_BANS-1; ++i)
-	{
-		m_aBans[i].m_pNext = &m_aBans[i+1];
-		m_aBans[i].m_pPrev = &m_aBans[i-1];
-	}
-
-	m_aBans[0].m_pNext = &m_aBans[1];
-	m_aBans[MAX_BANS-1].m_pPrev = &m_aBans[MAX_BANS-2];
-	m_pFirstFree = &m_aBans[0];
+	m_NumExpiring = 0;
 }
 
-template<class T, int HashCount>
-typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Get(int Index) const
+template<class T, class TIndex>
+typename CNetBan::CBan<T> *CNetBan::CBanPool<T, TIndex>::Get(int Index) const
 {
 	if(Index < 0 || Index >= Num())
 		return 0;
@@ -301,8 +621,7 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
 
 	// check if it already exists
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		// adjust the ban
@@ -314,24 +633,17 @@ int CNetBan::Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, c
 	}
 
 	// add ban and print result
-	pBan = pBanPool->Add(pData, &Info, &NetHash);
-	if(pBan)
-	{
-		char aBuf[128];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 0;
-	}
-	else
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
-	return -1;
+	pBan = pBanPool->Add(pData, &Info);
+	char aBuf[128];
+	MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return 0;
 }
 
 template<class T>
 int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 {
-	CNetHash NetHash(pData);
-	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		char aBuf[256];
@@ -345,6 +657,25 @@ int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 	return -1;
 }
 
+template<class T>
+bool CNetBan::LoadBan(T *pBanPool, const typename T::CDataType *pData, int Minutes, const char *pReason)
+{
+	// same as Ban but quiet, banlists can be long
+	if(NetMatch(pData, &m_LocalhostIPV4) || NetMatch(pData, &m_LocalhostIPV6))
+		return false;
+
+	CBanInfo Info = {0};
+	Info.m_Expires = Minutes > 0 ? time_timestamp()+Minutes*60 : CBanInfo::EXPIRES_NEVER;
+	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
+
+	CBan<typename T::CDataType> *pBan = pBanPool->Find(pData);
+	if(pBan)
+		pBanPool->Update(pBan, &Info);
+	else
+		pBanPool->Add(pData, &Info);
+	return true;
+}
+
 void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 {
 	m_pConsole = pConsole;
@@ -362,6 +693,7 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	Console()->Register("unban_all", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConUnbanAll, this, "Unban all entries");
 	Console()->Register("bans", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBans, this, "Show banlist");
 	Console()->Register("bans_save", "s", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansSave, this, "Save banlist in a file");
+	Console()->Register("bans_load", "s", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansLoad, this, "Load a banlist saved with bans_save without printing every entry");
 }
 
 void CNetBan::Update()
@@ -370,17 +702,17 @@ void CNetBan::Update()
 
 	// remove expired bans
 	char aBuf[256], aNetStr[256];
-	while(m_BanAddrPool.First() && m_BanAddrPool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanAddrPool.First()->m_Info.m_Expires < Now)
+	while(m_BanAddrPool.NextExpiring() && m_BanAddrPool.NextExpiring()->m_Info.m_Expires < Now)
 	{
-		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.First()->m_Data, aNetStr, sizeof(aNetStr)));
+		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanAddrPool.NextExpiring()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanAddrPool.Remove(m_BanAddrPool.First());
+		m_BanAddrPool.Remove(m_BanAddrPool.NextExpiring());
 	}
-	while(m_BanRangePool.First() && m_BanRangePool.First()->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER && m_BanRangePool.First()->m_Info.m_Expires < Now)
+	while(m_BanRangePool.NextExpiring() && m_BanRangePool.NextExpiring()->m_Info.m_Expires < Now)
 	{
-		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.First()->m_Data, aNetStr, sizeof(aNetStr)));
+		str_format(aBuf, sizeof(aBuf), "ban %s expired", NetToString(&m_BanRangePool.NextExpiring()->m_Data, aNetStr, sizeof(aNetStr)));
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		m_BanRangePool.Remove(m_BanRangePool.First());
+		m_BanRangePool.Remove(m_BanRangePool.NextExpiring());
 	}
 }
 
@@ -445,11 +777,8 @@ int CNetBan::UnbanByIndex(int Index)
 
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
 {
-	CNetHash aHash[17];
-	int Length = CNetHash::MakeHashArray(pAddr, aHash);
-
 	// check ban adresses
-	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
+	CBanAddr *pBan = m_BanAddrPool.Match(pAddr);
 	if(pBan)
 	{
 		MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
@@ -457,18 +786,13 @@ bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) co
 	}
 
 	// check ban ranges
-	for(int i = Length-1; i >= 0; --i)
+	CBanRange *pBanRange = m_BanRangePool.Match(pAddr);
+	if(pBanRange)
 	{
-		for(CBanRange *pBan = m_BanRangePool.First(&aHash[i]); pBan; pBan = pBan->m_pHashNext)
-		{
-			if(NetMatch(&pBan->m_Data, pAddr, i, Length))
-			{
-				MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
-				return true;
-			}
-		}
+		MakeBanInfo(pBanRange, pBuf, BufferSize, MSGTYPE_PLAYER);
+		return true;
 	}
-	
+
 	return false;
 }
 
@@ -601,3 +925,82 @@ void CNetBan::ConBansSave(IConsole::IResult *pResult, void *pUser)
 	str_format(aBuf, sizeof(aBuf), "saved banlist to '%s'", pResult->GetString(0));
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 }
+
+void CNetBan::ConBansLoad(IConsole::IResult *pResult, void *pUser)
+{
+	CNetBan *pThis = static_cast<CNetBan *>(pUser);
+
+	char aBuf[256];
+	IOHANDLE File = pThis->Storage()->OpenFile(pResult->GetString(0), IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to load banlist from '%s'", pResult->GetString(0));
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+		return;
+	}
+
+	// lines are "ban <addr> <minutes> <reason>" or "ban_range <lower> <upper> <minutes> <reason>"
+	CLineReader LineReader;
+	LineReader.Init(File);
+	int Loaded = 0, Failed = 0;
+	char *pLine;
+	while((pLine = LineReader.Get()))
+	{
+		char aaArgs[3][NETADDR_MAXSTRSIZE];
+		bool IsRange = str_comp_num(pLine, "ban_range ", 10) == 0;
+		if(!IsRange && str_comp_num(pLine, "ban ", 4) != 0)
+		{
+			if(pLine[0])
+				Failed++;
+			continue;
+		}
+
+		// split the address and minute arguments, the rest is the reason
+		const char *pStr = pLine + (IsRange ? 10 : 4);
+		int NumArgs = IsRange ? 3 : 2;
+		int i;
+		for(i = 0; i < NumArgs; i++)
+		{
+			pStr = str_skip_whitespaces((char *)pStr);
+			int Length = 0;
+			while(pStr[Length] && pStr[Length] != ' ' && pStr[Length] != '\t')
+				Length++;
+			if(!Length)
+				break;
+			str_copy(aaArgs[i], pStr, min(Length+1, (int)sizeof(aaArgs[i])));
+			pStr += Length;
+		}
+		const char *pReason = str_skip_whitespaces((char *)pStr);
+		if(!pReason[0])
+			pReason = "No reason given";
+		if(i < NumArgs)
+		{
+			Failed++;
+			continue;
+		}
+
+		int Minutes = str_toint(aaArgs[NumArgs-1]);
+		bool Success = false;
+		if(IsRange)
+		{
+			CNetRange Range;
+			if(net_addr_from_str(&Range.m_LB, aaArgs[0]) == 0 && net_addr_from_str(&Range.m_UB, aaArgs[1]) == 0 && Range.IsValid())
+				Success = pThis->LoadBan(&pThis->m_BanRangePool, &Range, Minutes, pReason);
+		}
+		else
+		{
+			NETADDR Addr;
+			if(net_addr_from_str(&Addr, aaArgs[0]) == 0)
+				Success = pThis->LoadBan(&pThis->m_BanAddrPool, &Addr, Minutes, pReason);
+		}
+
+		if(Success)
+			Loaded++;
+		else
+			Failed++;
+	}
+	io_close(File);
+
+	str_format(aBuf, sizeof(aBuf), "loaded %d bans from '%s' (%d invalid lines)", Loaded, pResult->GetString(0), Failed);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+}
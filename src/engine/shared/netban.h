@@ -63,18 +63,7 @@ protected:
 	// todo: move?
 	static bool StrAllnum(const char *pStr);
 
-	class CNetHash
-	{
-	public:
-		int m_Hash;
-		int m_HashIndex;	// matching parts for ranges, 0 for addr
-
-		CNetHash() {}	
-		CNetHash(const NETADDR *pAddr);
-		CNetHash(const CNetRange *pRange);
-
-		static int MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17]);
-	};
+	struct CTrieRef;
 
 	struct CBanInfo
 	{
@@ -91,65 +80,154 @@ protected:
 	{
 		T m_Data;
 		CBanInfo m_Info;
-		CNetHash m_NetHash;
 
-		// hash list
+		// address hash chain
 		CBan *m_pHashNext;
-		CBan *m_pHashPrev;
+
+		// trie nodes covering a range
+		CTrieRef *m_pTrieRefs;
+
+		// position in the expiry heap, -1 for permanent bans
+		int m_ExpiryIndex;
 
 		// used or free list
 		CBan *m_pNext;
 		CBan *m_pPrev;
 	};
 
-	template<class T, int HashCount> class CBanPool
+	typedef CBan<NETADDR> CBanAddr;
+	typedef CBan<CNetRange> CBanRange;
+
+	// hash set of single addresses, the bucket array grows with the number of bans
+	class CAddrHash
+	{
+		CBanAddr **m_ppBuckets;
+		int m_NumBuckets;
+		int m_Num;
+
+		static unsigned Hash(const NETADDR *pAddr);
+		void Grow();
+	public:
+		CAddrHash();
+		~CAddrHash();
+		void Reset();
+		void Insert(CBanAddr *pBan);
+		void Remove(CBanAddr *pBan);
+		CBanAddr *Find(const NETADDR *pAddr) const;
+		CBanAddr *Match(const NETADDR *pAddr) const { return Find(pAddr); }
+	};
+
+	/*
+		ranges are split into cidr prefixes which are stored in a path compressed
+		binary trie per address type, so a lookup walks at most 32 or 128 bits
+		no matter how many bans there are
+	*/
+	struct CTrieNode
+	{
+		unsigned char m_aPrefix[16]; // bits after m_Length are 0
+		int m_Length;
+		CTrieNode *m_pParent;
+		CTrieNode *m_apChild[2];
+		CTrieRef *m_pRefs;
+	};
+
+	struct CTrieRef
+	{
+		CBanRange *m_pBan;
+		CTrieNode *m_pNode;
+		CTrieRef *m_pNodeNext; // refs of the same node
+		CTrieRef *m_pBanNext; // refs of the same ban
+	};
+
+	class CRangeTrie
+	{
+		CTrieNode *m_apRoot[2]; // ipv4, ipv6
+
+		CTrieNode **Root(unsigned Type) { return &m_apRoot[Type == NETTYPE_IPV4 ? 0 : 1]; }
+		CTrieNode *const *Root(unsigned Type) const { return &m_apRoot[Type == NETTYPE_IPV4 ? 0 : 1]; }
+		CTrieNode **Link(CTrieNode *pNode);
+		CTrieNode *Insert(unsigned Type, const unsigned char *pPrefix, int Length);
+		CTrieNode *FindNode(unsigned Type, const unsigned char *pPrefix, int Length) const;
+		void Prune(CTrieNode *pNode);
+		void FreeNodes(CTrieNode *pNode);
+	public:
+		CRangeTrie();
+		~CRangeTrie();
+		void Reset();
+		void Insert(CBanRange *pBan);
+		void Remove(CBanRange *pBan);
+		CBanRange *Find(const CNetRange *pRange) const;
+		CBanRange *Match(const NETADDR *pAddr) const;
+	};
+
+	template<class T, class TIndex> class CBanPool
 	{
 	public:
 		typedef T CDataType;
 
-		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo, const CNetHash *pNetHash);
+		CBanPool() : m_pFirstBlock(0), m_pFirstFree(0), m_pFirstUsed(0), m_pLastUsed(0), m_CountUsed(0), m_ppExpiry(0), m_NumExpiring(0), m_ExpiryCapacity(0) {}
+		~CBanPool()
+		{
+			while(m_pFirstBlock)
+			{
+				CBlock *pNext = m_pFirstBlock->m_pNext;
+				mem_free(m_pFirstBlock);
+				m_pFirstBlock = pNext;
+			}
+			if(m_ppExpiry)
+				mem_free(m_ppExpiry);
+		}
+
+		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo);
 		int Remove(CBan<CDataType> *pBan);
 		void Update(CBan<CDataType> *pBan, const CBanInfo *pInfo);
 		void Reset();
 	
 		int Num() const { return m_CountUsed; }
-		bool IsFull() const { return m_CountUsed == MAX_BANS; }
 
 		CBan<CDataType> *First() const { return m_pFirstUsed; }
-		CBan<CDataType> *First(const CNetHash *pNetHash) const { return m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; }
-		CBan<CDataType> *Find(const CDataType *pData, const CNetHash *pNetHash) const
-		{
-			for(CBan<CDataType> *pBan = m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; pBan; pBan = pBan->m_pHashNext)
-			{
-				if(NetComp(&pBan->m_Data, pData) == 0)
-					return pBan;
-			}
-
-			return 0;
-		}
+		CBan<CDataType> *NextExpiring() const { return m_NumExpiring ? m_ppExpiry[0] : 0; }
+		CBan<CDataType> *Find(const CDataType *pData) const { return m_Index.Find(pData); }
+		CBan<CDataType> *Match(const NETADDR *pAddr) const { return m_Index.Match(pAddr); }
 		CBan<CDataType> *Get(int Index) const;
 
 	private:
 		enum
 		{
-			MAX_BANS=1024,
+			BLOCK_SIZE=1024,
 		};
 
-		CBan<CDataType> *m_paaHashList[HashCount][256];
-		CBan<CDataType> m_aBans[MAX_BANS];
+		// bans are allocated in blocks which are never moved
+		struct CBlock
+		{
+			CBlock *m_pNext;
+			CBan<CDataType> m_aBans[BLOCK_SIZE];
+		};
+
+		void ExpiryPush(CBan<CDataType> *pBan);
+		void ExpiryRemove(CBan<CDataType> *pBan);
+		void ExpiryMove(CBan<CDataType> *pBan, int Index);
+
+		TIndex m_Index;
+		CBlock *m_pFirstBlock;
 		CBan<CDataType> *m_pFirstFree;
 		CBan<CDataType> *m_pFirstUsed;
+		CBan<CDataType> *m_pLastUsed;
 		int m_CountUsed;
+
+		// min heap of the timed bans by expiry
+		CBan<CDataType> **m_ppExpiry;
+		int m_NumExpiring;
+		int m_ExpiryCapacity;
 	};
 
-	typedef CBanPool<NETADDR, 1> CBanAddrPool;
-	typedef CBanPool<CNetRange, 16> CBanRangePool;
-	typedef CBan<NETADDR> CBanAddr;
-	typedef CBan<CNetRange> CBanRange;
+	typedef CBanPool<NETADDR, CAddrHash> CBanAddrPool;
+	typedef CBanPool<CNetRange, CRangeTrie> CBanRangePool;
 	
 	template<class T> void MakeBanInfo(const CBan<T> *pBan, char *pBuf, unsigned BuffSize, int Type) const;
 	template<class T> int Ban(T *pBanPool, const typename T::CDataType *pData, int Seconds, const char *pReason);
 	template<class T> int Unban(T *pBanPool, const typename T::CDataType *pData);
+	template<class T> bool LoadBan(T *pBanPool, const typename T::CDataType *pData, int Minutes, const char *pReason);
 
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
@@ -188,6 +266,7 @@ public:
 	static void ConUnbanAll(class IConsole::IResult *pResult, void *pUser);
 	static void ConBans(class IConsole::IResult *pResult, void *pUser);
 	static void ConBansSave(class IConsole::IResult *pResult, void *pUser);
+	static void ConBansLoad(class IConsole::IResult *pResult, void *pUser);
 };
 
 #endif
@@ -0,0 +1,153 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
+#include "netratelimit.h"
+
+
+void CNetRateLimit::Init()
+{
+	m_NumEntries = 0;
+	m_LruFirst = -1;
+	m_LruLast = -1;
+	for(int i = 0; i < HASH_SIZE; i++)
+		m_aHash[i] = -1;
+	for(int i = 0; i < NUM_TYPES; i++)
+	{
+		m_aRate[i] = 0;
+		m_aBurst[i] = 0;
+	}
+	mem_zero(&m_Stats, sizeof(m_Stats));
+}
+
+void CNetRateLimit::SetBudget(int Type, int Rate, int Burst)
+{
+	if(Type < 0 || Type >= NUM_TYPES)
+		return;
+	m_aRate[Type] = Rate;
+	m_aBurst[Type] = max(Burst, 1);
+}
+
+unsigned CNetRateLimit::Hash(const unsigned char *pKey, unsigned NetType)
+{
+	// fnv-1a
+	unsigned h = 2166136261u^NetType;
+	for(int i = 0; i < KEY_SIZE; i++)
+		h = (h^pKey[i])*16777619u;
+	return h&(HASH_SIZE-1);
+}
+
+void CNetRateLimit::LruUnlink(int Index)
+{
+	CEntry *pEntry = &m_aEntries[Index];
+	if(pEntry->m_LruPrev != -1)
+		m_aEntries[pEntry->m_LruPrev].m_LruNext = pEntry->m_LruNext;
+	else
+		m_LruFirst = pEntry->m_LruNext;
+	if(pEntry->m_LruNext != -1)
+		m_aEntries[pEntry->m_LruNext].m_LruPrev = pEntry->m_LruPrev;
+	else
+		m_LruLast = pEntry->m_LruPrev;
+}
+
+void CNetRateLimit::LruPushFront(int Index)
+{
+	CEntry *pEntry = &m_aEntries[Index];
+	pEntry->m_LruPrev = -1;
+	pEntry->m_LruNext = m_LruFirst;
+	if(m_LruFirst != -1)
+		m_aEntries[m_LruFirst].m_LruPrev = Index;
+	else
+		m_LruLast = Index;
+	m_LruFirst = Index;
+}
+
+void CNetRateLimit::HashUnlink(int Index)
+{
+	int *pLink = &m_aHash[Hash(m_aEntries[Index].m_aKey, m_aEntries[Index].m_NetType)];
+	while(*pLink != Index)
+		pLink = &m_aEntries[*pLink].m_HashNext;
+	*pLink = m_aEntries[Index].m_HashNext;
+}
+
+int CNetRateLimit::Find(const NETADDR *pAddr, int64 Now)
+{
+	// the port is ignored and ipv6 sources are grouped by their /64 prefix
+	unsigned char aKey[KEY_SIZE] = {0};
+	mem_copy(aKey, pAddr->ip, pAddr->type == NETTYPE_IPV4 ? 4 : KEY_SIZE);
+
+	unsigned h = Hash(aKey, pAddr->type);
+	for(int i = m_aHash[h]; i != -1; i = m_aEntries[i].m_HashNext)
+	{
+		if(m_aEntries[i].m_NetType == pAddr->type && mem_comp(m_aEntries[i].m_aKey, aKey, KEY_SIZE) == 0)
+		{
+			if(i != m_LruFirst)
+			{
+				LruUnlink(i);
+				LruPushFront(i);
+			}
+			return i;
+		}
+	}
+
+	// take a free entry or recycle the least recently seen one
+	int Index;
+	if(m_NumEntries < MAX_ENTRIES)
+		Index = m_NumEntries++;
+	else
+	{
+		Index = m_LruLast;
+		LruUnlink(Index);
+		HashUnlink(Index);
+		m_Stats.m_Evictions++;
+	}
+
+	CEntry *pEntry = &m_aEntries[Index];
+	mem_copy(pEntry->m_aKey, aKey, KEY_SIZE);
+	pEntry->m_NetType = pAddr->type;
+	for(int t = 0; t < NUM_TYPES; t++)
+		pEntry->m_aTokens[t] = m_aBurst[t]*TOKEN_SCALE;
+	pEntry->m_LastRefill = Now;
+	pEntry->m_HashNext = m_aHash[h];
+	m_aHash[h] = Index;
+	LruPushFront(Index);
+	return Index;
+}
+
+bool CNetRateLimit::Allow(const NETADDR *pAddr, int Type)
+{
+	if(!m_aRate[Type])
+	{
+		m_Stats.m_aAllowed[Type]++;
+		return true;
+	}
+
+	int64 Now = time_get();
+	CEntry *pEntry = &m_aEntries[Find(pAddr, Now)];
+
+	// refill all buckets of the source
+	int64 Elapsed = Now-pEntry->m_LastRefill;
+	if(Elapsed > 0)
+	{
+		for(int t = 0; t < NUM_TYPES; t++)
+		{
+			if(!m_aRate[t])
+				continue;
+			// a source idle for long would overflow the product, the bucket is full by then anyway
+			int64 Refill = min(Elapsed, (int64)m_aBurst[t]*time_freq()/m_aRate[t]+1);
+			int64 Tokens = pEntry->m_aTokens[t] + Refill*m_aRate[t]*TOKEN_SCALE/time_freq();
+			pEntry->m_aTokens[t] = (int)min(Tokens, (int64)m_aBurst[t]*TOKEN_SCALE);
+		}
+		pEntry->m_LastRefill = Now;
+	}
+
+	if(pEntry->m_aTokens[Type] < TOKEN_SCALE)
+	{
+		m_Stats.m_aDropped[Type]++;
+		return false;
+	}
+
+	pEntry->m_aTokens[Type] -= TOKEN_SCALE;
+	m_Stats.m_aAllowed[Type]++;
+	return true;
+}
@@ -0,0 +1,76 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_NETRATELIMIT_H
+#define ENGINE_SHARED_NETRATELIMIT_H
+
+#include <base/system.h>
+
+
+// token buckets per source address (ipv6 addresses per /64), the least recently seen sources are evicted when the table is full
+class CNetRateLimit
+{
+public:
+	enum
+	{
+		TYPE_CONNLESS=0,
+		TYPE_CONNECT,
+		NUM_TYPES,
+
+		MAX_ENTRIES=4096,
+	};
+
+	struct CStats
+	{
+		unsigned m_aAllowed[NUM_TYPES];
+		unsigned m_aDropped[NUM_TYPES];
+		unsigned m_Evictions;
+	};
+
+private:
+	enum
+	{
+		HASH_SIZE=MAX_ENTRIES*2,
+		KEY_SIZE=8,
+		TOKEN_SCALE=1000,
+	};
+
+	struct CEntry
+	{
+		unsigned char m_aKey[KEY_SIZE];
+		unsigned m_NetType;
+		int m_aTokens[NUM_TYPES]; // in 1/TOKEN_SCALE tokens
+		int64 m_LastRefill;
+
+		int m_HashNext;
+		int m_LruPrev;
+		int m_LruNext;
+	};
+
+	CEntry m_aEntries[MAX_ENTRIES];
+	int m_aHash[HASH_SIZE];
+	int m_NumEntries;
+	int m_LruFirst;
+	int m_LruLast;
+
+	int m_aRate[NUM_TYPES];
+	int m_aBurst[NUM_TYPES];
+	CStats m_Stats;
+
+	static unsigned Hash(const unsigned char *pKey, unsigned NetType);
+	void LruUnlink(int Index);
+	void LruPushFront(int Index);
+	void HashUnlink(int Index);
+	int Find(const NETADDR *pAddr, int64 Now);
+
+public:
+	void Init();
+	void SetBudget(int Type, int Rate, int Burst);
+
+	// takes a token from the bucket of the address, returns false when it is empty
+	bool Allow(const NETADDR *pAddr, int Type);
+
+	const CStats *Stats() const { return &m_Stats; }
+	int NumEntries() const { return m_NumEntries; }
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "ringbuffer.h"
 #include "huffman.h"
+#include "netratelimit.h"
 
 /*
 
@@ -52,6 +53,7 @@ enum
 	NET_PACKETHEADERSIZE = 3,
 	NET_MAX_CLIENTS = 16,
 	NET_MAX_CONSOLE_CLIENTS = 4,
+	NET_CONSOLE_SEND_BUFFER_SIZE = 64*1024,
 	NET_MAX_SEQUENCE = 1<<10,
 	NET_SEQUENCE_MASK = NET_MAX_SEQUENCE-1,
 
@@ -207,21 +209,38 @@ private:
 	char m_aBuffer[NET_MAX_PACKETSIZE];
 	int m_BufferOffset;
 
+	// outgoing lines are queued here and written out by Flush without blocking
+	char m_aSendBuffer[NET_CONSOLE_SEND_BUFFER_SIZE];
+	int m_SendBufferSize;
+	int m_OverflowPolicy;
+	int m_NumDroppedLines;
+	int m_NumUnreportedDrops;
+
 	char m_aErrorString[256];
 
 	bool m_LineEndingDetected;
 	char m_aLineEnding[3];
 
+	bool QueueData(const char *pData, int Size);
+
 public:
-	void Init(NETSOCKET Socket, const NETADDR *pAddr);
+	enum
+	{
+		OVERFLOW_DROP=0,
+		OVERFLOW_DISCONNECT,
+	};
+
+	void Init(NETSOCKET Socket, const NETADDR *pAddr, int OverflowPolicy);
 	void Disconnect(const char *pReason);
 
 	int State() const { return m_State; }
 	const NETADDR *PeerAddress() const { return &m_PeerAddr; }
 	const char *ErrorString() const { return m_aErrorString; }
+	int NumDroppedLines() const { return m_NumDroppedLines; }
 
 	void Reset();
 	int Update();
+	int Flush();
 	int Send(const char *pLine);
 	int Recv(char *pLine, int MaxLength);
 };
@@ -258,6 +277,7 @@ class CNetServer
 	CSlot m_aSlots[NET_MAX_CLIENTS];
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
+	CNetRateLimit m_RateLimit;
 
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_DELCLIENT m_pfnDelClient;
@@ -284,6 +304,7 @@ public:
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
 	NETSOCKET Socket() const { return m_Socket; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
+	CNetRateLimit *RateLimit() { return &m_RateLimit; }
 	int NetType() const { return m_Socket.type; }
 	int MaxClients() const { return m_MaxClients; }
 
@@ -306,10 +327,13 @@ class CNetConsole
 	NETFUNC_DELCLIENT m_pfnDelClient;
 	void *m_UserPtr;
 
+	int m_OverflowPolicy;
+
 	CNetRecvUnpacker m_RecvUnpacker;
 
 public:
 	void SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
+	void SetOverflowPolicy(int Policy) { m_OverflowPolicy = Policy; }
 
 	//
 	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int Flags);
@@ -319,6 +343,7 @@ public:
 	int Recv(char *pLine, int MaxLength, int *pClientID = 0);
 	int Send(int ClientID, const char *pLine);
 	int Update();
+	void Flush();
 
 	//
 	int AcceptClient(NETSOCKET Socket, const NETADDR *pAddr);
@@ -81,7 +81,7 @@ int CNetConsole::AcceptClient(NETSOCKET Socket, const NETADDR *pAddr)
 	// accept client
 	if(!aError[0] && FreeSlot != -1)
 	{
-		m_aSlots[FreeSlot].m_Connection.Init(Socket, pAddr);
+		m_aSlots[FreeSlot].m_Connection.Init(Socket, pAddr, m_OverflowPolicy);
 		if(m_pfnNewClient)
 			m_pfnNewClient(FreeSlot, m_UserPtr);
 		return 0;
@@ -127,6 +127,17 @@ int CNetConsole::Update()
 	return 0;
 }
 
+void CNetConsole::Flush()
+{
+	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	{
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ONLINE)
+			m_aSlots[i].m_Connection.Flush();
+		if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_ERROR)
+			Drop(i, m_aSlots[i].m_Connection.ErrorString());
+	}
+}
+
 int CNetConsole::Recv(char *pLine, int MaxLength, int *pClientID)
 {
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
@@ -14,6 +14,9 @@ void CConsoleNetConnection::Reset()
 	m_Socket.ipv6sock = -1;
 	m_aBuffer[0] = 0;
 	m_BufferOffset = 0;
+	m_SendBufferSize = 0;
+	m_NumDroppedLines = 0;
+	m_NumUnreportedDrops = 0;
 
 	m_LineEndingDetected = false;
 	#if defined(CONF_FAMILY_WINDOWS)
@@ -27,11 +30,12 @@ void CConsoleNetConnection::Reset()
 	#endif
 }
 
-void CConsoleNetConnection::Init(NETSOCKET Socket, const NETADDR *pAddr)
+void CConsoleNetConnection::Init(NETSOCKET Socket, const NETADDR *pAddr, int OverflowPolicy)
 {
 	Reset();
 
 	m_Socket = Socket;
+	m_OverflowPolicy = OverflowPolicy;
 	net_set_non_blocking(m_Socket);
 
 	m_PeerAddr = *pAddr;
@@ -43,9 +47,13 @@ void CConsoleNetConnection::Disconnect(const char *pReason)
 	if(State() == NET_CONNSTATE_OFFLINE)
 		return;
 
-	if(pReason && pReason[0])
+	if(pReason && pReason[0] && State() == NET_CONNSTATE_ONLINE)
 		Send(pReason);
 
+	// best effort, whatever the peer doesn't take right now is lost
+	if(State() == NET_CONNSTATE_ONLINE)
+		Flush();
+
 	net_tcp_close(m_Socket);
 
 	Reset();
@@ -151,11 +159,37 @@ int CConsoleNetConnection::Recv(char *pLine, int MaxLength)
 	return 0;
 }
 
+bool CConsoleNetConnection::QueueData(const char *pData, int Size)
+{
+	if(m_SendBufferSize+Size > (int)sizeof(m_aSendBuffer))
+		return false;
+
+	mem_copy(m_aSendBuffer+m_SendBufferSize, pData, Size);
+	m_SendBufferSize += Size;
+	return true;
+}
+
 int CConsoleNetConnection::Send(const char *pLine)
 {
 	if(State() != NET_CONNSTATE_ONLINE)
 		return -1;
 
+	// tell the peer about lines that were dropped earlier as soon as there is room again
+	if(m_NumUnreportedDrops)
+	{
+		char aNotice[64];
+		str_format(aNotice, sizeof(aNotice), "[%d lines dropped]", m_NumUnreportedDrops);
+		int Length = str_length(aNotice);
+		mem_copy(aNotice+Length, m_aLineEnding, 3);
+		if(!QueueData(aNotice, Length+3))
+		{
+			m_NumDroppedLines++;
+			m_NumUnreportedDrops++;
+			return -1;
+		}
+		m_NumUnreportedDrops = 0;
+	}
+
 	char aBuf[1024];
 	str_copy(aBuf, pLine, (int)(sizeof(aBuf))-2);
 	int Length = str_length(aBuf);
@@ -163,23 +197,53 @@ int CConsoleNetConnection::Send(const char *pLine)
 	aBuf[Length+1] = m_aLineEnding[1];
 	aBuf[Length+2] = m_aLineEnding[2];
 	Length += 3;
-	const char *pData = aBuf;
 
-	while(true)
+	if(!QueueData(aBuf, Length))
 	{
-		int Send = net_tcp_send(m_Socket, pData, Length);
+		if(m_OverflowPolicy == OVERFLOW_DISCONNECT)
+		{
+			// the owner drops the connection on its next update
+			m_State = NET_CONNSTATE_ERROR;
+			str_copy(m_aErrorString, "too slow connection (send buffer overflow)", sizeof(m_aErrorString));
+		}
+		else
+		{
+			m_NumDroppedLines++;
+			m_NumUnreportedDrops++;
+		}
+		return -1;
+	}
+
+	return 0;
+}
+
+int CConsoleNetConnection::Flush()
+{
+	if(State() != NET_CONNSTATE_ONLINE)
+		return -1;
+
+	int Offset = 0;
+	while(Offset < m_SendBufferSize)
+	{
+		int Send = net_tcp_send(m_Socket, m_aSendBuffer+Offset, m_SendBufferSize-Offset);
 		if(Send < 0)
 		{
+			if(net_would_block()) // socket buffer is full, try again next time
+				break;
+
 			m_State = NET_CONNSTATE_ERROR;
 			str_copy(m_aErrorString, "failed to send packet", sizeof(m_aErrorString));
 			return -1;
 		}
-
-		if(Send >= Length)
+		if(Send == 0)
 			break;
+		Offset += Send;
+	}
 
-		pData += Send;
-		Length -= Send;
+	if(Offset > 0)
+	{
+		mem_move(m_aSendBuffer, m_aSendBuffer+Offset, m_SendBufferSize-Offset);
+		m_SendBufferSize -= Offset;
 	}
 
 	return 0;
@@ -28,6 +28,7 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 		m_MaxClients = 1;
 
 	m_MaxClientsPerIP = MaxClientsPerIP;
+	m_RateLimit.Init();
 
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Init(m_Socket, true);
@@ -114,13 +115,18 @@ int CNetServer::Recv(CNetChunk *pChunk)
 			char aBuf[128];
 			if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
 			{
-				// banned, reply with a message
-				CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1);
+				// banned, reply with a message unless the address is flooding us
+				if(m_RateLimit.Allow(&Addr, CNetRateLimit::TYPE_CONNLESS))
+					CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1);
 				continue;
 			}
 
 			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
 			{
+				// connless requests can come from spoofed addresses, don't answer floods
+				if(!m_RateLimit.Allow(&Addr, CNetRateLimit::TYPE_CONNLESS))
+					continue;
+
 				pChunk->m_Flags = NETSENDFLAG_CONNLESS;
 				pChunk->m_ClientID = -1;
 				pChunk->m_Address = Addr;
@@ -133,6 +139,9 @@ int CNetServer::Recv(CNetChunk *pChunk)
 				// TODO: check size here
 				if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL && m_RecvUnpacker.m_Data.m_aChunkData[0] == NET_CTRLMSG_CONNECT)
 				{
+					if(!m_RateLimit.Allow(&Addr, CNetRateLimit::TYPE_CONNECT))
+						continue;
+
 					bool Found = false;
 
 					// check if we already got this client
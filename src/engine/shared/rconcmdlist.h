@@ -0,0 +1,25 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef ENGINE_SHARED_RCONCMDLIST_H
+#define ENGINE_SHARED_RCONCMDLIST_H
+
+#include "protocol.h"
+
+/*
+	the packed rcon command list. protocol.h is hashed into the net version,
+	so the extension lives here to keep stock 0.6 clients and servers compatible
+*/
+enum
+{
+	NETMSG_RCON_CMD_LIST=NETMSG_RCON_CMD_REM+1, // several commands at once, only sent to clients that asked for it
+};
+
+// cmdlist field of NETMSG_RCON_AUTH
+enum
+{
+	RCON_CMDLIST_NONE=0,
+	RCON_CMDLIST_SINGLE,	// one NETMSG_RCON_CMD_ADD per command, stock clients
+	RCON_CMDLIST_PACKED,	// NETMSG_RCON_CMD_LIST
+};
+
+#endif
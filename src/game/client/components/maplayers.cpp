@@ -25,6 +25,12 @@ CMapLayers::CMapLayers(int t)
 	m_CurrentLocalTick = 0;
 	m_LastLocalTick = 0;
 	m_EnvelopeUpdate = false;
+	m_pBatches = 0;
+}
+
+CMapLayers::~CMapLayers()
+{
+	delete [] m_pBatches;
 }
 
 void CMapLayers::OnInit()
@@ -32,6 +38,45 @@ void CMapLayers::OnInit()
 	m_pLayers = Layers();
 }
 
+void CMapLayers::OnMapLoad()
+{
+	delete [] m_pBatches;
+	m_pBatches = new CTilemapBatch[m_pLayers->NumLayers()];
+
+	// the tileset scale only depends on the resolution, the camera position doesn't matter
+	float aPoints[4];
+	RenderTools()->MapscreenToWorld(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, Graphics()->ScreenAspect(), 1.0f, aPoints);
+	float TilesetScale = RenderTools()->TilesetScale(32.0f, aPoints[2]-aPoints[0]);
+
+	// build the same layers OnRender draws
+	bool PassedGameLayer = false;
+	for(int g = 0; g < m_pLayers->NumGroups(); g++)
+	{
+		CMapItemGroup *pGroup = m_pLayers->GetGroup(g);
+		for(int l = 0; l < pGroup->m_NumLayers; l++)
+		{
+			CMapItemLayer *pLayer = m_pLayers->GetLayer(pGroup->m_StartLayer+l);
+			if(pLayer == (CMapItemLayer*)m_pLayers->GameLayer())
+			{
+				PassedGameLayer = true;
+				continue;
+			}
+
+			if(m_Type == TYPE_BACKGROUND && PassedGameLayer)
+				return;
+			if(pLayer->m_Type != LAYERTYPE_TILES || (m_Type == TYPE_FOREGROUND && !PassedGameLayer))
+				continue;
+			// skipped detail layers get their batch on the first render with gfx_high_detail
+			if(pLayer->m_Flags&LAYERFLAG_DETAIL && !g_Config.m_GfxHighDetail)
+				continue;
+
+			CMapItemLayerTilemap *pTMap = (CMapItemLayerTilemap *)pLayer;
+			CTile *pTiles = (CTile *)m_pLayers->Map()->GetData(pTMap->m_Data);
+			RenderTools()->BuildTilemapBatch(&m_pBatches[pGroup->m_StartLayer+l], pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, TilesetScale);
+		}
+	}
+}
+
 void CMapLayers::EnvelopeUpdate()
 {
 	if(Client()->State() == IClient::STATE_DEMOPLAYBACK)
@@ -217,10 +262,11 @@ void CMapLayers::OnRender()
 					CTile *pTiles = (CTile *)m_pLayers->Map()->GetData(pTMap->m_Data);
 					Graphics()->BlendNone();
 					vec4 Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f);
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+					CTilemapBatch *pBatch = &m_pBatches[pGroup->m_StartLayer+l];
+					RenderTools()->RenderTilemapBatch(pBatch, pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
 													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 					Graphics()->BlendNormal();
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+					RenderTools()->RenderTilemapBatch(pBatch, pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
 													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
 				}
 				else if(pLayer->m_Type == LAYERTYPE_QUADS)
@@ -11,6 +11,7 @@ class CMapLayers : public CComponent
 	int m_CurrentLocalTick;
 	int m_LastLocalTick;
 	bool m_EnvelopeUpdate;
+	class CTilemapBatch *m_pBatches; // one per layer of the map, only the tile layers we render are built
 
 	void MapScreenToGroup(float CenterX, float CenterY, CMapItemGroup *pGroup);
 	static void EnvelopeEval(float TimeOffset, int Env, float *pChannels, void *pUser);
@@ -22,7 +23,9 @@ public:
 	};
 
 	CMapLayers(int Type);
+	~CMapLayers();
 	virtual void OnInit();
+	virtual void OnMapLoad();
 	virtual void OnRender();
 
 	void EnvelopeUpdate();
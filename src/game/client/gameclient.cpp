@@ -85,12 +85,34 @@ static CMapLayers gs_MapLayersBackGround(CMapLayers::TYPE_BACKGROUND);
 static CMapLayers gs_MapLayersForeGround(CMapLayers::TYPE_FOREGROUND);
 
 CGameClient::CStack::CStack() { m_Num = 0; }
-void CGameClient::CStack::Add(class CComponent *pComponent) { m_paComponents[m_Num++] = pComponent; }
+void CGameClient::CStack::Add(class CComponent *pComponent, const char *pName)
+{
+	m_paComponents[m_Num] = pComponent;
+	m_apNames[m_Num] = pName;
+	m_aRenderTime[m_Num] = 0;
+	m_Num++;
+}
 
 const char *CGameClient::Version() { return GAME_VERSION; }
 const char *CGameClient::NetVersion() { return GAME_NETVERSION; }
 const char *CGameClient::GetItemName(int Type) { return m_NetObjHandler.GetObjName(Type); }
 
+void CGameClient::PrintBenchmark(int NumFrames, int64 TotalTime)
+{
+	int64 Freq = time_freq();
+	for(int i = 0; i < m_All.m_Num; i++)
+	{
+		// components that take less than a microsecond per frame only clutter the report
+		if(m_All.m_aRenderTime[i]*1000000 < Freq*NumFrames)
+			continue;
+
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "  %-22s %8.3f ms/frame %5.1f%%", m_All.m_apNames[i],
+			m_All.m_aRenderTime[i]*1000.0/Freq/NumFrames, m_All.m_aRenderTime[i]*100.0/TotalTime);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "benchmark", aBuf);
+	}
+}
+
 void CGameClient::OnConsoleInit()
 {
 	m_pEngine = Kernel()->RequestInterface<IEngine>();
@@ -129,38 +151,38 @@ void CGameClient::OnConsoleInit()
 	m_pMapLayersForeGround = &::gs_MapLayersForeGround;
 
 	// make a list of all the systems, make sure to add them in the corrent render order
-	m_All.Add(m_pSkins);
-	m_All.Add(m_pCountryFlags);
-	m_All.Add(m_pMapimages);
-	m_All.Add(m_pEffects); // doesn't render anything, just updates effects
-	m_All.Add(m_pParticles);
-	m_All.Add(m_pBinds);
-	m_All.Add(m_pControls);
-	m_All.Add(m_pCamera);
-	m_All.Add(m_pSounds);
-	m_All.Add(m_pVoting);
-	m_All.Add(m_pParticles); // doesn't render anything, just updates all the particles
-
-	m_All.Add(&gs_MapLayersBackGround); // first to render
-	m_All.Add(&m_pParticles->m_RenderTrail);
-	m_All.Add(m_pItems);
-	m_All.Add(&gs_Players);
-	m_All.Add(&gs_MapLayersForeGround);
-	m_All.Add(&m_pParticles->m_RenderExplosions);
-	m_All.Add(&gs_NamePlates);
-	m_All.Add(&m_pParticles->m_RenderGeneral);
-	m_All.Add(m_pDamageind);
-	m_All.Add(&gs_Hud);
-	m_All.Add(&gs_Spectator);
-	m_All.Add(&gs_Emoticon);
-	m_All.Add(&gs_KillMessages);
-	m_All.Add(m_pChat);
-	m_All.Add(&gs_Broadcast);
-	m_All.Add(&gs_DebugHud);
-	m_All.Add(&gs_Scoreboard);
-	m_All.Add(m_pMotd);
-	m_All.Add(m_pMenus);
-	m_All.Add(m_pGameConsole);
+	m_All.Add(m_pSkins, "skins");
+	m_All.Add(m_pCountryFlags, "country flags");
+	m_All.Add(m_pMapimages, "map images");
+	m_All.Add(m_pEffects, "effects"); // doesn't render anything, just updates effects
+	m_All.Add(m_pParticles, "particles update");
+	m_All.Add(m_pBinds, "binds");
+	m_All.Add(m_pControls, "controls");
+	m_All.Add(m_pCamera, "camera");
+	m_All.Add(m_pSounds, "sounds");
+	m_All.Add(m_pVoting, "voting");
+	m_All.Add(m_pParticles, "particles update 2"); // doesn't render anything, just updates all the particles
+
+	m_All.Add(&gs_MapLayersBackGround, "map background"); // first to render
+	m_All.Add(&m_pParticles->m_RenderTrail, "particle trails");
+	m_All.Add(m_pItems, "items");
+	m_All.Add(&gs_Players, "players");
+	m_All.Add(&gs_MapLayersForeGround, "map foreground");
+	m_All.Add(&m_pParticles->m_RenderExplosions, "explosions");
+	m_All.Add(&gs_NamePlates, "name plates");
+	m_All.Add(&m_pParticles->m_RenderGeneral, "particles");
+	m_All.Add(m_pDamageind, "damage indicators");
+	m_All.Add(&gs_Hud, "hud");
+	m_All.Add(&gs_Spectator, "spectator");
+	m_All.Add(&gs_Emoticon, "emoticon");
+	m_All.Add(&gs_KillMessages, "kill messages");
+	m_All.Add(m_pChat, "chat");
+	m_All.Add(&gs_Broadcast, "broadcast");
+	m_All.Add(&gs_DebugHud, "debug hud");
+	m_All.Add(&gs_Scoreboard, "scoreboard");
+	m_All.Add(m_pMotd, "motd");
+	m_All.Add(m_pMenus, "menus");
+	m_All.Add(m_pGameConsole, "console");
 
 	// build the input stack
 	m_Input.Add(&m_pMenus->m_Binder); // this will take over all input when we want to bind a key
@@ -441,8 +463,20 @@ void CGameClient::OnRender()
 	DispatchInput();
 
 	// render all systems
-	for(int i = 0; i < m_All.m_Num; i++)
-		m_All.m_paComponents[i]->OnRender();
+	if(g_Config.m_ClBenchmark[0])
+	{
+		for(int i = 0; i < m_All.m_Num; i++)
+		{
+			int64 Start = time_get();
+			m_All.m_paComponents[i]->OnRender();
+			m_All.m_aRenderTime[i] += time_get()-Start;
+		}
+	}
+	else
+	{
+		for(int i = 0; i < m_All.m_Num; i++)
+			m_All.m_paComponents[i]->OnRender();
+	}
 
 	// clear new tick flags
 	m_NewTick = false;
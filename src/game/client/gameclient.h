@@ -21,9 +21,11 @@ class CGameClient : public IGameClient
 		};
 
 		CStack();
-		void Add(class CComponent *pComponent);
+		void Add(class CComponent *pComponent, const char *pName = 0);
 
 		class CComponent *m_paComponents[MAX_COMPONENTS];
+		const char *m_apNames[MAX_COMPONENTS];
+		int64 m_aRenderTime[MAX_COMPONENTS]; // only measured with cl_benchmark
 		int m_Num;
 	};
 
@@ -215,6 +217,7 @@ public:
 	virtual const char *GetItemName(int Type);
 	virtual const char *Version();
 	virtual const char *NetVersion();
+	virtual void PrintBenchmark(int NumFrames, int64 TotalTime);
 
 
 	// actions
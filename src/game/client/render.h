@@ -4,6 +4,7 @@
 #define GAME_CLIENT_RENDER_H
 
 #include <base/vmath.h>
+#include <engine/graphics.h>
 #include <game/mapitems.h>
 #include "ui.h"
 
@@ -41,6 +42,30 @@ enum
 
 typedef void (*ENVELOPE_EVAL)(float TimeOffset, int Env, float *pChannels, void *pUser);
 
+// the quads of a tile layer, built once so that rendering only has to copy
+// the visible rows instead of working out every tile each frame
+class CTilemapBatch
+{
+public:
+	enum
+	{
+		PART_OPAQUE=0, // tiles with TILEFLAG_OPAQUE
+		PART_TRANSPARENT,
+		NUM_PARTS
+	};
+
+	IGraphics::CQuadVertex *m_apVertices[NUM_PARTS]; // 4 per tile, row by row
+	int *m_apRowStart[NUM_PARTS]; // first tile of each row, followed by the number of tiles
+	int m_Height;
+	float m_TilesetScale; // the texture coordinates are nudged for the mipmap level
+
+	CTilemapBatch();
+	~CTilemapBatch();
+
+	void Clear();
+	bool Built() const { return m_apRowStart[0] != 0; }
+};
+
 class CRenderTools
 {
 public:
@@ -73,6 +98,10 @@ public:
 	static void RenderEvalEnvelope(CEnvPoint *pPoints, int NumPoints, int Channels, float Time, float *pResult);
 	void RenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser);
 	void RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	// same as RenderTilemap, but draws the prebuilt quads of the batch. it is (re)built when the tileset scale changes
+	void RenderTilemapBatch(CTilemapBatch *pBatch, CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	void BuildTilemapBatch(CTilemapBatch *pBatch, CTile *pTiles, int w, int h, float Scale, float TilesetScale);
+	float TilesetScale(float Scale, float ScreenWidth) const; // ScreenWidth in world units
 
 	// helpers
 	void MapscreenToWorld(float CenterX, float CenterY, float ParallaxX, float ParallaxY,
@@ -163,6 +163,70 @@ void CRenderTools::RenderQuads(CQuad *pQuads, int NumQuads, int RenderFlags, ENV
 	Graphics()->QuadsEnd();
 }
 
+// texture coordinates of the four corners of a tile
+static void TileTexCoords(int Index, int Flags, float Nudge, float Frac, float *pCoords)
+{
+	float TexSize = 1024.0f;
+	int tx = Index%16;
+	int ty = Index/16;
+	int Px0 = tx*(1024/16);
+	int Py0 = ty*(1024/16);
+	int Px1 = Px0+(1024/16)-1;
+	int Py1 = Py0+(1024/16)-1;
+
+	float x0 = Nudge + Px0/TexSize+Frac;
+	float y0 = Nudge + Py0/TexSize+Frac;
+	float x1 = Nudge + Px1/TexSize-Frac;
+	float y1 = Nudge + Py0/TexSize+Frac;
+	float x2 = Nudge + Px1/TexSize-Frac;
+	float y2 = Nudge + Py1/TexSize-Frac;
+	float x3 = Nudge + Px0/TexSize+Frac;
+	float y3 = Nudge + Py1/TexSize-Frac;
+
+	if(Flags&TILEFLAG_VFLIP)
+	{
+		x0 = x2;
+		x1 = x3;
+		x2 = x3;
+		x3 = x0;
+	}
+
+	if(Flags&TILEFLAG_HFLIP)
+	{
+		y0 = y3;
+		y2 = y1;
+		y3 = y1;
+		y1 = y0;
+	}
+
+	if(Flags&TILEFLAG_ROTATE)
+	{
+		float Tmp = x0;
+		x0 = x3;
+		x3 = x2;
+		x2 = x1;
+		x1 = Tmp;
+		Tmp = y0;
+		y0 = y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = Tmp;
+	}
+
+	pCoords[0] = x0; pCoords[1] = y0;
+	pCoords[2] = x1; pCoords[3] = y1;
+	pCoords[4] = x2; pCoords[5] = y2;
+	pCoords[6] = x3; pCoords[7] = y3;
+}
+
+float CRenderTools::TilesetScale(float Scale, float ScreenWidth) const
+{
+	// calculate the final pixelsize for the tiles
+	float TilePixelSize = 1024/32.0f;
+	float FinalTileSize = Scale/ScreenWidth * Graphics()->ScreenWidth();
+	return FinalTileSize/TilePixelSize;
+}
+
 void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
 									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
 {
@@ -171,10 +235,7 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
 	//Graphics()->MapScreen(screen_x0-50, screen_y0-50, screen_x1+50, screen_y1+50);
 
-	// calculate the final pixelsize for the tiles
-	float TilePixelSize = 1024/32.0f;
-	float FinalTileSize = Scale/(ScreenX1-ScreenX0) * Graphics()->ScreenWidth();
-	float FinalTilesetScale = FinalTileSize/TilePixelSize;
+	float FinalTilesetScale = TilesetScale(Scale, ScreenX1-ScreenX0);
 
 	float r=1, g=1, b=1, a=1;
 	if(ColorEnv >= 0)
@@ -250,54 +311,9 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 
 				if(Render)
 				{
-
-					int tx = Index%16;
-					int ty = Index/16;
-					int Px0 = tx*(1024/16);
-					int Py0 = ty*(1024/16);
-					int Px1 = Px0+(1024/16)-1;
-					int Py1 = Py0+(1024/16)-1;
-
-					float x0 = Nudge + Px0/TexSize+Frac;
-					float y0 = Nudge + Py0/TexSize+Frac;
-					float x1 = Nudge + Px1/TexSize-Frac;
-					float y1 = Nudge + Py0/TexSize+Frac;
-					float x2 = Nudge + Px1/TexSize-Frac;
-					float y2 = Nudge + Py1/TexSize-Frac;
-					float x3 = Nudge + Px0/TexSize+Frac;
-					float y3 = Nudge + Py1/TexSize-Frac;
-
-					if(Flags&TILEFLAG_VFLIP)
-					{
-						x0 = x2;
-						x1 = x3;
-						x2 = x3;
-						x3 = x0;
-					}
-
-					if(Flags&TILEFLAG_HFLIP)
-					{
-						y0 = y3;
-						y2 = y1;
-						y3 = y1;
-						y1 = y0;
-					}
-
-					if(Flags&TILEFLAG_ROTATE)
-					{
-						float Tmp = x0;
-						x0 = x3;
-						x3 = x2;
-						x2 = x1;
-						x1 = Tmp;
-						Tmp = y0;
-						y0 = y3;
-						y3 = y2;
-						y2 = y1;
-						y1 = Tmp;
- 					}
-
-					Graphics()->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3);
+					float aCoords[8];
+					TileTexCoords(Index, Flags, Nudge, Frac, aCoords);
+					Graphics()->QuadsSetSubsetFree(aCoords[0], aCoords[1], aCoords[2], aCoords[3], aCoords[4], aCoords[5], aCoords[6], aCoords[7]);
 					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
 					Graphics()->QuadsDrawTL(&QuadItem, 1);
 				}
@@ -308,3 +324,196 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	Graphics()->QuadsEnd();
 	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
 }
+
+CTilemapBatch::CTilemapBatch()
+{
+	mem_zero(m_apVertices, sizeof(m_apVertices));
+	mem_zero(m_apRowStart, sizeof(m_apRowStart));
+	m_Height = 0;
+	m_TilesetScale = 0.0f;
+}
+
+CTilemapBatch::~CTilemapBatch()
+{
+	Clear();
+}
+
+void CTilemapBatch::Clear()
+{
+	for(int p = 0; p < NUM_PARTS; p++)
+	{
+		mem_free(m_apVertices[p]);
+		m_apVertices[p] = 0;
+		mem_free(m_apRowStart[p]);
+		m_apRowStart[p] = 0;
+	}
+	m_Height = 0;
+}
+
+void CRenderTools::BuildTilemapBatch(CTilemapBatch *pBatch, CTile *pTiles, int w, int h, float Scale, float TilesetScale)
+{
+	pBatch->Clear();
+
+	int aNumTiles[CTilemapBatch::NUM_PARTS] = {0};
+	for(int i = 0; i < w*h; i++)
+	{
+		if(pTiles[i].m_Index)
+			aNumTiles[pTiles[i].m_Flags&TILEFLAG_OPAQUE ? CTilemapBatch::PART_OPAQUE : CTilemapBatch::PART_TRANSPARENT]++;
+	}
+
+	for(int p = 0; p < CTilemapBatch::NUM_PARTS; p++)
+	{
+		pBatch->m_apVertices[p] = (IGraphics::CQuadVertex *)mem_alloc(max(aNumTiles[p], 1)*4*sizeof(IGraphics::CQuadVertex), 1);
+		pBatch->m_apRowStart[p] = (int *)mem_alloc((h+1)*sizeof(int), 1);
+		aNumTiles[p] = 0;
+	}
+
+	// same texture shift as RenderTilemap
+	float TexSize = 1024.0f;
+	float Frac = (1.25f/TexSize) * (1/TilesetScale);
+	float Nudge = (0.5f/TexSize) * (1/TilesetScale);
+
+	for(int y = 0; y < h; y++)
+	{
+		for(int p = 0; p < CTilemapBatch::NUM_PARTS; p++)
+			pBatch->m_apRowStart[p][y] = aNumTiles[p];
+
+		for(int x = 0; x < w; x++)
+		{
+			const CTile *pTile = &pTiles[y*w+x];
+			if(!pTile->m_Index)
+				continue;
+
+			int Part = pTile->m_Flags&TILEFLAG_OPAQUE ? CTilemapBatch::PART_OPAQUE : CTilemapBatch::PART_TRANSPARENT;
+			IGraphics::CQuadVertex *pQuad = &pBatch->m_apVertices[Part][aNumTiles[Part]*4];
+			aNumTiles[Part]++;
+
+			float aCoords[8];
+			TileTexCoords(pTile->m_Index, pTile->m_Flags, Nudge, Frac, aCoords);
+			for(int i = 0; i < 4; i++)
+			{
+				pQuad[i].m_X = (x + (i == 1 || i == 2)) * Scale;
+				pQuad[i].m_Y = (y + (i >= 2)) * Scale;
+				pQuad[i].m_U = aCoords[i*2];
+				pQuad[i].m_V = aCoords[i*2+1];
+			}
+		}
+	}
+
+	for(int p = 0; p < CTilemapBatch::NUM_PARTS; p++)
+		pBatch->m_apRowStart[p][h] = aNumTiles[p];
+	pBatch->m_Height = h;
+	pBatch->m_TilesetScale = TilesetScale;
+}
+
+void CRenderTools::RenderTilemapBatch(CTilemapBatch *pBatch, CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
+									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	// the screen width differs by rounding errors with the camera position, only rebuild when the zoom or resolution changed
+	float FinalTilesetScale = TilesetScale(Scale, ScreenX1-ScreenX0);
+	if(!pBatch->Built() || pBatch->m_Height != h || absolute(pBatch->m_TilesetScale-FinalTilesetScale) > FinalTilesetScale/100.0f)
+		BuildTilemapBatch(pBatch, pTiles, w, h, Scale, FinalTilesetScale);
+
+	float r=1, g=1, b=1, a=1;
+	if(ColorEnv >= 0)
+	{
+		float aChannels[4];
+		pfnEval(ColorEnvOffset/1000.0f, ColorEnv, aChannels, pUser);
+		r = aChannels[0];
+		g = aChannels[1];
+		b = aChannels[2];
+		a = aChannels[3];
+	}
+
+	// opaque tiles are drawn with the transparent ones while the layer is faded out
+	bool Opaque = Color.a*a > 254.0f/255.0f;
+	bool aDrawPart[CTilemapBatch::NUM_PARTS];
+	aDrawPart[CTilemapBatch::PART_OPAQUE] = Opaque ? RenderFlags&LAYERRENDERFLAG_OPAQUE : RenderFlags&LAYERRENDERFLAG_TRANSPARENT;
+	aDrawPart[CTilemapBatch::PART_TRANSPARENT] = RenderFlags&LAYERRENDERFLAG_TRANSPARENT;
+
+	Graphics()->QuadsBegin();
+	Graphics()->SetColor(Color.r*r, Color.g*g, Color.b*b, Color.a*a);
+
+	int StartY = (int)(ScreenY0/Scale)-1;
+	int StartX = (int)(ScreenX0/Scale)-1;
+	int EndY = (int)(ScreenY1/Scale)+1;
+	int EndX = (int)(ScreenX1/Scale)+1;
+
+	// the visible part of each row is one run of quads in the batch
+	for(int p = 0; p < CTilemapBatch::NUM_PARTS; p++)
+	{
+		if(!aDrawPart[p])
+			continue;
+
+		const IGraphics::CQuadVertex *pVertices = pBatch->m_apVertices[p];
+		const int *pRowStart = pBatch->m_apRowStart[p];
+		for(int y = max(StartY, 0); y < min(EndY, h); y++)
+		{
+			// the tiles of a row are sorted by x
+			int First = pRowStart[y];
+			int Last = pRowStart[y+1];
+			int Lo = First, Hi = Last;
+			while(Lo < Hi)
+			{
+				int Mid = (Lo+Hi)/2;
+				if(pVertices[Mid*4].m_X < StartX*Scale)
+					Lo = Mid+1;
+				else
+					Hi = Mid;
+			}
+			First = Lo;
+			Hi = Last;
+			while(Lo < Hi)
+			{
+				int Mid = (Lo+Hi)/2;
+				if(pVertices[Mid*4].m_X < EndX*Scale)
+					Lo = Mid+1;
+				else
+					Hi = Mid;
+			}
+
+			if(Lo > First)
+				Graphics()->QuadsDrawVertices(&pVertices[First*4], Lo-First);
+		}
+	}
+
+	// the border tiles that are repeated outside of the map aren't in the batch
+	if(RenderFlags&TILERENDERFLAG_EXTEND && (StartX < 0 || StartY < 0 || EndX > w || EndY > h))
+	{
+		float TexSize = 1024.0f;
+		float Frac = (1.25f/TexSize) * (1/FinalTilesetScale);
+		float Nudge = (0.5f/TexSize) * (1/FinalTilesetScale);
+
+		for(int y = StartY; y < EndY; y++)
+			for(int x = StartX; x < EndX; x++)
+			{
+				if(y >= 0 && y < h && x >= 0 && x < w)
+				{
+					x = w-1;
+					continue;
+				}
+
+				int mx = clamp(x, 0, w-1);
+				int my = clamp(y, 0, h-1);
+				const CTile *pTile = &pTiles[mx + my*w];
+				if(!pTile->m_Index)
+					continue;
+
+				int Part = pTile->m_Flags&TILEFLAG_OPAQUE ? CTilemapBatch::PART_OPAQUE : CTilemapBatch::PART_TRANSPARENT;
+				if(!aDrawPart[Part])
+					continue;
+
+				float aCoords[8];
+				TileTexCoords(pTile->m_Index, pTile->m_Flags, Nudge, Frac, aCoords);
+				Graphics()->QuadsSetSubsetFree(aCoords[0], aCoords[1], aCoords[2], aCoords[3], aCoords[4], aCoords[5], aCoords[6], aCoords[7]);
+				IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
+				Graphics()->QuadsDrawTL(&QuadItem, 1);
+			}
+	}
+
+	Graphics()->QuadsEnd();
+	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
+}
@@ -14,54 +14,169 @@
 
 CCollision::CCollision()
 {
-	m_pTiles = 0;
+	m_pBits = 0;
 	m_Width = 0;
 	m_Height = 0;
+	m_PaddedWidth = 0;
+	m_PaddedHeight = 0;
+	m_RowWords = 0;
+	m_RowStride = 0;
 	m_pLayers = 0;
 }
 
-void CCollision::Init(class CLayers *pLayers)
+CCollision::~CCollision()
+{
+	if(m_pBits)
+		mem_free(m_pBits);
+}
+
+void CCollision::SetFlags(int px, int py, int Flags)
+{
+	unsigned *pRow = m_pBits + py*m_RowStride + (px>>5);
+	unsigned Mask = 1u<<(px&31);
+	if(Flags&COLFLAG_SOLID)
+		pRow[PLANE_SOLID*m_RowWords] |= Mask;
+	if(Flags&COLFLAG_DEATH)
+		pRow[PLANE_DEATH*m_RowWords] |= Mask;
+	if(Flags&COLFLAG_NOHOOK)
+		pRow[PLANE_NOHOOK*m_RowWords] |= Mask;
+}
+
+void CCollision::InitSize(class CLayers *pLayers)
 {
 	m_pLayers = pLayers;
 	m_Width = m_pLayers->GameLayer()->m_Width;
 	m_Height = m_pLayers->GameLayer()->m_Height;
-	m_pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->GameLayer()->m_Data));
 
-	for(int i = 0; i < m_Width*m_Height; i++)
-	{
-		int Index = m_pTiles[i].m_Index;
+	m_PaddedWidth = m_Width+BORDER*2;
+	m_PaddedHeight = m_Height+BORDER*2;
+	m_RowWords = (m_PaddedWidth+31)/32;
+	m_RowStride = m_RowWords*NUM_PLANES;
+
+	if(m_pBits)
+		mem_free(m_pBits);
+	m_pBits = static_cast<unsigned *>(mem_alloc(BitsSize(), sizeof(unsigned)));
+}
 
-		if(Index > 128)
-			continue;
+void CCollision::Init(class CLayers *pLayers)
+{
+	InitSize(pLayers);
+	mem_zero(m_pBits, BitsSize());
+	CTile *pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->GameLayer()->m_Data));
 
-		switch(Index)
+	// the map data itself stays untouched, the border repeats the outermost tiles
+	for(int py = 0; py < m_PaddedHeight; py++)
+	{
+		int y = clamp(py-BORDER, 0, m_Height-1);
+		for(int px = 0; px < m_PaddedWidth; px++)
 		{
-		case TILE_DEATH:
-			m_pTiles[i].m_Index = COLFLAG_DEATH;
-			break;
-		case TILE_SOLID:
-			m_pTiles[i].m_Index = COLFLAG_SOLID;
-			break;
-		case TILE_NOHOOK:
-			m_pTiles[i].m_Index = COLFLAG_SOLID|COLFLAG_NOHOOK;
-			break;
-		default:
-			m_pTiles[i].m_Index = 0;
+			int x = clamp(px-BORDER, 0, m_Width-1);
+			switch(pTiles[y*m_Width+x].m_Index)
+			{
+			case TILE_DEATH:
+				SetFlags(px, py, COLFLAG_DEATH);
+				break;
+			case TILE_SOLID:
+				SetFlags(px, py, COLFLAG_SOLID);
+				break;
+			case TILE_NOHOOK:
+				SetFlags(px, py, COLFLAG_SOLID|COLFLAG_NOHOOK);
+				break;
+			}
 		}
 	}
 }
 
+bool CCollision::Init(class CLayers *pLayers, const unsigned *pBits, int Size)
+{
+	InitSize(pLayers);
+	if(Size != BitsSize())
+		return false;
+	mem_copy(m_pBits, pBits, Size);
+	return true;
+}
+
+int CCollision::PadTileX(int tx) const
+{
+	int px = tx+BORDER;
+	if((unsigned)px >= (unsigned)m_PaddedWidth)
+		px = px < 0 ? 0 : m_PaddedWidth-1;
+	return px;
+}
+
+int CCollision::PadTileY(int ty) const
+{
+	int py = ty+BORDER;
+	if((unsigned)py >= (unsigned)m_PaddedHeight)
+		py = py < 0 ? 0 : m_PaddedHeight-1;
+	return py;
+}
+
 int CCollision::GetTile(int x, int y)
 {
-	int Nx = clamp(x/32, 0, m_Width-1);
-	int Ny = clamp(y/32, 0, m_Height-1);
+	int px = PadX(x);
+	int py = PadY(y);
 
-	return m_pTiles[Ny*m_Width+Nx].m_Index > 128 ? 0 : m_pTiles[Ny*m_Width+Nx].m_Index;
+	int Flags = 0;
+	if(TestBit(PLANE_SOLID, px, py))
+		Flags |= COLFLAG_SOLID;
+	if(TestBit(PLANE_DEATH, px, py))
+		Flags |= COLFLAG_DEATH;
+	if(TestBit(PLANE_NOHOOK, px, py))
+		Flags |= COLFLAG_NOHOOK;
+	return Flags;
 }
 
 bool CCollision::IsTileSolid(int x, int y)
 {
-	return GetTile(x, y)&COLFLAG_SOLID;
+	return TestBit(PLANE_SOLID, PadX(x), PadY(y));
+}
+
+bool CCollision::FirstSolidInRow(int ty, int tx0, int tx1, int *pOutTx)
+{
+	if(tx0 > tx1)
+		return false;
+
+	int px0 = PadTileX(tx0);
+	int px1 = PadTileX(tx1);
+	const unsigned *pRow = m_pBits + PadTileY(ty)*m_RowStride + PLANE_SOLID*m_RowWords;
+	for(int w = px0>>5; w <= px1>>5; w++)
+	{
+		unsigned Bits = pRow[w];
+		if(w == px0>>5)
+			Bits &= ~0u<<(px0&31);
+		if(w == px1>>5)
+			Bits &= ~0u>>(31-(px1&31));
+		if(Bits)
+		{
+			int Bit = 0;
+			while(!(Bits&1))
+			{
+				Bits >>= 1;
+				Bit++;
+			}
+
+			// a clamped start column repeats the edge tile, so the start itself is solid
+			int px = w*32+Bit;
+			if(pOutTx)
+				*pOutTx = px == px0 ? tx0 : px-BORDER;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CCollision::IsSolidArea(int tx0, int ty0, int tx1, int ty1)
+{
+	if(ty0 > ty1)
+		return false;
+
+	// rows outside the map repeat the edge row, so only scan each distinct row once
+	int py1 = PadTileY(ty1);
+	for(int py = PadTileY(ty0); py <= py1; py++)
+		if(FirstSolidInRow(py-BORDER, tx0, tx1, 0))
+			return true;
+	return false;
 }
 
 // TODO: rewrite this smarter!
@@ -71,6 +186,10 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 	int End(Distance+1);
 	vec2 Last = Pos0;
 
+	// every sampled point lies within the bounding box of the segment
+	if(Distance > 0.0f && !TestArea(vec2(min(Pos0.x, Pos1.x), min(Pos0.y, Pos1.y)), vec2(max(Pos0.x, Pos1.x), max(Pos0.y, Pos1.y))))
+		End = 0;
+
 	for(int i = 0; i < End; i++)
 	{
 		float a = i/Distance;
@@ -131,9 +250,25 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 	}
 }
 
+bool CCollision::TestArea(vec2 Min, vec2 Max)
+{
+	// one pixel of slack covers rounding of interpolated positions
+	return IsSolidArea(round_to_int(Min.x-1.0f)>>5, round_to_int(Min.y-1.0f)>>5,
+		round_to_int(Max.x+1.0f)>>5, round_to_int(Max.y+1.0f)>>5);
+}
+
 bool CCollision::TestBox(vec2 Pos, vec2 Size)
 {
 	Size *= 0.5f;
+
+	// boxes no larger than a tile touch at most 2x2 tiles, so checking those equals checking the corners
+	int x0 = round_to_int(Pos.x-Size.x)>>5;
+	int y0 = round_to_int(Pos.y-Size.y)>>5;
+	int x1 = round_to_int(Pos.x+Size.x)>>5;
+	int y1 = round_to_int(Pos.y+Size.y)>>5;
+	if(x1-x0 <= 1 && y1-y0 <= 1)
+		return IsSolidArea(x0, y0, x1, y1);
+
 	if(CheckPoint(Pos.x-Size.x, Pos.y-Size.y))
 		return true;
 	if(CheckPoint(Pos.x+Size.x, Pos.y-Size.y))
@@ -158,6 +293,13 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 	{
 		//vec2 old_pos = pos;
 		float Fraction = 1.0f/(float)(Max+1);
+
+		// when nothing solid is near the whole path only the stepping is left to do
+		vec2 Half = Size*0.5f;
+		vec2 End = Pos + Vel;
+		bool Free = !TestArea(vec2(min(Pos.x, End.x), min(Pos.y, End.y))-Half-vec2(1.0f, 1.0f),
+			vec2(max(Pos.x, End.x), max(Pos.y, End.y))+Half+vec2(1.0f, 1.0f));
+
 		for(int i = 0; i <= Max; i++)
 		{
 			//float amount = i/(float)max;
@@ -166,7 +308,7 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 
 			vec2 NewPos = Pos + Vel*Fraction; // TODO: this row is not nice
 
-			if(TestBox(vec2(NewPos.x, NewPos.y), Size))
+			if(!Free && TestBox(vec2(NewPos.x, NewPos.y), Size))
 			{
 				int Hits = 0;
 
@@ -7,11 +7,36 @@
 
 class CCollision
 {
-	class CTile *m_pTiles;
+	enum
+	{
+		// tiles replicated around the map, lookups inside this margin need no clamping
+		BORDER=32,
+
+		PLANE_SOLID=0,
+		PLANE_DEATH,
+		PLANE_NOHOOK,
+		NUM_PLANES
+	};
+
+	// one bit per tile, the planes of a row are stored next to each other
+	unsigned *m_pBits;
 	int m_Width;
 	int m_Height;
+	int m_PaddedWidth;
+	int m_PaddedHeight;
+	int m_RowWords;
+	int m_RowStride;
 	class CLayers *m_pLayers;
 
+	void InitSize(class CLayers *pLayers);
+	void SetFlags(int px, int py, int Flags);
+	int PadTileX(int tx) const;
+	int PadTileY(int ty) const;
+	int PadX(int x) const { return PadTileX(x>>5); }
+	int PadY(int y) const { return PadTileY(y>>5); }
+	bool TestBit(int Plane, int px, int py) const { return (m_pBits[py*m_RowStride+Plane*m_RowWords+(px>>5)]>>(px&31))&1; }
+
+	bool TestArea(vec2 Min, vec2 Max);
 	bool IsTileSolid(int x, int y);
 	int GetTile(int x, int y);
 
@@ -24,7 +49,12 @@ public:
 	};
 
 	CCollision();
+	~CCollision();
 	void Init(class CLayers *pLayers);
+	// restores bitplanes taken from Bits() for the same map, fails if they don't match the game layer
+	bool Init(class CLayers *pLayers, const unsigned *pBits, int Size);
+	const unsigned *Bits() const { return m_pBits; }
+	int BitsSize() const { return m_RowStride*m_PaddedHeight*sizeof(unsigned); }
 	bool CheckPoint(float x, float y) { return IsTileSolid(round_to_int(x), round_to_int(y)); }
 	bool CheckPoint(vec2 Pos) { return CheckPoint(Pos.x, Pos.y); }
 	int GetCollisionAt(float x, float y) { return GetTile(round_to_int(x), round_to_int(y)); }
@@ -34,6 +64,10 @@ public:
 	void MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces);
 	void MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity);
 	bool TestBox(vec2 Pos, vec2 Size);
+
+	// batched queries in tile coordinates, tiles outside the map behave like the nearest edge tile
+	bool FirstSolidInRow(int ty, int tx0, int tx1, int *pOutTx);
+	bool IsSolidArea(int tx0, int ty0, int tx1, int ty1);
 };
 
 #endif
@@ -9,9 +9,19 @@
 CEventHandler::CEventHandler()
 {
 	m_pGameServer = 0;
+	m_EventCapacity = INITIAL_EVENTS;
+	m_pEvents = (CEvent *)mem_alloc(m_EventCapacity*sizeof(CEvent), 1);
+	m_DataCapacity = INITIAL_DATASIZE;
+	m_pData = (char *)mem_alloc(m_DataCapacity, 4);
 	Clear();
 }
 
+CEventHandler::~CEventHandler()
+{
+	mem_free(m_pEvents);
+	mem_free(m_pData);
+}
+
 void CEventHandler::SetGameServer(CGameContext *pGameServer)
 {
 	m_pGameServer = pGameServer;
@@ -21,14 +31,35 @@ void *CEventHandler::Create(int Type, int Size, int Mask)
 {
 	if(m_NumEvents == MAX_EVENTS)
 		return 0;
-	if(m_CurrentOffset+Size >= MAX_DATASIZE)
-		return 0;
 
-	void *p = &m_aData[m_CurrentOffset];
-	m_aOffsets[m_NumEvents] = m_CurrentOffset;
-	m_aTypes[m_NumEvents] = Type;
-	m_aSizes[m_NumEvents] = Size;
-	m_aClientMasks[m_NumEvents] = Mask;
+	// grow the buffers, they keep their size for the following ticks
+	if(m_NumEvents == m_EventCapacity)
+	{
+		CEvent *pEvents = (CEvent *)mem_alloc(m_EventCapacity*2*sizeof(CEvent), 1);
+		mem_copy(pEvents, m_pEvents, m_NumEvents*sizeof(CEvent));
+		mem_free(m_pEvents);
+		m_pEvents = pEvents;
+		m_EventCapacity *= 2;
+	}
+	if(m_CurrentOffset+Size >= m_DataCapacity)
+	{
+		int Capacity = m_DataCapacity*2;
+		while(m_CurrentOffset+Size >= Capacity)
+			Capacity *= 2;
+		char *pData = (char *)mem_alloc(Capacity, 4);
+		mem_copy(pData, m_pData, m_CurrentOffset);
+		mem_free(m_pData);
+		m_pData = pData;
+		m_DataCapacity = Capacity;
+	}
+
+	void *p = &m_pData[m_CurrentOffset];
+	CEvent *pEvent = &m_pEvents[m_NumEvents];
+	pEvent->m_Offset = m_CurrentOffset;
+	pEvent->m_Type = Type;
+	pEvent->m_Size = Size;
+	pEvent->m_ClientMask = Mask;
+	pEvent->m_InterestMask = 0;
 	m_CurrentOffset += Size;
 	m_NumEvents++;
 	return p;
@@ -40,19 +71,34 @@ void CEventHandler::Clear()
 	m_CurrentOffset = 0;
 }
 
+void CEventHandler::PrepareSnap()
+{
+	// decide once which clients get which event instead of in every client's snap
+	for(int i = 0; i < m_NumEvents; i++)
+	{
+		CEvent *pEvent = &m_pEvents[i];
+		CNetEvent_Common *ev = (CNetEvent_Common *)&m_pData[pEvent->m_Offset];
+		vec2 Pos(ev->m_X, ev->m_Y);
+		pEvent->m_InterestMask = 0;
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			CPlayer *pPlayer = GameServer()->m_apPlayers[c];
+			if(pPlayer && CmaskIsSet(pEvent->m_ClientMask, c) && distance(pPlayer->m_ViewPos, Pos) < 1500.0f)
+				pEvent->m_InterestMask |= CmaskOne(c);
+		}
+	}
+}
+
 void CEventHandler::Snap(int SnappingClient)
 {
 	for(int i = 0; i < m_NumEvents; i++)
 	{
-		if(SnappingClient == -1 || CmaskIsSet(m_aClientMasks[i], SnappingClient))
+		const CEvent *pEvent = &m_pEvents[i];
+		if(SnappingClient == -1 || CmaskIsSet(pEvent->m_InterestMask, SnappingClient))
 		{
-			CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(SnappingClient == -1 || distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y)) < 1500.0f)
-			{
-				void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i]);
-				if(d)
-					mem_copy(d, &m_aData[m_aOffsets[i]], m_aSizes[i]);
-			}
+			void *d = GameServer()->Server()->SnapNewItem(pEvent->m_Type, i, pEvent->m_Size);
+			if(d)
+				mem_copy(d, &m_pData[pEvent->m_Offset], pEvent->m_Size);
 		}
 	}
 }
@@ -6,14 +6,24 @@
 //
 class CEventHandler
 {
-	static const int MAX_EVENTS = 128;
-	static const int MAX_DATASIZE = 128*64;
+	// snap item ids are 16 bit
+	static const int MAX_EVENTS = 0x10000;
+	static const int INITIAL_EVENTS = 128;
+	static const int INITIAL_DATASIZE = 128*64;
 
-	int m_aTypes[MAX_EVENTS]; // TODO: remove some of these arrays
-	int m_aOffsets[MAX_EVENTS];
-	int m_aSizes[MAX_EVENTS];
-	int m_aClientMasks[MAX_EVENTS];
-	char m_aData[MAX_DATASIZE];
+	struct CEvent
+	{
+		int m_Type;
+		int m_Offset;
+		int m_Size;
+		int m_ClientMask;
+		int m_InterestMask; // clients that receive the event, set by PrepareSnap
+	};
+
+	CEvent *m_pEvents;
+	int m_EventCapacity;
+	char *m_pData;
+	int m_DataCapacity;
 
 	class CGameContext *m_pGameServer;
 
@@ -24,8 +34,10 @@ public:
 	void SetGameServer(CGameContext *pGameServer);
 
 	CEventHandler();
+	~CEventHandler();
 	void *Create(int Type, int Size, int Mask = -1);
 	void Clear();
+	void PrepareSnap();
 	void Snap(int SnappingClient);
 };
 
@@ -6,7 +6,10 @@
 #include <engine/shared/config.h>
 #include <engine/map.h>
 #include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/moderation.h>
 #include "gamecontext.h"
+#include "mapcache.h"
 #include <game/version.h>
 #include <game/collision.h>
 #include <game/gamecore.h>
@@ -45,9 +48,6 @@ void CGameContext::Construct(int Resetting)
 		m_RankingDb = NULL;
 	}
 	
-	for(int i = 0; i < MAX_MUTES; i++)
-		m_aMutes[i].m_aIP[0] = 0;
-	
 	// zCatch/TeeVi: hard mode
 	m_HardModes.clear();
 	m_HardModes.push_back({"ammo210", false, true});
@@ -725,6 +725,48 @@ void CGameContext::OnClientPredictedInput(int ClientID, void *pInput)
 		m_apPlayers[ClientID]->OnPredictedInput((CNetObj_PlayerInput *)pInput);
 }
 
+// scripted input for the offline simulation benchmark, only depends on the tick and the world
+int CGameContext::OnBenchmarkInput(int ClientID, int *pData)
+{
+	CNetObj_PlayerInput *pInput = (CNetObj_PlayerInput *)pData;
+	mem_zero(pInput, sizeof(*pInput));
+
+	int Tick = Server()->Tick()+ClientID*17;
+	pInput->m_PlayerFlags = PLAYERFLAG_PLAYING;
+	pInput->m_Direction = (Tick/50)%3-1;
+	pInput->m_Jump = (Tick%37) < 3;
+	pInput->m_Hook = (Tick/40)%2;
+	pInput->m_Fire = Tick/10; // odd values hold the trigger
+	if(g_Config.m_SvMode == 2)
+		pInput->m_WantedWeapon = (Tick/200)%NUM_WEAPONS+1;
+
+	// aim at the closest character, circle around otherwise
+	CCharacter *pChr = GetPlayerChar(ClientID);
+	vec2 Target = vec2(cosf(Tick*0.05f), sinf(Tick*0.05f))*100.0f;
+	if(pChr)
+	{
+		float ClosestDist = -1.0f;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			CCharacter *pOther = GetPlayerChar(i);
+			if(!pOther || pOther == pChr)
+				continue;
+			float Dist = distance(pChr->m_Pos, pOther->m_Pos);
+			if(ClosestDist < 0.0f || Dist < ClosestDist)
+			{
+				ClosestDist = Dist;
+				Target = pOther->m_Pos-pChr->m_Pos;
+			}
+		}
+	}
+	pInput->m_TargetX = (int)Target.x;
+	pInput->m_TargetY = (int)Target.y;
+	if(!pInput->m_TargetX && !pInput->m_TargetY)
+		pInput->m_TargetY = -1;
+
+	return sizeof(CNetObj_PlayerInput);
+}
+
 void CGameContext::OnClientEnter(int ClientID)
 {
 	CPlayer *p = m_apPlayers[ClientID];
@@ -835,20 +877,20 @@ void CGameContext::OnClientDrop(int ClientID, const char *pReason)
 // returns whether the player is allowed to chat, informs the player and mutes him if needed
 bool CGameContext::MuteValidation(CPlayer *player)
 {
-	int i, ClientID = player->GetCID();
-	if((i = Muted(ClientID)) > -1)
+	int ClientID = player->GetCID();
+	int Expires = Muted(ClientID);
+	if(Expires > 0)
 	{
 		char aBuf[48];
-		int Expires = (m_aMutes[i].m_Expires - Server()->Tick())/Server()->TickSpeed();
 		str_format(aBuf, sizeof(aBuf), "You are muted for %d:%02d min.", Expires/60, Expires%60);
 		SendChatTarget(ClientID, aBuf);
 		return false;
 	}
-	//mute the player if he's spamming
-	else if(g_Config.m_SvMuteDuration && ((player->m_ChatTicks += g_Config.m_SvChatValue) > g_Config.m_SvChatThreshold))
+	//mute the player if he's spamming, the spam score is kept per address so reconnecting doesn't reset it
+	else if(g_Config.m_SvMuteDuration && Server()->Moderation()->AddChatTicks(Server()->ClientAddr(ClientID), g_Config.m_SvChatValue) > g_Config.m_SvChatThreshold)
 	{
 		AddMute(ClientID, g_Config.m_SvMuteDuration, true);
-		player->m_ChatTicks = 0;
+		Server()->Moderation()->ResetChatTicks(Server()->ClientAddr(ClientID));
 		return false;
 	}
 	return true;
@@ -1574,7 +1616,7 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 		char aOldName[MAX_NAME_LENGTH];
 		str_copy(aOldName, Server()->ClientName(ClientID), sizeof(aOldName));
 		Server()->SetClientName(ClientID, pMsg->m_pName);
-		if(str_comp(aOldName, Server()->ClientName(ClientID)) != 0 && Muted(ClientID) == -1)
+		if(str_comp(aOldName, Server()->ClientName(ClientID)) != 0 && !Muted(ClientID))
 		{
 			char aChatText[256];
 			str_format(aChatText, sizeof(aChatText), "'%s' changed name to '%s'", aOldName, Server()->ClientName(ClientID));
@@ -1663,26 +1705,9 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 	}
 }
 
-void CGameContext::AddMute(const char* pIP, int Secs)
-{
-	int Pos = Muted(pIP);
-	if(Pos > -1)	
-		m_aMutes[Pos].m_Expires = Server()->TickSpeed() * Secs + Server()->Tick();	// overwrite mute
-	else
-		for(int i = 0; i < MAX_MUTES; i++)	// find free slot
-			if(!m_aMutes[i].m_aIP[0])
-			{
-				str_copy(m_aMutes[i].m_aIP, pIP, sizeof(m_aMutes[i].m_aIP));
-				m_aMutes[i].m_Expires = Server()->TickSpeed() * Secs + Server()->Tick();
-				break;
-			}
-}
-
 void CGameContext::AddMute(int ClientID, int Secs, bool Auto)
 {
-	char aAddrStr[NETADDR_MAXSTRSIZE] = {0};
-	Server()->GetClientAddr(ClientID, aAddrStr, sizeof(aAddrStr));
-	AddMute(aAddrStr, Secs);
+	Server()->Moderation()->Set(Server()->ClientAddr(ClientID), CModeration::TYPE_MUTE, Secs);
 	
 	char aBuf[128];
 	if(Secs > 0)
@@ -1693,33 +1718,10 @@ void CGameContext::AddMute(int ClientID, int Secs, bool Auto)
 	SendChatTarget(-1, aBuf);
 }
 
-int CGameContext::Muted(const char *pIP)
-{
-	CleanMutes();
-	int Pos = -1;
-	if(!pIP[0])
-		return -1;
-	for(int i = 0; i < MAX_MUTES; i++)
-		if(!str_comp_num(pIP, m_aMutes[i].m_aIP, sizeof(m_aMutes[i].m_aIP)))
-		{
-			Pos = i;
-			break;
-		}
-	return Pos;
-}
-
+// returns the seconds the client is still muted for
 int CGameContext::Muted(int ClientID)
 {
-	char aIP[NETADDR_MAXSTRSIZE] = {0};
-	Server()->GetClientAddr(ClientID, aIP, sizeof(aIP));
-	return Muted(aIP);
-}
-
-void CGameContext::CleanMutes()
-{
-	for(int i = 0; i < MAX_MUTES; i++)
-		if(m_aMutes[i].m_Expires < Server()->Tick())
-			m_aMutes[i].m_aIP[0] = 0;
+	return Server()->Moderation()->Remaining(Server()->ClientAddr(ClientID), CModeration::TYPE_MUTE);
 }
 
 void CGameContext::ConTuneParam(IConsole::IResult *pResult, void *pUserData)
@@ -2150,15 +2152,14 @@ void CGameContext::ConMutes(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
 	char aBuf[128];
+	char aAddrStr[NETADDR_MAXSTRSIZE];
 	int Sec, Count = 0;
-	pSelf->CleanMutes();
-	for(int i = 0; i < MAX_MUTES; i++)
+	CModeration *pModeration = pSelf->Server()->Moderation();
+	for(const CModeration::CRecord *pRecord = pModeration->First(CModeration::TYPE_MUTE); pRecord; pRecord = pModeration->Next(pRecord, CModeration::TYPE_MUTE))
 	{
-		if(pSelf->m_aMutes[i].m_aIP[0] == 0)
-			continue;
-		
-		Sec = (pSelf->m_aMutes[i].m_Expires - pSelf->Server()->Tick())/pSelf->Server()->TickSpeed();
-		str_format(aBuf, sizeof(aBuf), "#%d: %s for %d:%02d min", i, pSelf->m_aMutes[i].m_aIP, Sec/60, Sec%60);
+		Sec = pModeration->Remaining(pRecord, CModeration::TYPE_MUTE);
+		net_addr_str(&pRecord->m_Addr, aAddrStr, sizeof(aAddrStr), false);
+		str_format(aBuf, sizeof(aBuf), "#%d: %s for %d:%02d min", Count, aAddrStr, Sec/60, Sec%60);
 		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
 		Count++;
 	}
@@ -2183,16 +2184,19 @@ void CGameContext::ConUnmuteIP(IConsole::IResult *pResult, void *pUserData)
 	CGameContext *pSelf = (CGameContext *)pUserData;
 	int MuteID = pResult->GetInteger(0);
 	char aBuf[128];
+	const CModeration::CRecord *pRecord = pSelf->Server()->Moderation()->Get(CModeration::TYPE_MUTE, MuteID);
 	
-	if(MuteID < 0 || MuteID >= MAX_MUTES || pSelf->Muted(pSelf->m_aMutes[MuteID].m_aIP) == -1)
+	if(!pRecord)
 	{
 		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", "mute not found");
 	}
 	else
 	{
-		str_format(aBuf, sizeof(aBuf), "unmuted %s", pSelf->m_aMutes[MuteID].m_aIP);
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(&pRecord->m_Addr, aAddrStr, sizeof(aAddrStr), false);
+		str_format(aBuf, sizeof(aBuf), "unmuted %s", aAddrStr);
 		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "Server", aBuf);
-		pSelf->AddMute(pSelf->m_aMutes[MuteID].m_aIP, 0);
+		pSelf->Server()->Moderation()->Set(&pRecord->m_Addr, CModeration::TYPE_MUTE, 0);
 	}
 }
 
@@ -2268,7 +2272,19 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		Server()->SnapSetStaticsize(i, m_NetObjHandler.GetObjSize(i));
 
 	m_Layers.Init(Kernel());
-	m_Collision.Init(&m_Layers);
+
+	// collision and entities come from the map cache if there is one for this map
+	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+	unsigned MapCrc = Kernel()->RequestInterface<IEngineMap>()->Crc();
+	CMapCache MapCache;
+	if(!g_Config.m_SvMapCache || !MapCache.Load(pStorage, MapCrc, &m_Layers) ||
+		!m_Collision.Init(&m_Layers, MapCache.Bits(), MapCache.BitsSize()))
+	{
+		m_Collision.Init(&m_Layers);
+		MapCache.Build(&m_Layers, &m_Collision);
+		if(g_Config.m_SvMapCache)
+			MapCache.Save(pStorage, MapCrc);
+	}
 
 	// reset everything here
 	//world = new GAMEWORLD;
@@ -2314,30 +2330,11 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 	//	game.players[i].core.world = &game.world.core;
 
 	// create all entities from the game layer
-	CMapItemLayerTilemap *pTileMap = m_Layers.GameLayer();
-	CTile *pTiles = (CTile *)Kernel()->RequestInterface<IMap>()->GetData(pTileMap->m_Data);
-
-
-
-
-	/*
-	num_spawn_points[0] = 0;
-	num_spawn_points[1] = 0;
-	num_spawn_points[2] = 0;
-	*/
-
-	for(int y = 0; y < pTileMap->m_Height; y++)
+	for(int i = 0; i < MapCache.NumEntities(); i++)
 	{
-		for(int x = 0; x < pTileMap->m_Width; x++)
-		{
-			int Index = pTiles[y*pTileMap->m_Width+x].m_Index;
-
-			if(Index >= ENTITY_OFFSET)
-			{
-				vec2 Pos(x*32.0f+16.0f, y*32.0f+16.0f);
-				m_pController->OnEntity(Index-ENTITY_OFFSET, Pos);
-			}
-		}
+		const CMapCache::CEntity *pEntity = &MapCache.Entities()[i];
+		vec2 Pos(pEntity->m_X*32.0f+16.0f, pEntity->m_Y*32.0f+16.0f);
+		m_pController->OnEntity(pEntity->m_Index, Pos);
 	}
 
 	//game.world.insert_entity(game.Controller);
@@ -2384,7 +2381,10 @@ void CGameContext::OnSnap(int ClientID)
 			m_apPlayers[i]->Snap(ClientID);
 	}
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_Events.PrepareSnap();
+}
 void CGameContext::OnPostSnap()
 {
 	m_Events.Clear();
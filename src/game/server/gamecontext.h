@@ -22,7 +22,6 @@
 #include <mutex>
 #include <chrono>
 
-#define MAX_MUTES 35
 #define ZCATCH_VERSION "0.4.8"
 
 /*
@@ -171,18 +170,9 @@ public:
 		CHAT_BLUE=1
 	};
 	
-	struct CMutes
-	{
-		char m_aIP[NETADDR_MAXSTRSIZE];
-		int m_Expires;
-	}; 
-	CMutes m_aMutes[MAX_MUTES];
 	// helper functions
-	void AddMute(const char* pIP, int Secs);
 	void AddMute(int ClientID, int Secs, bool Auto = false);
-	int Muted(const char *pIP);
 	int Muted(int ClientID);
-	void CleanMutes();
 
 	// network
 	void SendChatTarget(int To, const char *pText);
@@ -217,6 +207,7 @@ public:
 	virtual void OnClientDrop(int ClientID, const char *pReason);
 	virtual void OnClientDirectInput(int ClientID, void *pInput);
 	virtual void OnClientPredictedInput(int ClientID, void *pInput);
+	virtual int OnBenchmarkInput(int ClientID, int *pData);
 
 	virtual bool IsClientReady(int ClientID);
 	virtual bool IsClientPlayer(int ClientID);
@@ -0,0 +1,146 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include "mapcache.h"
+
+CMapCache::CMapCache()
+{
+	m_pData = 0;
+	Clear();
+}
+
+CMapCache::~CMapCache()
+{
+	Clear();
+}
+
+void CMapCache::Clear()
+{
+	mem_free(m_pData);
+	m_pData = 0;
+	m_pBits = 0;
+	m_BitsSize = 0;
+	m_pEntities = 0;
+	m_NumEntities = 0;
+}
+
+void CMapCache::GetPath(unsigned Crc, char *pBuf, int BufSize)
+{
+	str_format(pBuf, BufSize, "mapcache/%08x.dat", Crc);
+}
+
+bool CMapCache::Load(IStorage *pStorage, unsigned Crc, CLayers *pLayers)
+{
+	Clear();
+
+	char aPath[64];
+	GetPath(Crc, aPath, sizeof(aPath));
+	IOHANDLE File = pStorage->OpenFile(aPath, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+
+	long int Size = io_length(File);
+	if(Size < (long int)sizeof(CHeader))
+	{
+		io_close(File);
+		return false;
+	}
+	m_pData = (char *)mem_alloc(Size, sizeof(int));
+	bool Read = io_read(File, m_pData, Size) == (unsigned)Size;
+	io_close(File);
+
+	const CHeader *pHeader = (const CHeader *)m_pData;
+	if(!Read || mem_comp(pHeader->m_aID, "MAPC", sizeof(pHeader->m_aID)) != 0 || pHeader->m_Version != VERSION ||
+		pHeader->m_Crc != Crc || pHeader->m_Width != pLayers->GameLayer()->m_Width || pHeader->m_Height != pLayers->GameLayer()->m_Height ||
+		pHeader->m_BitsSize < 0 || pHeader->m_NumEntities < 0 ||
+		Size != (long int)(sizeof(CHeader)+pHeader->m_BitsSize+pHeader->m_NumEntities*sizeof(CEntity)))
+	{
+		dbg_msg("mapcache", "ignoring invalid cache '%s'", aPath);
+		Clear();
+		return false;
+	}
+
+	m_BitsSize = pHeader->m_BitsSize;
+	m_pBits = (const unsigned *)(m_pData+sizeof(CHeader));
+	m_NumEntities = pHeader->m_NumEntities;
+	m_pEntities = (CEntity *)(m_pData+sizeof(CHeader)+m_BitsSize);
+	return true;
+}
+
+void CMapCache::Build(CLayers *pLayers, const CCollision *pCollision)
+{
+	Clear();
+
+	CMapItemLayerTilemap *pTileMap = pLayers->GameLayer();
+	CTile *pTiles = (CTile *)pLayers->Map()->GetData(pTileMap->m_Data);
+	int NumTiles = pTileMap->m_Width*pTileMap->m_Height;
+
+	int NumEntities = 0;
+	for(int i = 0; i < NumTiles; i++)
+	{
+		if(pTiles[i].m_Index >= ENTITY_OFFSET)
+			NumEntities++;
+	}
+
+	// same layout as the file
+	m_BitsSize = pCollision->BitsSize();
+	m_pData = (char *)mem_alloc(sizeof(CHeader)+m_BitsSize+NumEntities*sizeof(CEntity), sizeof(int));
+	CHeader *pHeader = (CHeader *)m_pData;
+	mem_copy(pHeader->m_aID, "MAPC", sizeof(pHeader->m_aID));
+	pHeader->m_Version = VERSION;
+	pHeader->m_Crc = 0;
+	pHeader->m_Width = pTileMap->m_Width;
+	pHeader->m_Height = pTileMap->m_Height;
+	pHeader->m_BitsSize = m_BitsSize;
+	pHeader->m_NumEntities = NumEntities;
+
+	m_pBits = (const unsigned *)(m_pData+sizeof(CHeader));
+	mem_copy(m_pData+sizeof(CHeader), pCollision->Bits(), m_BitsSize);
+
+	m_pEntities = (CEntity *)(m_pData+sizeof(CHeader)+m_BitsSize);
+	for(int y = 0; y < pTileMap->m_Height; y++)
+	{
+		for(int x = 0; x < pTileMap->m_Width; x++)
+		{
+			int Index = pTiles[y*pTileMap->m_Width+x].m_Index;
+			if(Index >= ENTITY_OFFSET)
+			{
+				m_pEntities[m_NumEntities].m_Index = Index-ENTITY_OFFSET;
+				m_pEntities[m_NumEntities].m_X = x;
+				m_pEntities[m_NumEntities].m_Y = y;
+				m_NumEntities++;
+			}
+		}
+	}
+}
+
+bool CMapCache::Save(IStorage *pStorage, unsigned Crc) const
+{
+	if(!m_pData)
+		return false;
+
+	char aPath[64];
+	GetPath(Crc, aPath, sizeof(aPath));
+	pStorage->CreateFolder("mapcache", IStorage::TYPE_SAVE);
+	IOHANDLE File = pStorage->OpenFile(aPath, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("mapcache", "couldn't write '%s'", aPath);
+		return false;
+	}
+
+	CHeader Header = *(const CHeader *)m_pData;
+	Header.m_Crc = Crc;
+	io_write(File, &Header, sizeof(Header));
+	io_write(File, m_pData+sizeof(CHeader), m_BitsSize+m_NumEntities*sizeof(CEntity));
+	io_close(File);
+	return true;
+}
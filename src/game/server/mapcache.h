@@ -0,0 +1,65 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_SERVER_MAPCACHE_H
+#define GAME_SERVER_MAPCACHE_H
+
+/*
+	data derived from the game layer that is expensive to rebuild: the
+	collision bitplanes and the entity tiles. it is stored per map crc in
+	mapcache/ and read back with a single read, so a cached map never has
+	to decompress or scan its game layer again
+*/
+class CMapCache
+{
+public:
+	struct CEntity
+	{
+		int m_Index; // without ENTITY_OFFSET
+		int m_X; // tile coordinates
+		int m_Y;
+	};
+
+private:
+	enum
+	{
+		VERSION=1,
+	};
+
+	struct CHeader
+	{
+		char m_aID[4];
+		int m_Version;
+		unsigned m_Crc;
+		int m_Width;
+		int m_Height;
+		int m_BitsSize;
+		int m_NumEntities;
+	};
+
+	char *m_pData;
+	const unsigned *m_pBits;
+	int m_BitsSize;
+	CEntity *m_pEntities;
+	int m_NumEntities;
+
+	static void GetPath(unsigned Crc, char *pBuf, int BufSize);
+
+public:
+	CMapCache();
+	~CMapCache();
+
+	void Clear();
+
+	// reads the cache of the map, fails if there is none or it doesn't fit the game layer
+	bool Load(class IStorage *pStorage, unsigned Crc, class CLayers *pLayers);
+	// scans the game layer, the collision has to be initialized from the same layers
+	void Build(class CLayers *pLayers, const class CCollision *pCollision);
+	bool Save(class IStorage *pStorage, unsigned Crc) const;
+
+	const unsigned *Bits() const { return m_pBits; }
+	int BitsSize() const { return m_BitsSize; }
+	const CEntity *Entities() const { return m_pEntities; }
+	int NumEntities() const { return m_NumEntities; }
+};
+
+#endif
@@ -32,7 +32,6 @@ CPlayer::CPlayer(CGameContext *pGameServer, int ClientID, int Team)
 	m_LastKillTry = Server()->Tick();
 	m_TicksSpec = 0;
 	m_TicksIngame = 0;
-	m_ChatTicks = 0;
 	
 	// zCatch/TeeVi
 	m_ZCatchVictims = NULL;
@@ -95,9 +94,6 @@ void CPlayer::Tick()
 	else
 		m_TicksIngame++;
 	
-	if(m_ChatTicks > 0)
-		m_ChatTicks--;
-
 	if((g_Config.m_SvAnticamper == 2 && g_Config.m_SvMode == 1) || (g_Config.m_SvAnticamper == 1))
 		Anticamper();
 	/* end zCatch*/
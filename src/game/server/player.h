@@ -106,7 +106,6 @@ public:
 	
 	int m_TicksSpec;
 	int m_TicksIngame;
-	int m_ChatTicks;
 	//Anticamper
 	int Anticamper();
 	bool m_SentCampMsg;
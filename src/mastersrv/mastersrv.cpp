@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/config.h>
@@ -17,9 +18,12 @@
 enum {
 	MTU = 1400,
 	MAX_SERVERS_PER_PACKET=75,
-	MAX_PACKETS=16,
-	MAX_SERVERS=MAX_SERVERS_PER_PACKET*MAX_PACKETS,
-	EXPIRE_TIME = 90
+	MAX_UNPAGED_PACKETS=16, // unpaged requests get what fit into the old fixed list, the rest needs paging
+	EXPIRE_TIME = 90,
+	CHECK_RETRY_TIME = 5,
+
+	POOL_BLOCK_SIZE=1024,
+	WHEEL_SIZE=128, // one second slots, must be a power of two and cover EXPIRE_TIME
 };
 
 struct CCheckServer
@@ -29,21 +33,48 @@ struct CCheckServer
 	NETADDR m_AltAddress;
 	int m_TryCount;
 	int64 m_TryTime;
+
+	CCheckServer *m_pNext;
+	CCheckServer *m_pPrev;
+	CCheckServer *m_pHashNext; // hashed by ip only, the response may come from either address
 };
 
-static CCheckServer m_aCheckServers[MAX_SERVERS];
+static CCheckServer *m_pFirstCheckServer = 0;
+static CCheckServer *m_pFirstFreeCheckServer = 0;
+static CCheckServer **m_ppCheckServerHash = 0;
+static int m_CheckServerHashSize = 0;
 static int m_NumCheckServers = 0;
 
 struct CServerEntry
 {
 	enum ServerType m_Type;
 	NETADDR m_Address;
-	int64 m_Expire;
+	int m_Expire; // second of time_get() after which the entry is dropped
+	int m_ListIndex; // position in the list packets of its type
+
+	CServerEntry *m_pHashNext;
+	CServerEntry *m_pWheelNext;
+	CServerEntry *m_pWheelPrev;
 };
 
-static CServerEntry m_aServers[MAX_SERVERS];
+static CServerEntry *m_pFirstFreeServer = 0;
+static CServerEntry **m_ppServerHash = 0;
+static int m_ServerHashSize = 0;
+static CServerEntry *m_apServerWheel[WHEEL_SIZE];
+static int m_ServerWheelTime = 0;
 static int m_NumServers = 0;
 
+// the servers in the order of the list packets, one list per type
+struct CServerList
+{
+	CServerEntry **m_ppServers;
+	int m_NumServers;
+	int m_Capacity;
+};
+
+static CServerList m_ServerList;
+static CServerList m_ServerListLegacy;
+
 struct CPacketData
 {
 	int m_Size;
@@ -53,8 +84,9 @@ struct CPacketData
 	} m_Data;
 };
 
-CPacketData m_aPackets[MAX_PACKETS];
+static CPacketData *m_pPackets = 0;
 static int m_NumPackets = 0;
+static int m_PacketCapacity = 0;
 
 // legacy code
 struct CPacketDataLegacy
@@ -66,8 +98,9 @@ struct CPacketDataLegacy
 	} m_Data;
 };
 
-CPacketDataLegacy m_aPacketsLegacy[MAX_PACKETS];
+static CPacketDataLegacy *m_pPacketsLegacy = 0;
 static int m_NumPacketsLegacy = 0;
+static int m_PacketCapacityLegacy = 0;
 
 
 struct CCountPacketData
@@ -88,86 +121,314 @@ static CNetClient m_NetOp; // main
 
 IConsole *m_pConsole;
 
-void BuildPackets()
+static unsigned HashAddr(const NETADDR *pAddr, bool WithPort)
 {
-	CServerEntry *pCurrent = &m_aServers[0];
-	int ServersLeft = m_NumServers;
-	m_NumPackets = 0;
-	m_NumPacketsLegacy = 0;
-	int PacketIndex = 0;
-	int PacketIndexLegacy = 0;
-	while(ServersLeft-- && (m_NumPackets + m_NumPacketsLegacy) < MAX_PACKETS)
+	// fnv-1a
+	unsigned h = 2166136261u^pAddr->type;
+	int Size = pAddr->type == NETTYPE_IPV4 ? 4 : 16;
+	for(int i = 0; i < Size; i++)
+		h = (h^pAddr->ip[i])*16777619u;
+	if(WithPort)
 	{
-		if(pCurrent->m_Type == SERVERTYPE_NORMAL)
-		{
-			if(PacketIndex % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndex = 0;
-				m_NumPackets++;
-			}
-
-			// copy header
-			mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+		h = (h^(pAddr->port&0xff))*16777619u;
+		h = (h^(pAddr->port>>8))*16777619u;
+	}
+	return h;
+}
 
-			// copy server addresses
-			if(pCurrent->m_Address.type == NETTYPE_IPV6)
-			{
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
-					sizeof(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp));
-			}
-			else
-			{
-				static char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
+static int ServerTime()
+{
+	return (int)(time_get()/time_freq());
+}
 
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
-			}
+// grows a mem_alloc'ed array, keeping its content
+static void *GrowArray(void *pData, int ElementSize, int OldCapacity, int NewCapacity)
+{
+	void *pNew = mem_alloc(ElementSize*NewCapacity, 1);
+	if(pData)
+	{
+		mem_copy(pNew, pData, ElementSize*OldCapacity);
+		mem_free(pData);
+	}
+	return pNew;
+}
 
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
+// entries are handed out from blocks that are never moved or freed, so pointers to them stay valid
+void AllocServerBlock()
+{
+	CServerEntry *pBlock = (CServerEntry *)mem_alloc(POOL_BLOCK_SIZE*sizeof(CServerEntry), 1);
+	for(int i = POOL_BLOCK_SIZE-1; i >= 0; i--)
+	{
+		pBlock[i].m_pHashNext = m_pFirstFreeServer;
+		m_pFirstFreeServer = &pBlock[i];
+	}
+}
 
-			PacketIndex++;
+void AllocCheckServerBlock()
+{
+	CCheckServer *pBlock = (CCheckServer *)mem_alloc(POOL_BLOCK_SIZE*sizeof(CCheckServer), 1);
+	for(int i = POOL_BLOCK_SIZE-1; i >= 0; i--)
+	{
+		pBlock[i].m_pNext = m_pFirstFreeCheckServer;
+		m_pFirstFreeCheckServer = &pBlock[i];
+	}
+}
 
-			m_aPackets[m_NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
+void RehashServers(int Size)
+{
+	mem_free(m_ppServerHash);
+	m_ServerHashSize = Size;
+	m_ppServerHash = (CServerEntry **)mem_alloc(Size*sizeof(CServerEntry *), 1);
+	mem_zero(m_ppServerHash, Size*sizeof(CServerEntry *));
 
-			pCurrent++;
-		}
-		else if(pCurrent->m_Type == SERVERTYPE_LEGACY)
+	CServerList *apLists[] = { &m_ServerList, &m_ServerListLegacy };
+	for(int l = 0; l < 2; l++)
+	{
+		for(int i = 0; i < apLists[l]->m_NumServers; i++)
 		{
-			if(PacketIndexLegacy % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndexLegacy = 0;
-				m_NumPacketsLegacy++;
-			}
+			CServerEntry *pEntry = apLists[l]->m_ppServers[i];
+			unsigned h = HashAddr(&pEntry->m_Address, true)&(m_ServerHashSize-1);
+			pEntry->m_pHashNext = m_ppServerHash[h];
+			m_ppServerHash[h] = pEntry;
+		}
+	}
+}
 
-			// copy header
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+void RehashCheckServers(int Size)
+{
+	mem_free(m_ppCheckServerHash);
+	m_CheckServerHashSize = Size;
+	m_ppCheckServerHash = (CCheckServer **)mem_alloc(Size*sizeof(CCheckServer *), 1);
+	mem_zero(m_ppCheckServerHash, Size*sizeof(CCheckServer *));
 
-			// copy server addresses
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp, pCurrent->m_Address.ip,
-				sizeof(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp));
-			// 0.5 has the port in little endian on the network
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[0] = pCurrent->m_Address.port&0xff;
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[1] = (pCurrent->m_Address.port>>8)&0xff;
+	for(CCheckServer *pCheck = m_pFirstCheckServer; pCheck; pCheck = pCheck->m_pNext)
+	{
+		unsigned h = HashAddr(&pCheck->m_Address, false)&(m_CheckServerHashSize-1);
+		pCheck->m_pHashNext = m_ppCheckServerHash[h];
+		m_ppCheckServerHash[h] = pCheck;
+	}
+}
 
-			PacketIndexLegacy++;
+void InitPackets()
+{
+	mem_zero(&m_ServerList, sizeof(m_ServerList));
+	mem_zero(&m_ServerListLegacy, sizeof(m_ServerListLegacy));
+	RehashServers(POOL_BLOCK_SIZE);
+	RehashCheckServers(POOL_BLOCK_SIZE);
+	m_ServerWheelTime = ServerTime();
+}
 
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*PacketIndexLegacy;
+// makes room for the given number of list packets of a type
+void ReservePackets(ServerType Type, int NumPackets)
+{
+	if(Type == SERVERTYPE_NORMAL)
+	{
+		if(NumPackets <= m_PacketCapacity)
+			return;
+		int Capacity = max(m_PacketCapacity*2, 16);
+		m_pPackets = (CPacketData *)GrowArray(m_pPackets, sizeof(CPacketData), m_PacketCapacity, Capacity);
+		for(int i = m_PacketCapacity; i < Capacity; i++)
+			mem_copy(m_pPackets[i].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+		m_PacketCapacity = Capacity;
+	}
+	else
+	{
+		if(NumPackets <= m_PacketCapacityLegacy)
+			return;
+		int Capacity = max(m_PacketCapacityLegacy*2, 16);
+		m_pPacketsLegacy = (CPacketDataLegacy *)GrowArray(m_pPacketsLegacy, sizeof(CPacketDataLegacy), m_PacketCapacityLegacy, Capacity);
+		for(int i = m_PacketCapacityLegacy; i < Capacity; i++)
+			mem_copy(m_pPacketsLegacy[i].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+		m_PacketCapacityLegacy = Capacity;
+	}
+}
 
-			pCurrent++;
-		}
+// writes the server at the given position of its list packets
+void WriteListEntry(CServerEntry *pEntry)
+{
+	int Packet = pEntry->m_ListIndex/MAX_SERVERS_PER_PACKET;
+	int Slot = pEntry->m_ListIndex%MAX_SERVERS_PER_PACKET;
+
+	if(pEntry->m_Type == SERVERTYPE_NORMAL)
+	{
+		CMastersrvAddr *pAddr = &m_pPackets[Packet].m_Data.m_aServers[Slot];
+		if(pEntry->m_Address.type == NETTYPE_IPV6)
+			mem_copy(pAddr->m_aIp, pEntry->m_Address.ip, sizeof(pAddr->m_aIp));
 		else
 		{
-			*pCurrent = m_aServers[m_NumServers-1];
-			m_NumServers--;
-			dbg_msg("mastersrv", "error: server of invalid type, dropping it");
+			static char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
+
+			mem_copy(pAddr->m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
+			pAddr->m_aIp[12] = pEntry->m_Address.ip[0];
+			pAddr->m_aIp[13] = pEntry->m_Address.ip[1];
+			pAddr->m_aIp[14] = pEntry->m_Address.ip[2];
+			pAddr->m_aIp[15] = pEntry->m_Address.ip[3];
 		}
+
+		pAddr->m_aPort[0] = (pEntry->m_Address.port>>8)&0xff;
+		pAddr->m_aPort[1] = pEntry->m_Address.port&0xff;
+	}
+	else
+	{
+		CMastersrvAddrLegacy *pAddr = &m_pPacketsLegacy[Packet].m_Data.m_aServers[Slot];
+		mem_copy(pAddr->m_aIp, pEntry->m_Address.ip, sizeof(pAddr->m_aIp));
+		// 0.5 has the port in little endian on the network
+		pAddr->m_aPort[0] = pEntry->m_Address.port&0xff;
+		pAddr->m_aPort[1] = (pEntry->m_Address.port>>8)&0xff;
 	}
 }
 
+// sets the size of the packet holding the last entry of a list after it grew or shrank
+void UpdateListSize(ServerType Type)
+{
+	int Num = Type == SERVERTYPE_NORMAL ? m_ServerList.m_NumServers : m_ServerListLegacy.m_NumServers;
+	int NumPackets = (Num+MAX_SERVERS_PER_PACKET-1)/MAX_SERVERS_PER_PACKET;
+	int NumInLast = Num-(NumPackets-1)*MAX_SERVERS_PER_PACKET;
+
+	if(Type == SERVERTYPE_NORMAL)
+	{
+		m_NumPackets = NumPackets;
+		if(NumPackets)
+			m_pPackets[NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*NumInLast;
+	}
+	else
+	{
+		m_NumPacketsLegacy = NumPackets;
+		if(NumPackets)
+			m_pPacketsLegacy[NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*NumInLast;
+	}
+}
+
+void ListAdd(CServerEntry *pEntry)
+{
+	CServerList *pList = pEntry->m_Type == SERVERTYPE_NORMAL ? &m_ServerList : &m_ServerListLegacy;
+	if(pList->m_NumServers == pList->m_Capacity)
+	{
+		int Capacity = max(pList->m_Capacity*2, (int)POOL_BLOCK_SIZE);
+		pList->m_ppServers = (CServerEntry **)GrowArray(pList->m_ppServers, sizeof(CServerEntry *), pList->m_Capacity, Capacity);
+		pList->m_Capacity = Capacity;
+	}
+
+	pEntry->m_ListIndex = pList->m_NumServers++;
+	pList->m_ppServers[pEntry->m_ListIndex] = pEntry;
+	ReservePackets(pEntry->m_Type, pEntry->m_ListIndex/MAX_SERVERS_PER_PACKET+1);
+	WriteListEntry(pEntry);
+	UpdateListSize(pEntry->m_Type);
+}
+
+void ListRemove(CServerEntry *pEntry)
+{
+	CServerList *pList = pEntry->m_Type == SERVERTYPE_NORMAL ? &m_ServerList : &m_ServerListLegacy;
+
+	// fill the gap with the last entry so the packets stay dense
+	CServerEntry *pLast = pList->m_ppServers[--pList->m_NumServers];
+	if(pLast != pEntry)
+	{
+		pLast->m_ListIndex = pEntry->m_ListIndex;
+		pList->m_ppServers[pLast->m_ListIndex] = pLast;
+		WriteListEntry(pLast);
+	}
+	UpdateListSize(pEntry->m_Type);
+}
+
+void WheelInsert(CServerEntry *pEntry)
+{
+	CServerEntry **ppSlot = &m_apServerWheel[pEntry->m_Expire&(WHEEL_SIZE-1)];
+	pEntry->m_pWheelPrev = 0;
+	pEntry->m_pWheelNext = *ppSlot;
+	if(*ppSlot)
+		(*ppSlot)->m_pWheelPrev = pEntry;
+	*ppSlot = pEntry;
+}
+
+void WheelRemove(CServerEntry *pEntry)
+{
+	if(pEntry->m_pWheelPrev)
+		pEntry->m_pWheelPrev->m_pWheelNext = pEntry->m_pWheelNext;
+	else
+		m_apServerWheel[pEntry->m_Expire&(WHEEL_SIZE-1)] = pEntry->m_pWheelNext;
+	if(pEntry->m_pWheelNext)
+		pEntry->m_pWheelNext->m_pWheelPrev = pEntry->m_pWheelPrev;
+}
+
+CServerEntry *FindServer(const NETADDR *pAddr)
+{
+	for(CServerEntry *pEntry = m_ppServerHash[HashAddr(pAddr, true)&(m_ServerHashSize-1)]; pEntry; pEntry = pEntry->m_pHashNext)
+	{
+		if(net_addr_comp(&pEntry->m_Address, pAddr) == 0)
+			return pEntry;
+	}
+	return 0;
+}
+
+void RemoveServer(CServerEntry *pEntry)
+{
+	CServerEntry **ppLink = &m_ppServerHash[HashAddr(&pEntry->m_Address, true)&(m_ServerHashSize-1)];
+	while(*ppLink != pEntry)
+		ppLink = &(*ppLink)->m_pHashNext;
+	*ppLink = pEntry->m_pHashNext;
+
+	WheelRemove(pEntry);
+	ListRemove(pEntry);
+
+	pEntry->m_pHashNext = m_pFirstFreeServer;
+	m_pFirstFreeServer = pEntry;
+	m_NumServers--;
+}
+
+CCheckServer *FindCheckServer(const NETADDR *pAddr)
+{
+	for(CCheckServer *pCheck = m_ppCheckServerHash[HashAddr(pAddr, false)&(m_CheckServerHashSize-1)]; pCheck; pCheck = pCheck->m_pHashNext)
+	{
+		if(net_addr_comp(&pCheck->m_Address, pAddr) == 0 || net_addr_comp(&pCheck->m_AltAddress, pAddr) == 0)
+			return pCheck;
+	}
+	return 0;
+}
+
+void RemoveCheckServer(CCheckServer *pCheck)
+{
+	CCheckServer **ppLink = &m_ppCheckServerHash[HashAddr(&pCheck->m_Address, false)&(m_CheckServerHashSize-1)];
+	while(*ppLink != pCheck)
+		ppLink = &(*ppLink)->m_pHashNext;
+	*ppLink = pCheck->m_pHashNext;
+
+	if(pCheck->m_pPrev)
+		pCheck->m_pPrev->m_pNext = pCheck->m_pNext;
+	else
+		m_pFirstCheckServer = pCheck->m_pNext;
+	if(pCheck->m_pNext)
+		pCheck->m_pNext->m_pPrev = pCheck->m_pPrev;
+
+	pCheck->m_pNext = m_pFirstFreeCheckServer;
+	m_pFirstFreeCheckServer = pCheck;
+	m_NumCheckServers--;
+}
+
+void SendListPage(NETADDR *pAddr, int Page)
+{
+	unsigned char aData[sizeof(SERVERBROWSE_LIST_PAGED)+4+sizeof(CMastersrvAddr)*MAX_SERVERS_PER_PACKET];
+	int NumServers = 0;
+	if(Page < m_NumPackets)
+		NumServers = (m_pPackets[Page].m_Size-sizeof(SERVERBROWSE_LIST))/sizeof(CMastersrvAddr);
+
+	mem_copy(aData, SERVERBROWSE_LIST_PAGED, sizeof(SERVERBROWSE_LIST_PAGED));
+	aData[sizeof(SERVERBROWSE_LIST_PAGED)] = (Page>>8)&0xff;
+	aData[sizeof(SERVERBROWSE_LIST_PAGED)+1] = Page&0xff;
+	aData[sizeof(SERVERBROWSE_LIST_PAGED)+2] = (m_NumPackets>>8)&0xff;
+	aData[sizeof(SERVERBROWSE_LIST_PAGED)+3] = m_NumPackets&0xff;
+	if(NumServers)
+		mem_copy(&aData[sizeof(SERVERBROWSE_LIST_PAGED)+4], m_pPackets[Page].m_Data.m_aServers, sizeof(CMastersrvAddr)*NumServers);
+
+	CNetChunk p;
+	p.m_ClientID = -1;
+	p.m_Address = *pAddr;
+	p.m_Flags = NETSENDFLAG_CONNLESS;
+	p.m_DataSize = sizeof(SERVERBROWSE_LIST_PAGED)+4+sizeof(CMastersrvAddr)*NumServers;
+	p.m_pData = aData;
+	m_NetOp.Send(&p);
+}
+
 void SendOk(NETADDR *pAddr)
 {
 	CNetChunk p;
@@ -206,54 +467,98 @@ void SendCheck(NETADDR *pAddr)
 
 void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 {
+	// a check for this server is already running
+	CCheckServer *pCheck;
+	for(pCheck = m_ppCheckServerHash[HashAddr(pInfo, false)&(m_CheckServerHashSize-1)]; pCheck; pCheck = pCheck->m_pHashNext)
+	{
+		if(net_addr_comp(&pCheck->m_Address, pInfo) == 0)
+		{
+			pCheck->m_AltAddress = *pAlt;
+			pCheck->m_Type = Type;
+			return;
+		}
+	}
+
 	// add server
-	if(m_NumCheckServers == MAX_SERVERS)
+	if(m_NumCheckServers >= g_Config.m_MsMaxServers)
 	{
 		dbg_msg("mastersrv", "error: mastersrv is full");
 		return;
 	}
+	if(!m_pFirstFreeCheckServer)
+		AllocCheckServerBlock();
+	if(m_NumCheckServers >= m_CheckServerHashSize)
+		RehashCheckServers(m_CheckServerHashSize*2);
 
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	char aAltAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pAlt, aAltAddrStr, sizeof(aAltAddrStr), true);
 	dbg_msg("mastersrv", "checking: %s (%s)", aAddrStr, aAltAddrStr);
-	m_aCheckServers[m_NumCheckServers].m_Address = *pInfo;
-	m_aCheckServers[m_NumCheckServers].m_AltAddress = *pAlt;
-	m_aCheckServers[m_NumCheckServers].m_TryCount = 0;
-	m_aCheckServers[m_NumCheckServers].m_TryTime = 0;
-	m_aCheckServers[m_NumCheckServers].m_Type = Type;
+
+	pCheck = m_pFirstFreeCheckServer;
+	m_pFirstFreeCheckServer = pCheck->m_pNext;
+
+	pCheck->m_Address = *pInfo;
+	pCheck->m_AltAddress = *pAlt;
+	pCheck->m_TryCount = 0;
+	pCheck->m_TryTime = 0;
+	pCheck->m_Type = Type;
+
+	pCheck->m_pPrev = 0;
+	pCheck->m_pNext = m_pFirstCheckServer;
+	if(m_pFirstCheckServer)
+		m_pFirstCheckServer->m_pPrev = pCheck;
+	m_pFirstCheckServer = pCheck;
+
+	unsigned h = HashAddr(pInfo, false)&(m_CheckServerHashSize-1);
+	pCheck->m_pHashNext = m_ppCheckServerHash[h];
+	m_ppCheckServerHash[h] = pCheck;
 	m_NumCheckServers++;
 }
 
 void AddServer(NETADDR *pInfo, ServerType Type)
 {
 	// see if server already exists in list
-	for(int i = 0; i < m_NumServers; i++)
+	CServerEntry *pEntry = FindServer(pInfo);
+	if(pEntry)
 	{
-		if(net_addr_comp(&m_aServers[i].m_Address, pInfo) == 0)
-		{
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "updated: %s", aAddrStr);
-			m_aServers[i].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-			return;
-		}
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "updated: %s", aAddrStr);
+		WheelRemove(pEntry);
+		pEntry->m_Expire = ServerTime()+EXPIRE_TIME;
+		WheelInsert(pEntry);
+		return;
 	}
 
 	// add server
-	if(m_NumServers == MAX_SERVERS)
+	if(m_NumServers >= g_Config.m_MsMaxServers)
 	{
 		dbg_msg("mastersrv", "error: mastersrv is full");
 		return;
 	}
+	if(!m_pFirstFreeServer)
+		AllocServerBlock();
+	if(m_NumServers >= m_ServerHashSize)
+		RehashServers(m_ServerHashSize*2);
 
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	dbg_msg("mastersrv", "added: %s", aAddrStr);
-	m_aServers[m_NumServers].m_Address = *pInfo;
-	m_aServers[m_NumServers].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-	m_aServers[m_NumServers].m_Type = Type;
+
+	pEntry = m_pFirstFreeServer;
+	m_pFirstFreeServer = pEntry->m_pHashNext;
+
+	pEntry->m_Address = *pInfo;
+	pEntry->m_Expire = ServerTime()+EXPIRE_TIME;
+	pEntry->m_Type = Type;
+
+	unsigned h = HashAddr(pInfo, true)&(m_ServerHashSize-1);
+	pEntry->m_pHashNext = m_ppServerHash[h];
+	m_ppServerHash[h] = pEntry;
+	WheelInsert(pEntry);
+	ListAdd(pEntry);
 	m_NumServers++;
 }
 
@@ -261,32 +566,32 @@ void UpdateServers()
 {
 	int64 Now = time_get();
 	int64 Freq = time_freq();
-	for(int i = 0; i < m_NumCheckServers; i++)
+	CCheckServer *pNext;
+	for(CCheckServer *pCheck = m_pFirstCheckServer; pCheck; pCheck = pNext)
 	{
-		if(Now > m_aCheckServers[i].m_TryTime+Freq)
+		pNext = pCheck->m_pNext;
+		if(Now > pCheck->m_TryTime+Freq*CHECK_RETRY_TIME)
 		{
-			if(m_aCheckServers[i].m_TryCount == 10)
+			if(pCheck->m_TryCount == 10)
 			{
 				char aAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(&m_aCheckServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
+				net_addr_str(&pCheck->m_Address, aAddrStr, sizeof(aAddrStr), true);
 				char aAltAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(&m_aCheckServers[i].m_AltAddress, aAltAddrStr, sizeof(aAltAddrStr), true);
+				net_addr_str(&pCheck->m_AltAddress, aAltAddrStr, sizeof(aAltAddrStr), true);
 				dbg_msg("mastersrv", "check failed: %s (%s)", aAddrStr, aAltAddrStr);
 
 				// FAIL!!
-				SendError(&m_aCheckServers[i].m_Address);
-				m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers-1];
-				m_NumCheckServers--;
-				i--;
+				SendError(&pCheck->m_Address);
+				RemoveCheckServer(pCheck);
 			}
 			else
 			{
-				m_aCheckServers[i].m_TryCount++;
-				m_aCheckServers[i].m_TryTime = Now;
-				if(m_aCheckServers[i].m_TryCount&1)
-					SendCheck(&m_aCheckServers[i].m_Address);
+				pCheck->m_TryCount++;
+				pCheck->m_TryTime = Now;
+				if(pCheck->m_TryCount&1)
+					SendCheck(&pCheck->m_Address);
 				else
-					SendCheck(&m_aCheckServers[i].m_AltAddress);
+					SendCheck(&pCheck->m_AltAddress);
 			}
 		}
 	}
@@ -294,22 +599,26 @@ void UpdateServers()
 
 void PurgeServers()
 {
-	int64 Now = time_get();
-	int i = 0;
-	while(i < m_NumServers)
+	// visit the slots of every second that passed, a full round is enough after a stall
+	int Now = ServerTime();
+	int Steps = min(Now-m_ServerWheelTime, (int)WHEEL_SIZE);
+	for(int s = 0; s < Steps; s++)
 	{
-		if(m_aServers[i].m_Expire < Now)
+		CServerEntry *pNext;
+		for(CServerEntry *pEntry = m_apServerWheel[(m_ServerWheelTime+s)&(WHEEL_SIZE-1)]; pEntry; pEntry = pNext)
 		{
+			pNext = pEntry->m_pWheelNext;
+			if(pEntry->m_Expire >= Now)
+				continue;
+
 			// remove server
 			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
+			net_addr_str(&pEntry->m_Address, aAddrStr, sizeof(aAddrStr), true);
 			dbg_msg("mastersrv", "expired: %s", aAddrStr);
-			m_aServers[i] = m_aServers[m_NumServers-1];
-			m_NumServers--;
+			RemoveServer(pEntry);
 		}
-		else
-			i++;
 	}
+	m_ServerWheelTime = Now;
 }
 
 void ReloadBans()
@@ -320,7 +629,7 @@ void ReloadBans()
 
 int main(int argc, const char **argv) // ignore_convention
 {
-	int64 LastBuild = 0, LastBanReload = 0;
+	int64 LastUpdate = 0, LastBanReload = 0;
 	ServerType Type = SERVERTYPE_INVALID;
 	NETADDR BindAddr;
 
@@ -329,6 +638,7 @@ int main(int argc, const char **argv) // ignore_convention
 
 	mem_copy(m_CountData.m_Header, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT));
 	mem_copy(m_CountDataLegacy.m_Header, SERVERBROWSE_COUNT_LEGACY, sizeof(SERVERBROWSE_COUNT_LEGACY));
+	InitPackets();
 
 	IKernel *pKernel = IKernel::Create();
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
@@ -458,13 +768,24 @@ int main(int argc, const char **argv) // ignore_convention
 				p.m_Address = Packet.m_Address;
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 
-				for(int i = 0; i < m_NumPackets; i++)
+				for(int i = 0; i < min(m_NumPackets, (int)MAX_UNPAGED_PACKETS); i++)
 				{
-					p.m_DataSize = m_aPackets[i].m_Size;
-					p.m_pData = &m_aPackets[i].m_Data;
+					p.m_DataSize = m_pPackets[i].m_Size;
+					p.m_pData = &m_pPackets[i].m_Data;
 					m_NetOp.Send(&p);
 				}
 			}
+			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETLIST_PAGED)+2 &&
+				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST_PAGED, sizeof(SERVERBROWSE_GETLIST_PAGED)) == 0)
+			{
+				// someone requested a page of the list, the client asks for the pages it misses
+				unsigned char *d = (unsigned char *)Packet.m_pData;
+				int Page = (d[sizeof(SERVERBROWSE_GETLIST_PAGED)]<<8) | d[sizeof(SERVERBROWSE_GETLIST_PAGED)+1];
+				if(Page == 0)
+					dbg_msg("mastersrv", "requested, responding with %d m_aServers in %d pages", m_NumServers, m_NumPackets);
+
+				SendListPage(&Packet.m_Address, Page);
+			}
 			else if(Packet.m_DataSize == sizeof(SERVERBROWSE_GETLIST_LEGACY) &&
 				mem_comp(Packet.m_pData, SERVERBROWSE_GETLIST_LEGACY, sizeof(SERVERBROWSE_GETLIST_LEGACY)) == 0)
 			{
@@ -476,10 +797,10 @@ int main(int argc, const char **argv) // ignore_convention
 				p.m_Address = Packet.m_Address;
 				p.m_Flags = NETSENDFLAG_CONNLESS;
 
-				for(int i = 0; i < m_NumPacketsLegacy; i++)
+				for(int i = 0; i < min(m_NumPacketsLegacy, (int)MAX_UNPAGED_PACKETS); i++)
 				{
-					p.m_DataSize = m_aPacketsLegacy[i].m_Size;
-					p.m_pData = &m_aPacketsLegacy[i].m_Data;
+					p.m_DataSize = m_pPacketsLegacy[i].m_Size;
+					p.m_pData = &m_pPacketsLegacy[i].m_Data;
 					m_NetOp.Send(&p);
 				}
 			}
@@ -497,16 +818,11 @@ int main(int argc, const char **argv) // ignore_convention
 			{
 				Type = SERVERTYPE_INVALID;
 				// remove it from checking
-				for(int i = 0; i < m_NumCheckServers; i++)
+				CCheckServer *pCheck = FindCheckServer(&Packet.m_Address);
+				if(pCheck)
 				{
-					if(net_addr_comp(&m_aCheckServers[i].m_Address, &Packet.m_Address) == 0 ||
-						net_addr_comp(&m_aCheckServers[i].m_AltAddress, &Packet.m_Address) == 0)
-					{
-						Type = m_aCheckServers[i].m_Type;
-						m_NumCheckServers--;
-						m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers];
-						break;
-					}
+					Type = pCheck->m_Type;
+					RemoveCheckServer(pCheck);
 				}
 
 				// drops servers that were not in the CheckServers list
@@ -525,13 +841,15 @@ int main(int argc, const char **argv) // ignore_convention
 			ReloadBans();
 		}
 
-		if(time_get()-LastBuild > time_freq()*5)
+		// the list packets are kept up to date as servers come and go
+		PurgeServers();
+
+		// checked often so new servers are checked as they come in instead of all at once
+		if(time_get()-LastUpdate > time_freq()/10)
 		{
-			LastBuild = time_get();
+			LastUpdate = time_get();
 
-			PurgeServers();
 			UpdateServers();
-			BuildPackets();
 		}
 
 		// be nice to the CPU
@@ -22,6 +22,10 @@ static const unsigned char SERVERBROWSE_HEARTBEAT[] = {255, 255, 255, 255, 'b',
 static const unsigned char SERVERBROWSE_GETLIST[] = {255, 255, 255, 255, 'r', 'e', 'q', '2'};
 static const unsigned char SERVERBROWSE_LIST[] = {255, 255, 255, 255, 'l', 'i', 's', '2'};
 
+// paged list, the request is followed by the page and the response by the page and the number of pages (2 bytes each)
+static const unsigned char SERVERBROWSE_GETLIST_PAGED[] = {255, 255, 255, 255, 'r', 'e', 'q', 'p'};
+static const unsigned char SERVERBROWSE_LIST_PAGED[] = {255, 255, 255, 255, 'l', 'i', 's', 'p'};
+
 static const unsigned char SERVERBROWSE_GETCOUNT[] = {255, 255, 255, 255, 'c', 'o', 'u', '2'};
 static const unsigned char SERVERBROWSE_COUNT[] = {255, 255, 255, 255, 's', 'i', 'z', '2'};
 
@@ -0,0 +1,474 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/tl/array.h>
+#include <base/tl/string.h>
+#include <engine/console.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/snapshot.h>
+#include <game/gamecore.h>
+#include <game/generated/protocol.h>
+
+/*
+	demo_stats [-j <threads>] [-H <heatmap.csv>] <demo or directory>...
+
+	decodes demos as fast as possible without a client and collects kills
+	and deaths per player and weapon from the kill messages. -H adds up the
+	ticks characters spent on each tile per map and writes them as csv.
+
+	every demo is a job for the worker threads, the results are reported in
+	the order of the files. new analyses implement IDemoAnalysis and are
+	added to the analyzer in DemoJob.
+*/
+
+enum
+{
+	MAX_ANALYSES=4,
+	MAX_PLAYER_NAMES=256,
+	MAX_HEATMAP_SIZE=1024, // tiles in each direction
+	NUM_KILL_WEAPONS=NUM_WEAPONS+3, // including game, self and world
+};
+
+static const char *gs_apWeaponNames[NUM_KILL_WEAPONS] = {"game", "self", "world", "hammer", "gun", "shotgun", "grenade", "rifle", "ninja"};
+
+// gets the content of a demo tick by tick, snapshot items first
+class IDemoAnalysis
+{
+public:
+	virtual ~IDemoAnalysis() {}
+	virtual void OnTick(int Tick) {}
+	virtual void OnItem(int Tick, int Type, int ID, const void *pData, int Size) {}
+	virtual void OnMessage(int Tick, int MsgID, void *pMsg) {} // unpacked game message
+};
+
+class CDemoAnalyzer : public CDemoPlayer::IListner
+{
+	CSnapshotDelta m_SnapshotDelta;
+	CDemoPlayer m_Player;
+	CNetObjHandler m_NetObjHandler;
+	IDemoAnalysis *m_apAnalyses[MAX_ANALYSES];
+	int m_NumAnalyses;
+
+public:
+	CDemoAnalyzer() : m_Player(&m_SnapshotDelta)
+	{
+		for(int i = 0; i < NUM_NETOBJTYPES; i++)
+			m_SnapshotDelta.SetStaticsize(i, m_NetObjHandler.GetObjSize(i));
+		m_Player.SetListner(this);
+		m_NumAnalyses = 0;
+	}
+
+	void Add(IDemoAnalysis *pAnalysis)
+	{
+		if(m_NumAnalyses < MAX_ANALYSES)
+			m_apAnalyses[m_NumAnalyses++] = pAnalysis;
+	}
+
+	// memory isn't allocated thread safe, so loading and stopping use the lock
+	int Run(IStorage *pStorage, IConsole *pConsole, const char *pFilename, int StorageType, LOCK Lock, char *pMapName, int MapNameSize)
+	{
+		lock_wait(Lock);
+		int Result = m_Player.Load(pStorage, pConsole, pFilename, StorageType);
+		lock_release(Lock);
+		if(Result != 0)
+			return -1;
+		str_copy(pMapName, m_Player.Info()->m_Header.m_aMapName, MapNameSize);
+
+		while(m_Player.IsPlaying() && !m_Player.BaseInfo()->m_Paused)
+			m_Player.NextFrame();
+
+		lock_wait(Lock);
+		m_Player.Stop();
+		lock_release(Lock);
+		return 0;
+	}
+
+	virtual void OnDemoPlayerSnapshot(void *pData, int Size)
+	{
+		int Tick = m_Player.BaseInfo()->m_CurrentTick;
+		CSnapshot *pSnap = (CSnapshot *)pData;
+		for(int a = 0; a < m_NumAnalyses; a++)
+		{
+			m_apAnalyses[a]->OnTick(Tick);
+			for(int i = 0; i < pSnap->NumItems(); i++)
+			{
+				CSnapshotItem *pItem = pSnap->GetItem(i);
+				m_apAnalyses[a]->OnItem(Tick, pItem->Type(), pItem->ID(), pItem->Data(), pSnap->GetItemSize(i));
+			}
+		}
+	}
+
+	virtual void OnDemoPlayerMessage(void *pData, int Size)
+	{
+		CUnpacker Unpacker;
+		Unpacker.Reset(pData, Size);
+
+		// unpack msgid and system flag
+		int Msg = Unpacker.GetInt();
+		int Sys = Msg&1;
+		Msg >>= 1;
+		if(Unpacker.Error() || Sys)
+			return;
+
+		void *pMsg = m_NetObjHandler.SecureUnpackMsg(Msg, &Unpacker);
+		if(!pMsg)
+			return;
+		for(int a = 0; a < m_NumAnalyses; a++)
+			m_apAnalyses[a]->OnMessage(m_Player.BaseInfo()->m_CurrentTick, Msg, pMsg);
+	}
+};
+
+class CKillStats : public IDemoAnalysis
+{
+public:
+	struct CPlayer
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		int m_Kills;
+		int m_Deaths;
+	};
+
+	int m_FirstTick;
+	int m_LastTick;
+	int m_NumTicks;
+	int m_aWeaponKills[NUM_KILL_WEAPONS];
+	CPlayer m_aPlayers[MAX_PLAYER_NAMES];
+	int m_NumPlayers;
+	int m_aClientPlayer[MAX_CLIENTS]; // slot in m_aPlayers of the current name of a client
+
+	CKillStats()
+	{
+		m_FirstTick = -1;
+		m_LastTick = -1;
+		m_NumTicks = 0;
+		mem_zero(m_aWeaponKills, sizeof(m_aWeaponKills));
+		m_NumPlayers = 0;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			m_aClientPlayer[i] = -1;
+	}
+
+	int FindPlayer(const char *pName)
+	{
+		for(int i = 0; i < m_NumPlayers; i++)
+		{
+			if(str_comp(m_aPlayers[i].m_aName, pName) == 0)
+				return i;
+		}
+		if(m_NumPlayers == MAX_PLAYER_NAMES)
+			return -1;
+		str_copy(m_aPlayers[m_NumPlayers].m_aName, pName, sizeof(m_aPlayers[m_NumPlayers].m_aName));
+		m_aPlayers[m_NumPlayers].m_Kills = 0;
+		m_aPlayers[m_NumPlayers].m_Deaths = 0;
+		return m_NumPlayers++;
+	}
+
+	virtual void OnTick(int Tick)
+	{
+		if(m_FirstTick == -1)
+			m_FirstTick = Tick;
+		m_LastTick = Tick;
+		m_NumTicks++;
+	}
+
+	virtual void OnItem(int Tick, int Type, int ID, const void *pData, int Size)
+	{
+		if(Type != NETOBJTYPE_CLIENTINFO || ID < 0 || ID >= MAX_CLIENTS || Size < (int)sizeof(CNetObj_ClientInfo))
+			return;
+
+		const CNetObj_ClientInfo *pInfo = (const CNetObj_ClientInfo *)pData;
+		char aName[MAX_NAME_LENGTH];
+		IntsToStr(&pInfo->m_Name0, 4, aName);
+		int Player = m_aClientPlayer[ID];
+		if(Player == -1 || str_comp(m_aPlayers[Player].m_aName, aName) != 0)
+			m_aClientPlayer[ID] = FindPlayer(aName);
+	}
+
+	virtual void OnMessage(int Tick, int MsgID, void *pMsg)
+	{
+		if(MsgID != NETMSGTYPE_SV_KILLMSG)
+			return;
+
+		CNetMsg_Sv_KillMsg *pKill = (CNetMsg_Sv_KillMsg *)pMsg;
+		if(pKill->m_Weapon >= -3 && pKill->m_Weapon < NUM_WEAPONS)
+			m_aWeaponKills[pKill->m_Weapon+3]++;
+		if(pKill->m_Victim >= 0 && pKill->m_Victim < MAX_CLIENTS && m_aClientPlayer[pKill->m_Victim] != -1)
+			m_aPlayers[m_aClientPlayer[pKill->m_Victim]].m_Deaths++;
+		if(pKill->m_Killer != pKill->m_Victim && pKill->m_Killer >= 0 && pKill->m_Killer < MAX_CLIENTS && m_aClientPlayer[pKill->m_Killer] != -1)
+			m_aPlayers[m_aClientPlayer[pKill->m_Killer]].m_Kills++;
+	}
+};
+
+class CHeatmap : public IDemoAnalysis
+{
+public:
+	int *m_pTicks; // MAX_HEATMAP_SIZE*MAX_HEATMAP_SIZE, allocated on the first character
+	int m_Width;
+	int m_Height;
+
+	CHeatmap()
+	{
+		m_pTicks = 0;
+		m_Width = 0;
+		m_Height = 0;
+	}
+
+	~CHeatmap()
+	{
+		delete[] m_pTicks;
+	}
+
+	virtual void OnItem(int Tick, int Type, int ID, const void *pData, int Size)
+	{
+		if(Type != NETOBJTYPE_CHARACTER || Size < (int)sizeof(CNetObj_Character))
+			return;
+
+		const CNetObj_Character *pChar = (const CNetObj_Character *)pData;
+		int x = pChar->m_X/32;
+		int y = pChar->m_Y/32;
+		if(x < 0 || y < 0 || x >= MAX_HEATMAP_SIZE || y >= MAX_HEATMAP_SIZE)
+			return;
+
+		// runs on the worker threads, new doesn't use the engine allocator
+		if(!m_pTicks)
+		{
+			m_pTicks = new int[MAX_HEATMAP_SIZE*MAX_HEATMAP_SIZE];
+			mem_zero(m_pTicks, MAX_HEATMAP_SIZE*MAX_HEATMAP_SIZE*sizeof(int));
+		}
+		m_pTicks[y*MAX_HEATMAP_SIZE+x]++;
+		m_Width = max(m_Width, x+1);
+		m_Height = max(m_Height, y+1);
+	}
+};
+
+struct CDemoTask
+{
+	CJob m_Job;
+	char m_aFilename[512];
+	int m_StorageType;
+	char m_aMapName[64];
+	CKillStats m_KillStats;
+	CHeatmap m_Heatmap;
+	int64 m_Time;
+	int m_Result;
+};
+
+struct CMapHeatmap
+{
+	string m_MapName;
+	int *m_pTicks;
+	int m_Width;
+	int m_Height;
+};
+
+static IStorage *s_pStorage;
+static IConsole *s_pConsole;
+static LOCK s_Lock;
+static bool s_Heatmap = false;
+static int s_NumThreads = 4;
+
+static int DemoJob(void *pData)
+{
+	CDemoTask *pTask = (CDemoTask *)pData;
+	int64 StartTime = time_get();
+
+	CDemoAnalyzer *pAnalyzer = new CDemoAnalyzer;
+	pAnalyzer->Add(&pTask->m_KillStats);
+	if(s_Heatmap)
+		pAnalyzer->Add(&pTask->m_Heatmap);
+	pTask->m_Result = pAnalyzer->Run(s_pStorage, s_pConsole, pTask->m_aFilename, pTask->m_StorageType, s_Lock, pTask->m_aMapName, sizeof(pTask->m_aMapName));
+	delete pAnalyzer;
+
+	pTask->m_Time = time_get()-StartTime;
+	return pTask->m_Result;
+}
+
+struct CListDemosData
+{
+	const char *m_pDir;
+	array<CDemoTask *> *m_pTasks;
+};
+
+static int ListDemosCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	CListDemosData *pData = (CListDemosData *)pUser;
+	int Length = str_length(pName);
+	if(!IsDir && Length > 5 && str_comp(pName+Length-5, ".demo") == 0)
+	{
+		CDemoTask *pTask = new CDemoTask;
+		str_format(pTask->m_aFilename, sizeof(pTask->m_aFilename), "%s/%s", pData->m_pDir, pName);
+		pTask->m_StorageType = StorageType;
+		pData->m_pTasks->add(pTask);
+	}
+	return 0;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv); // ignore_convention
+	if(!pStorage)
+		return -1;
+	s_pStorage = pStorage;
+	s_pConsole = CreateConsole(CFGFLAG_SERVER);
+	s_Lock = lock_create();
+	CNetBase::Init();
+
+	const char *pHeatmapFile = 0;
+	array<CDemoTask *> lTasks;
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(str_comp(argv[i], "-j") == 0 && i+1 < argc) // ignore_convention
+			s_NumThreads = clamp(str_toint(argv[++i]), 1, 64); // ignore_convention
+		else if(str_comp(argv[i], "-H") == 0 && i+1 < argc) // ignore_convention
+		{
+			pHeatmapFile = argv[++i]; // ignore_convention
+			s_Heatmap = true;
+		}
+		else if(fs_is_dir(argv[i])) // ignore_convention
+		{
+			int NumTasks = lTasks.size();
+			CListDemosData Data;
+			Data.m_pDir = argv[i]; // ignore_convention
+			Data.m_pTasks = &lTasks;
+			pStorage->ListDirectory(IStorage::TYPE_ALL, argv[i], ListDemosCallback, &Data); // ignore_convention
+			if(lTasks.size() == NumTasks)
+				dbg_msg("demo_stats", "no demos in '%s'", argv[i]); // ignore_convention
+		}
+		else
+		{
+			CDemoTask *pTask = new CDemoTask;
+			str_copy(pTask->m_aFilename, argv[i], sizeof(pTask->m_aFilename)); // ignore_convention
+			pTask->m_StorageType = IStorage::TYPE_ALL;
+			lTasks.add(pTask);
+		}
+	}
+
+	if(!lTasks.size())
+	{
+		dbg_msg("demo_stats", "usage: demo_stats [-j <threads>] [-H <heatmap.csv>] <demo or directory>...");
+		return -1;
+	}
+
+	// the player saves the maps of the demos
+	pStorage->CreateFolder("downloadedmaps", IStorage::TYPE_SAVE);
+
+	CJobPool Pool;
+	Pool.Init(s_NumThreads);
+	for(int i = 0; i < lTasks.size(); i++)
+		Pool.Add(&lTasks[i]->m_Job, DemoJob, lTasks[i]);
+
+	// report in order while the later demos are still decoded
+	int64 StartTime = time_get();
+	int Failed = 0, TotalTicks = 0;
+	int aWeaponKills[NUM_KILL_WEAPONS] = {0};
+	CKillStats *pTotal = new CKillStats;
+	array<CMapHeatmap> lHeatmaps;
+	for(int i = 0; i < lTasks.size(); i++)
+	{
+		CDemoTask *pTask = lTasks[i];
+		while(pTask->m_Job.Status() != CJob::STATE_DONE)
+			thread_sleep(1);
+
+		if(pTask->m_Result != 0)
+		{
+			dbg_msg("demo_stats", "failed to read '%s'", pTask->m_aFilename);
+			Failed++;
+			delete pTask;
+			continue;
+		}
+
+		const CKillStats *pStats = &pTask->m_KillStats;
+		int Kills = 0;
+		for(int w = 0; w < NUM_KILL_WEAPONS; w++)
+		{
+			Kills += pStats->m_aWeaponKills[w];
+			aWeaponKills[w] += pStats->m_aWeaponKills[w];
+		}
+		TotalTicks += pStats->m_NumTicks;
+		dbg_msg("demo_stats", "%s: map=%s ticks=%d-%d snapshots=%d players=%d kills=%d time=%.1fms", pTask->m_aFilename, pTask->m_aMapName,
+			pStats->m_FirstTick, pStats->m_LastTick, pStats->m_NumTicks, pStats->m_NumPlayers, Kills, pTask->m_Time*1000.0f/time_freq());
+
+		for(int p = 0; p < pStats->m_NumPlayers; p++)
+		{
+			int Player = pTotal->FindPlayer(pStats->m_aPlayers[p].m_aName);
+			if(Player == -1)
+				continue;
+			pTotal->m_aPlayers[Player].m_Kills += pStats->m_aPlayers[p].m_Kills;
+			pTotal->m_aPlayers[Player].m_Deaths += pStats->m_aPlayers[p].m_Deaths;
+		}
+
+		const CHeatmap *pHeatmap = &pTask->m_Heatmap;
+		if(pHeatmap->m_pTicks)
+		{
+			int Map = 0;
+			while(Map < lHeatmaps.size() && str_comp(lHeatmaps[Map].m_MapName.cstr(), pTask->m_aMapName) != 0)
+				Map++;
+			if(Map == lHeatmaps.size())
+			{
+				CMapHeatmap Entry;
+				Entry.m_MapName = pTask->m_aMapName;
+				Entry.m_pTicks = new int[MAX_HEATMAP_SIZE*MAX_HEATMAP_SIZE];
+				mem_zero(Entry.m_pTicks, MAX_HEATMAP_SIZE*MAX_HEATMAP_SIZE*sizeof(int));
+				Entry.m_Width = 0;
+				Entry.m_Height = 0;
+				lHeatmaps.add(Entry);
+			}
+			CMapHeatmap *pMap = &lHeatmaps[Map];
+			for(int y = 0; y < pHeatmap->m_Height; y++)
+				for(int x = 0; x < pHeatmap->m_Width; x++)
+					pMap->m_pTicks[y*MAX_HEATMAP_SIZE+x] += pHeatmap->m_pTicks[y*MAX_HEATMAP_SIZE+x];
+			pMap->m_Width = max(pMap->m_Width, pHeatmap->m_Width);
+			pMap->m_Height = max(pMap->m_Height, pHeatmap->m_Height);
+		}
+
+		delete pTask;
+	}
+
+	float Time = (time_get()-StartTime)/(float)time_freq();
+	dbg_msg("demo_stats", "%d demos, %d failed, %d snapshots in %.2fs (%.0f/s) with %d threads", lTasks.size(), Failed, TotalTicks, Time, TotalTicks/max(Time, 0.001f), s_NumThreads);
+	for(int w = 0; w < NUM_KILL_WEAPONS; w++)
+	{
+		if(aWeaponKills[w])
+			dbg_msg("demo_stats", "kills with %s: %d", gs_apWeaponNames[w], aWeaponKills[w]);
+	}
+	for(int p = 0; p < pTotal->m_NumPlayers; p++)
+		dbg_msg("demo_stats", "player '%s': kills=%d deaths=%d", pTotal->m_aPlayers[p].m_aName, pTotal->m_aPlayers[p].m_Kills, pTotal->m_aPlayers[p].m_Deaths);
+	delete pTotal;
+
+	if(pHeatmapFile)
+	{
+		IOHANDLE File = io_open(pHeatmapFile, IOFLAG_WRITE);
+		if(!File)
+		{
+			dbg_msg("demo_stats", "couldn't write '%s'", pHeatmapFile);
+			return -1;
+		}
+
+		char aLine[256];
+		str_copy(aLine, "map,x,y,ticks\n", sizeof(aLine));
+		io_write(File, aLine, str_length(aLine));
+		for(int m = 0; m < lHeatmaps.size(); m++)
+		{
+			const CMapHeatmap *pMap = &lHeatmaps[m];
+			for(int y = 0; y < pMap->m_Height; y++)
+				for(int x = 0; x < pMap->m_Width; x++)
+				{
+					int Ticks = pMap->m_pTicks[y*MAX_HEATMAP_SIZE+x];
+					if(!Ticks)
+						continue;
+					str_format(aLine, sizeof(aLine), "%s,%d,%d,%d\n", pMap->m_MapName.cstr(), x, y, Ticks);
+					io_write(File, aLine, str_length(aLine));
+				}
+			delete[] pMap->m_pTicks;
+		}
+		io_close(File);
+	}
+
+	return Failed ? -1 : 0;
+}
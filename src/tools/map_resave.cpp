@@ -1,45 +1,121 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/system.h>
+#include <base/tl/array.h>
+#include <base/tl/string.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 
-int main(int argc, const char **argv)
-{
-	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
-	int Index, ID = 0, Type = 0, Size;
-	void *pPtr;
-	char aFileName[1024];
-	CDataFileReader DataFile;
-	CDataFileWriter df;
+/*
+	map_resave <source> <destination>
+	map_resave -d <source directory> <destination directory>
 
-	if(!pStorage || argc != 3)
-		return -1;
+	in directory mode the data of several maps is compressed at the same time,
+	the writers hand their blocks to the shared compression threads and are
+	finished in the order the maps were read.
+*/
 
-	str_format(aFileName, sizeof(aFileName), "%s", argv[2]);
+enum
+{
+	MAX_PENDING_MAPS=8,
+};
 
-	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ALL))
+static int ResaveMap(IStorage *pStorage, const char *pSource, const char *pDestination, CDataFileWriter *pWriter)
+{
+	CDataFileReader DataFile;
+	if(!DataFile.Open(pStorage, pSource, IStorage::TYPE_ALL))
 		return -1;
-	if(!df.Open(pStorage, aFileName))
+	if(!pWriter->Open(pStorage, pDestination))
 		return -1;
 
 	// add all items
-	for(Index = 0; Index < DataFile.NumItems(); Index++)
+	for(int Index = 0; Index < DataFile.NumItems(); Index++)
 	{
-		pPtr = DataFile.GetItem(Index, &Type, &ID);
-		Size = DataFile.GetItemSize(Index);
-		df.AddItem(Type, ID, Size, pPtr);
+		int Type, ID;
+		void *pPtr = DataFile.GetItem(Index, &Type, &ID);
+		int Size = DataFile.GetItemSize(Index);
+		pWriter->AddItem(Type, ID, Size, pPtr);
 	}
 
-	// add all data
-	for(Index = 0; Index < DataFile.NumData(); Index++)
+	// add all data, the writer keeps its own copy
+	for(int Index = 0; Index < DataFile.NumData(); Index++)
 	{
-		pPtr = DataFile.GetData(Index);
-		Size = DataFile.GetDataSize(Index);
-		df.AddData(Size, pPtr);
+		void *pPtr = DataFile.GetData(Index);
+		int Size = DataFile.GetUncompressedDataSize(Index);
+		if(!pPtr)
+		{
+			// a map without the block is useless, don't leave a half written one behind
+			dbg_msg("map_resave", "'%s' has a broken data block, index=%d", pSource, Index);
+			pWriter->Finish();
+			pStorage->RemoveFile(pDestination, IStorage::TYPE_SAVE);
+			DataFile.Close();
+			return -1;
+		}
+		pWriter->AddData(Size, pPtr);
+		DataFile.UnloadData(Index);
 	}
 
 	DataFile.Close();
+	return 0;
+}
+
+static int ListMapsCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	array<string> *pMaps = (array<string> *)pUser;
+	int Length = str_length(pName);
+	if(!IsDir && Length > 4 && str_comp(pName+Length-4, ".map") == 0)
+		pMaps->add(pName);
+	return 0;
+}
+
+static int ResaveDirectory(IStorage *pStorage, const char *pSourceDir, const char *pDestinationDir)
+{
+	array<string> lMaps;
+	pStorage->ListDirectory(IStorage::TYPE_ALL, pSourceDir, ListMapsCallback, &lMaps);
+	pStorage->CreateFolder(pDestinationDir, IStorage::TYPE_SAVE);
+
+	CDataFileWriter aWriters[MAX_PENDING_MAPS];
+	int Failed = 0;
+	int64 StartTime = time_get();
+	for(int i = 0; i < lMaps.size()+MAX_PENDING_MAPS; i++)
+	{
+		// finish the oldest map before its writer is reused
+		if(i >= MAX_PENDING_MAPS)
+			aWriters[i%MAX_PENDING_MAPS].Finish();
+		if(i >= lMaps.size())
+			continue;
+
+		char aSource[512], aDestination[512];
+		str_format(aSource, sizeof(aSource), "%s/%s", pSourceDir, lMaps[i].cstr());
+		str_format(aDestination, sizeof(aDestination), "%s/%s", pDestinationDir, lMaps[i].cstr());
+		if(ResaveMap(pStorage, aSource, aDestination, &aWriters[i%MAX_PENDING_MAPS]) != 0)
+		{
+			dbg_msg("map_resave", "failed to resave '%s'", aSource);
+			Failed++;
+		}
+	}
+
+	dbg_msg("map_resave", "resaved %d of %d maps in %.2fs", lMaps.size()-Failed, lMaps.size(), (time_get()-StartTime)/(float)time_freq());
+	return Failed ? -1 : 0;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+
+	if(!pStorage)
+		return -1;
+
+	if(argc == 4 && str_comp(argv[1], "-d") == 0)
+		return ResaveDirectory(pStorage, argv[2], argv[3]);
+
+	if(argc != 3)
+		return -1;
+
+	CDataFileWriter df;
+	if(ResaveMap(pStorage, argv[1], argv[2], &df) != 0)
+		return -1;
 	df.Finish();
 	return 0;
 }
@@ -0,0 +1,236 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/network.h>
+#include <mastersrv/mastersrv.h>
+
+/*
+	simulates many game servers and browsers against a local mastersrv.
+	every simulated server owns a socket, sends heartbeats from it and
+	answers the firewall checks of the master so it ends up in the list.
+
+	-m <addr>  master address (127.0.0.1:8300)
+	-s <num>   simulated servers, one port each starting at -p (500, 20000)
+	-b <rate>  heartbeats per second (10000)
+	-r <rate>  list requests per second (1000)
+	-g         request single pages of the list instead of the whole list
+	-t <secs>  duration (30)
+*/
+
+enum
+{
+	MAX_SIM_SERVERS=4096,
+	CONNLESS_HEADER_SIZE=6,
+};
+
+static NETSOCKET s_aServerSockets[MAX_SIM_SERVERS];
+static int s_aServerPorts[MAX_SIM_SERVERS];
+static int s_NumServers = 500;
+static int s_BasePort = 20000;
+static int s_HeartbeatRate = 10000;
+static int s_RequestRate = 1000;
+static int s_Duration = 30;
+static bool s_Paged = false;
+static int s_NumPages = 1;
+static NETADDR s_MasterAddr = {NETTYPE_IPV4, {127,0,0,1}, MASTERSERVER_PORT};
+
+struct CStats
+{
+	int m_Heartbeats;
+	int m_Checks;
+	int m_Oks;
+	int m_Requests;
+	int m_ListPackets;
+	int m_ListServers;
+	int m_Count;
+};
+
+static bool IsPacket(const unsigned char *pData, int Size, const unsigned char *pHeader, int HeaderSize)
+{
+	return Size >= CONNLESS_HEADER_SIZE+HeaderSize && mem_comp(pData+CONNLESS_HEADER_SIZE, pHeader, HeaderSize) == 0;
+}
+
+static void SendHeartbeat(int Server)
+{
+	unsigned char aData[sizeof(SERVERBROWSE_HEARTBEAT)+2];
+	mem_copy(aData, SERVERBROWSE_HEARTBEAT, sizeof(SERVERBROWSE_HEARTBEAT));
+	aData[sizeof(SERVERBROWSE_HEARTBEAT)] = (s_aServerPorts[Server]>>8)&0xff;
+	aData[sizeof(SERVERBROWSE_HEARTBEAT)+1] = s_aServerPorts[Server]&0xff;
+	CNetBase::SendPacketConnless(s_aServerSockets[Server], &s_MasterAddr, aData, sizeof(aData));
+}
+
+static void PollServer(int Server, CStats *pStats)
+{
+	unsigned char aBuf[NET_MAX_PACKETSIZE];
+	NETADDR From;
+	int Size;
+	while((Size = net_udp_recv(s_aServerSockets[Server], &From, aBuf, sizeof(aBuf))) > 0)
+	{
+		if(IsPacket(aBuf, Size, SERVERBROWSE_FWCHECK, sizeof(SERVERBROWSE_FWCHECK)))
+		{
+			CNetBase::SendPacketConnless(s_aServerSockets[Server], &From, SERVERBROWSE_FWRESPONSE, sizeof(SERVERBROWSE_FWRESPONSE));
+			pStats->m_Checks++;
+		}
+		else if(IsPacket(aBuf, Size, SERVERBROWSE_FWOK, sizeof(SERVERBROWSE_FWOK)))
+			pStats->m_Oks++;
+	}
+}
+
+static void PollBrowser(NETSOCKET Socket, CStats *pStats)
+{
+	unsigned char aBuf[NET_MAX_PACKETSIZE];
+	NETADDR From;
+	int Size;
+	while((Size = net_udp_recv(Socket, &From, aBuf, sizeof(aBuf))) > 0)
+	{
+		if(IsPacket(aBuf, Size, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST)))
+		{
+			pStats->m_ListPackets++;
+			pStats->m_ListServers += (Size-CONNLESS_HEADER_SIZE-sizeof(SERVERBROWSE_LIST))/sizeof(CMastersrvAddr);
+		}
+		else if(IsPacket(aBuf, Size, SERVERBROWSE_LIST_PAGED, sizeof(SERVERBROWSE_LIST_PAGED)) && Size >= CONNLESS_HEADER_SIZE+(int)sizeof(SERVERBROWSE_LIST_PAGED)+4)
+		{
+			const unsigned char *pData = aBuf+CONNLESS_HEADER_SIZE+sizeof(SERVERBROWSE_LIST_PAGED);
+			s_NumPages = max((pData[2]<<8) | pData[3], 1);
+			pStats->m_ListPackets++;
+			pStats->m_ListServers += (Size-CONNLESS_HEADER_SIZE-sizeof(SERVERBROWSE_LIST_PAGED)-4)/sizeof(CMastersrvAddr);
+		}
+		else if(IsPacket(aBuf, Size, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT)) && Size >= CONNLESS_HEADER_SIZE+(int)sizeof(SERVERBROWSE_COUNT)+2)
+			pStats->m_Count = (aBuf[CONNLESS_HEADER_SIZE+sizeof(SERVERBROWSE_COUNT)]<<8) | aBuf[CONNLESS_HEADER_SIZE+sizeof(SERVERBROWSE_COUNT)+1];
+	}
+}
+
+static int Run()
+{
+	for(int i = 0; i < s_NumServers; i++)
+	{
+		NETADDR BindAddr = {NETTYPE_IPV4, {127,0,0,1}, 0};
+		BindAddr.port = s_aServerPorts[i] = s_BasePort+i;
+		s_aServerSockets[i] = net_udp_create(BindAddr, 0);
+		if(s_aServerSockets[i].type == NETTYPE_INVALID)
+		{
+			dbg_msg("mastersrv_load", "couldn't bind port %d", BindAddr.port);
+			return -1;
+		}
+	}
+
+	NETADDR BindAddr = {NETTYPE_IPV4, {127,0,0,1}, 0};
+	NETSOCKET Browser = net_udp_create(BindAddr, 1);
+	if(Browser.type == NETTYPE_INVALID)
+	{
+		dbg_msg("mastersrv_load", "couldn't open browser socket");
+		return -1;
+	}
+
+	char aAddrStr[NETADDR_MAXSTRSIZE];
+	net_addr_str(&s_MasterAddr, aAddrStr, sizeof(aAddrStr), true);
+	dbg_msg("mastersrv_load", "master=%s servers=%d heartbeats=%d/s requests=%d/s duration=%ds",
+		aAddrStr, s_NumServers, s_HeartbeatRate, s_RequestRate, s_Duration);
+
+	CStats Stats, Total;
+	mem_zero(&Stats, sizeof(Stats));
+	mem_zero(&Total, sizeof(Total));
+
+	int64 Start = time_get();
+	int64 NextReport = Start+time_freq();
+	int64 NumHeartbeats = 0, NumRequests = 0;
+	int NextServer = 0;
+	while(time_get() < Start+time_freq()*s_Duration)
+	{
+		// send what is due at the configured rates
+		int64 Elapsed = time_get()-Start;
+		for(int64 Due = Elapsed*s_HeartbeatRate/time_freq(); NumHeartbeats < Due; NumHeartbeats++)
+		{
+			SendHeartbeat(NextServer);
+			NextServer = (NextServer+1)%s_NumServers;
+			Stats.m_Heartbeats++;
+		}
+		for(int64 Due = Elapsed*s_RequestRate/time_freq(); NumRequests < Due; NumRequests++)
+		{
+			if(s_Paged)
+			{
+				unsigned char aData[sizeof(SERVERBROWSE_GETLIST_PAGED)+2];
+				int Page = NumRequests%s_NumPages;
+				mem_copy(aData, SERVERBROWSE_GETLIST_PAGED, sizeof(SERVERBROWSE_GETLIST_PAGED));
+				aData[sizeof(SERVERBROWSE_GETLIST_PAGED)] = (Page>>8)&0xff;
+				aData[sizeof(SERVERBROWSE_GETLIST_PAGED)+1] = Page&0xff;
+				CNetBase::SendPacketConnless(Browser, &s_MasterAddr, aData, sizeof(aData));
+			}
+			else
+				CNetBase::SendPacketConnless(Browser, &s_MasterAddr, SERVERBROWSE_GETLIST, sizeof(SERVERBROWSE_GETLIST));
+			if(NumRequests%100 == 0)
+				CNetBase::SendPacketConnless(Browser, &s_MasterAddr, SERVERBROWSE_GETCOUNT, sizeof(SERVERBROWSE_GETCOUNT));
+			Stats.m_Requests++;
+		}
+
+		for(int i = 0; i < s_NumServers; i++)
+			PollServer(i, &Stats);
+		PollBrowser(Browser, &Stats);
+
+		if(time_get() >= NextReport)
+		{
+			NextReport += time_freq();
+			dbg_msg("mastersrv_load", "heartbeats=%d checks=%d ok=%d requests=%d list_packets=%d servers/request=%.1f count=%d",
+				Stats.m_Heartbeats, Stats.m_Checks, Stats.m_Oks, Stats.m_Requests, Stats.m_ListPackets,
+				Stats.m_Requests ? Stats.m_ListServers/(float)Stats.m_Requests : 0.0f, Stats.m_Count);
+
+			Total.m_Heartbeats += Stats.m_Heartbeats;
+			Total.m_Checks += Stats.m_Checks;
+			Total.m_Oks += Stats.m_Oks;
+			Total.m_Requests += Stats.m_Requests;
+			Total.m_ListPackets += Stats.m_ListPackets;
+			Total.m_ListServers += Stats.m_ListServers;
+			Total.m_Count = Stats.m_Count;
+			mem_zero(&Stats, sizeof(Stats));
+			Stats.m_Count = Total.m_Count;
+		}
+
+		thread_sleep(1);
+	}
+
+	dbg_msg("mastersrv_load", "total: heartbeats=%d checks=%d ok=%d requests=%d list_packets=%d list_servers=%d count=%d",
+		Total.m_Heartbeats, Total.m_Checks, Total.m_Oks, Total.m_Requests, Total.m_ListPackets, Total.m_ListServers, Total.m_Count);
+
+	for(int i = 0; i < s_NumServers; i++)
+		net_udp_close(s_aServerSockets[i]);
+	net_udp_close(Browser);
+	return 0;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	net_init();
+
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(str_comp(argv[i], "-g") == 0) // ignore_convention
+		{
+			s_Paged = true;
+			continue;
+		}
+		if(i+1 >= argc) // ignore_convention
+			break;
+		if(str_comp(argv[i], "-m") == 0) // ignore_convention
+		{
+			if(net_addr_from_str(&s_MasterAddr, argv[++i]) != 0) // ignore_convention
+			{
+				dbg_msg("mastersrv_load", "invalid master address");
+				return -1;
+			}
+		}
+		else if(str_comp(argv[i], "-s") == 0) // ignore_convention
+			s_NumServers = clamp(str_toint(argv[++i]), 1, (int)MAX_SIM_SERVERS); // ignore_convention
+		else if(str_comp(argv[i], "-p") == 0) // ignore_convention
+			s_BasePort = str_toint(argv[++i]); // ignore_convention
+		else if(str_comp(argv[i], "-b") == 0) // ignore_convention
+			s_HeartbeatRate = max(str_toint(argv[++i]), 0); // ignore_convention
+		else if(str_comp(argv[i], "-r") == 0) // ignore_convention
+			s_RequestRate = max(str_toint(argv[++i]), 0); // ignore_convention
+		else if(str_comp(argv[i], "-t") == 0) // ignore_convention
+			s_Duration = max(str_toint(argv[++i]), 1); // ignore_convention
+	}
+
+	return Run();
+}